@@ -0,0 +1,671 @@
+/*
+ * bench/hotpath_bench.c
+ * Microbenchmarks of the in-process work behind a login: username hashing,
+ * UserCache operations at several fill levels, socket assignment, session keys
+ * and authenticate_user and its login bookkeeping on an in-memory database
+ *
+ * Every benchmark runs warmup trials and then timed trials of a fixed number
+ * of operations, and reports the median ns/op with min, mean and spread.
+ * -j prints one JSON object (one result per line), -b compares a run against
+ * such a file and exits with 1 if a median got slower than the threshold
+ *
+ * The server code logs on some of these paths (assignment, last login). Its
+ * stdout goes to /dev/null so the report stays readable, the cost of the
+ * formatting stays in the figures
+ */
+#include "server/router.h"
+#include "server/placement.h"
+#include "server/socket_pool.h"
+#include "db/user_db.h"
+#include "util/user_cache.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#define MAX_RESULTS 64
+#define MAX_TRIALS 101
+#define NAME_POOL 1024              // Distinct usernames cycled by hash_username
+#define BASELINE_LINE_MAX 512
+#define AUTH_FILLER_USERS 100000    // Rows next to the benchmark user, all with its hash
+#define AUTH_PASSWORD "bench_password"
+
+typedef struct {
+    char name[64];
+    long ops;                       // Per trial
+    int trials;
+    double median_ns;
+    double min_ns;
+    double mean_ns;
+    double stddev_ns;
+} Result;
+
+typedef struct {
+    int trials;
+    int warmup;
+    const char* filter;             // Substring of the benchmark names to run
+    int json;
+    const char* baseline;
+    double threshold;               // Percent slower than the baseline's median that fails
+} Options;
+
+// One trial: ops operations, returns the seconds the timed part took
+typedef double (*TrialFn)(void* ctx, long ops);
+
+static Options options = { 7, 1, NULL, 0, NULL, 10.0 };
+static Result results[MAX_RESULTS];
+static int num_results;
+static FILE* out;                   // The real stdout
+static volatile uint64_t sink;      // Keeps results from being optimized out
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Groups skip their setup (a bcrypt hash, a million users) when the filter rules them out
+static int selected(const char* group) {
+    if (!options.filter) return 1;
+    return strstr(group, options.filter) != NULL ||
+           strncmp(options.filter, group, strlen(group)) == 0;
+}
+
+static void measure(const char* name, TrialFn trial, void* ctx, long ops) {
+    if (options.filter && !strstr(name, options.filter)) return;
+    if (num_results == MAX_RESULTS || ops <= 0) return;
+
+    for (int i = 0; i < options.warmup; i++) {
+        trial(ctx, ops);
+    }
+
+    double samples[MAX_TRIALS];
+    double total = 0;
+    for (int i = 0; i < options.trials; i++) {
+        samples[i] = trial(ctx, ops) * 1e9 / ops;
+        total += samples[i];
+    }
+    qsort(samples, options.trials, sizeof(double), compare_double);
+
+    Result* result = &results[num_results++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->ops = ops;
+    result->trials = options.trials;
+    result->min_ns = samples[0];
+    result->mean_ns = total / options.trials;
+    int middle = options.trials / 2;
+    result->median_ns = options.trials % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+    double variance = 0;
+    for (int i = 0; i < options.trials; i++) {
+        variance += (samples[i] - result->mean_ns) * (samples[i] - result->mean_ns);
+    }
+    result->stddev_ns = options.trials > 1 ? sqrt(variance / (options.trials - 1)) : 0;
+
+    if (!options.json) {
+        fprintf(out, "%-44s %12.1f ns/op  min %10.1f  mean %10.1f  sd %5.1f%%  (%ld ops x %d)\n",
+                result->name, result->median_ns, result->min_ns, result->mean_ns,
+                result->mean_ns > 0 ? result->stddev_ns / result->mean_ns * 100 : 0,
+                result->ops, result->trials);
+        fflush(out);
+    }
+}
+
+/* hash_username */
+
+typedef struct {
+    char names[NAME_POOL][MAX_USERNAME];
+} HashBench;
+
+static double hash_trial(void* ctx, long ops) {
+    HashBench* bench = (HashBench*)ctx;
+    uint64_t acc = 0;
+    double start = now_sec();
+    for (long i = 0; i < ops; i++) {
+        acc ^= hash_username(bench->names[i & (NAME_POOL - 1)], acc);
+    }
+    double elapsed = now_sec() - start;
+    sink = acc;
+    return elapsed;
+}
+
+static void bench_hash_username(void) {
+    if (!selected("hash_username")) return;
+
+    HashBench* bench = (HashBench*)malloc(sizeof(HashBench));
+    if (!bench) return;
+
+    int lengths[] = {8, 16, MAX_USERNAME - 1};
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        for (int i = 0; i < NAME_POOL; i++) {
+            // Distinct names of exactly the given length
+            snprintf(bench->names[i], MAX_USERNAME, "%0*d", lengths[l], i);
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "hash_username/len=%d", lengths[l]);
+        measure(name, hash_trial, bench, 10000000);
+    }
+    free(bench);
+}
+
+/* UserCache */
+
+typedef struct {
+    UserCache* cache;
+    char (*names)[MAX_USERNAME];    // fill resident users, then churn fresh ones
+    int fill;
+    int churn;                      // Users added and removed per round, keeps the fill within 10%
+} CacheBench;
+
+static double cache_get_trial(void* ctx, long ops) {
+    CacheBench* bench = (CacheBench*)ctx;
+    long acc = 0;
+    double start = now_sec();
+    // Scattered order so the hardware prefetcher does not help
+    for (long i = 0; i < ops; i++) {
+        int index = (int)(((uint64_t)i * 2654435761u) % bench->fill);
+        acc += get_user_port(bench->cache, bench->names[index]);
+    }
+    double elapsed = now_sec() - start;
+    sink = (uint64_t)acc;
+    return elapsed;
+}
+
+static double cache_add_trial(void* ctx, long ops) {
+    CacheBench* bench = (CacheBench*)ctx;
+    char (*fresh)[MAX_USERNAME] = bench->names + bench->fill;
+    double elapsed = 0;
+    for (long done = 0; done < ops; done += bench->churn) {
+        double start = now_sec();
+        for (int i = 0; i < bench->churn; i++) {
+            add_user(bench->cache, fresh[i], 8081 + i % 1000, (uint32_t)i + 1);
+        }
+        elapsed += now_sec() - start;
+        for (int i = 0; i < bench->churn; i++) {
+            remove_user(bench->cache, fresh[i]);
+        }
+    }
+    return elapsed;
+}
+
+static double cache_remove_trial(void* ctx, long ops) {
+    CacheBench* bench = (CacheBench*)ctx;
+    char (*fresh)[MAX_USERNAME] = bench->names + bench->fill;
+    double elapsed = 0;
+    for (long done = 0; done < ops; done += bench->churn) {
+        for (int i = 0; i < bench->churn; i++) {
+            add_user(bench->cache, fresh[i], 8081 + i % 1000, (uint32_t)i + 1);
+        }
+        double start = now_sec();
+        for (int i = 0; i < bench->churn; i++) {
+            remove_user(bench->cache, fresh[i]);
+        }
+        elapsed += now_sec() - start;
+    }
+    return elapsed;
+}
+
+static void bench_user_cache(void) {
+    if (!selected("user_cache")) return;
+
+    int fills[] = {1000, 100000, 1000000};
+    for (size_t f = 0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+        CacheBench bench;
+        bench.fill = fills[f];
+        bench.churn = fills[f] / 10;
+        bench.names = malloc((size_t)(bench.fill + bench.churn) * MAX_USERNAME);
+        bench.cache = create_user_cache();
+        if (!bench.names || !bench.cache) {
+            free(bench.names);
+            if (bench.cache) destroy_user_cache(bench.cache);
+            return;
+        }
+
+        for (int i = 0; i < bench.fill; i++) {
+            snprintf(bench.names[i], MAX_USERNAME, "player_%d", i);
+            add_user(bench.cache, bench.names[i], 8081 + i % 1000, (uint32_t)i + 1);
+        }
+        for (int i = 0; i < bench.churn; i++) {
+            snprintf(bench.names[bench.fill + i], MAX_USERNAME, "churn_%d", i);
+        }
+
+        // Whole rounds of churn, the same op count at every fill
+        long churn_ops = 100000 / bench.churn * bench.churn;
+        if (churn_ops == 0) churn_ops = bench.churn;
+
+        char name[64];
+        snprintf(name, sizeof(name), "user_cache/get_user_port/fill=%d", bench.fill);
+        measure(name, cache_get_trial, &bench, 1000000);
+        snprintf(name, sizeof(name), "user_cache/add_user/fill=%d", bench.fill);
+        measure(name, cache_add_trial, &bench, churn_ops);
+        snprintf(name, sizeof(name), "user_cache/remove_user/fill=%d", bench.fill);
+        measure(name, cache_remove_trial, &bench, churn_ops);
+
+        destroy_user_cache(bench.cache);
+        free(bench.names);
+    }
+}
+
+/* Socket assignment */
+
+typedef struct {
+    SocketPool* pools;
+    int num_pools;
+    Placement* placement;           // assign_user_socket only
+    Router router;                  // Only placement is set, all assign_user_socket reads
+    long round;                     // Assignments from empty to half full, then everything is released
+    uint32_t next_key;
+} AssignBench;
+
+static SocketPool* create_pools(int num_pools, int sockets_per_pool, int start_port) {
+    SocketPool* pools = (SocketPool*)calloc(num_pools, sizeof(SocketPool));
+    if (!pools) return NULL;
+
+    SocketConfig config = create_default_socket_config();
+    for (int i = 0; i < num_pools; i++) {
+        SocketPool* pool = create_socketpool(sockets_per_pool, USERS_PER_SOCKET,
+                                             start_port + i * sockets_per_pool, config, NULL, NULL);
+        if (!pool) {
+            free(pools);
+            return NULL;
+        }
+        pools[i] = *pool;
+        free(pool);
+    }
+    return pools;
+}
+
+static void destroy_pools(SocketPool* pools, int num_pools) {
+    for (int i = 0; i < num_pools; i++) {
+        delete_socketpool(&pools[i]);
+    }
+    free(pools);
+}
+
+// Untimed: every reservation back, and its load when placement is in use
+static void release_all(AssignBench* bench) {
+    for (int p = 0; p < bench->num_pools; p++) {
+        for (int s = 0; s < bench->pools[p].total_sockets; s++) {
+            Socket* sock = &bench->pools[p].sockets[s];
+            for (int slot = 0; slot < sock->conns.max_connections; slot++) {
+                if (sock->conns.clients[slot].state == SLOT_RESERVED) {
+                    release_socket_slot(sock, slot);
+                }
+            }
+        }
+    }
+    if (!bench->placement) return;
+    for (int e = 0; e < bench->placement->num_entries; e++) {
+        while (bench->placement->entries[e].load > 0) {
+            placement_release(bench->placement, e);
+        }
+    }
+}
+
+static uint32_t next_key(AssignBench* bench) {
+    if (++bench->next_key == 0) bench->next_key = 1;
+    return bench->next_key;
+}
+
+static double assign_trial(void* ctx, long ops) {
+    AssignBench* bench = (AssignBench*)ctx;
+    long acc = 0;
+    double elapsed = 0;
+    for (long done = 0; done < ops; done += bench->round) {
+        double start = now_sec();
+        for (long i = 0; i < bench->round; i++) {
+            acc += assign_user_socket(&bench->router, next_key(bench));
+        }
+        elapsed += now_sec() - start;
+        release_all(bench);
+    }
+    sink = (uint64_t)acc;
+    return elapsed;
+}
+
+static double find_open_trial(void* ctx, long ops) {
+    AssignBench* bench = (AssignBench*)ctx;
+    long acc = 0;
+    double elapsed = 0;
+    for (long done = 0; done < ops; done += bench->round) {
+        double start = now_sec();
+        for (long i = 0; i < bench->round; i++) {
+            acc += find_open_socket(&bench->pools[0], next_key(bench));
+        }
+        elapsed += now_sec() - start;
+        release_all(bench);
+    }
+    sink = (uint64_t)acc;
+    return elapsed;
+}
+
+// Whole rounds, at least 100k assignments per trial
+static long round_ops(long round) {
+    return round >= 100000 ? round : (100000 + round - 1) / round * round;
+}
+
+static void bench_assignment(void) {
+    char name[64];
+
+    if (selected("assign_user_socket")) {
+        int bucket_counts[] = {16, 256, 4096};
+        for (size_t b = 0; b < sizeof(bucket_counts) / sizeof(bucket_counts[0]); b++) {
+            AssignBench bench;
+            memset(&bench, 0, sizeof(bench));
+            bench.num_pools = bucket_counts[b];
+            bench.pools = create_pools(bench.num_pools, SOCKETS_PER_BUCKET, 20000);
+            if (!bench.pools) return;
+            bench.placement = create_placement(bench.pools, bench.num_pools);
+            if (!bench.placement) {
+                destroy_pools(bench.pools, bench.num_pools);
+                return;
+            }
+            bench.router.placement = bench.placement;
+
+            bench.round = (long)bench.num_pools * SOCKETS_PER_BUCKET * USERS_PER_SOCKET / 2;
+            snprintf(name, sizeof(name), "assign_user_socket/buckets=%d", bench.num_pools);
+            measure(name, assign_trial, &bench, round_ops(bench.round));
+
+            destroy_placement(bench.placement);
+            destroy_pools(bench.pools, bench.num_pools);
+        }
+    }
+
+    if (selected("find_open_socket")) {
+        int socket_counts[] = {SOCKETS_PER_BUCKET, 64};
+        for (size_t s = 0; s < sizeof(socket_counts) / sizeof(socket_counts[0]); s++) {
+            AssignBench bench;
+            memset(&bench, 0, sizeof(bench));
+            bench.num_pools = 1;
+            bench.pools = create_pools(1, socket_counts[s], 20000);
+            if (!bench.pools) return;
+
+            bench.round = (long)socket_counts[s] * USERS_PER_SOCKET / 2;
+            snprintf(name, sizeof(name), "find_open_socket/sockets=%d", socket_counts[s]);
+            measure(name, find_open_trial, &bench, round_ops(bench.round));
+
+            destroy_pools(bench.pools, 1);
+        }
+    }
+}
+
+/* Session keys */
+
+static double session_key_trial(void* ctx, long ops) {
+    (void)ctx;
+    uint32_t acc = 0;
+    double start = now_sec();
+    for (long i = 0; i < ops; i++) {
+        acc ^= generate_session_key();
+    }
+    double elapsed = now_sec() - start;
+    sink = acc;
+    return elapsed;
+}
+
+static void bench_session_key(void) {
+    if (!selected("generate_session_key")) return;
+    measure("generate_session_key", session_key_trial, NULL, 20000);
+}
+
+/* authenticate_user */
+
+typedef struct {
+    UserDB* db;
+    const char* password;
+    int expect;
+    long cursor;
+} AuthBench;
+
+static double auth_trial(void* ctx, long ops) {
+    AuthBench* bench = (AuthBench*)ctx;
+    long failures = 0;
+    char username[MAX_USERNAME];
+    double elapsed = 0;
+    for (long i = 0; i < ops; i++) {
+        // Success logs in the benchmark user, the others look up users that do not exist
+        if (bench->expect == DB_SUCCESS) {
+            snprintf(username, sizeof(username), "bench_user");
+        } else {
+            snprintf(username, sizeof(username), "nobody_%ld", bench->cursor++);
+        }
+        double start = now_sec();
+        failures += authenticate_user(bench->db, username, bench->password) != bench->expect;
+        elapsed += now_sec() - start;
+    }
+    sink = (uint64_t)failures;
+    return elapsed;
+}
+
+static double update_last_login_trial(void* ctx, long ops) {
+    AuthBench* bench = (AuthBench*)ctx;
+    long failures = 0;
+    double start = now_sec();
+    for (long i = 0; i < ops; i++) {
+        failures += update_last_login(bench->db, "bench_user") != DB_SUCCESS;
+    }
+    double elapsed = now_sec() - start;
+    sink = (uint64_t)failures;
+    return elapsed;
+}
+
+// What a login pays now: queueing for the login writer, which batches the writes
+static double record_login_trial(void* ctx, long ops) {
+    AuthBench* bench = (AuthBench*)ctx;
+    long failures = 0;
+    double start = now_sec();
+    for (long i = 0; i < ops; i++) {
+        failures += record_login(bench->db, "bench_user") != DB_SUCCESS;
+    }
+    double elapsed = now_sec() - start;
+    sink = (uint64_t)failures;
+    return elapsed;
+}
+
+// Rows with the benchmark user's hash, so lookups walk a realistically deep index
+static int add_filler_users(UserDB* db, int count) {
+    sqlite3* handle = user_db_connection(db)->db;
+    sqlite3_stmt* select = NULL;
+    sqlite3_stmt* insert = NULL;
+    int result = -1;
+
+    if (sqlite3_prepare_v2(handle, "SELECT password_hash FROM users WHERE username = 'bench_user'", -1, &select, NULL) != SQLITE_OK ||
+        sqlite3_step(select) != SQLITE_ROW) {
+        goto done;
+    }
+    const char* hash = (const char*)sqlite3_column_text(select, 0);
+    if (sqlite3_prepare_v2(handle, "INSERT INTO users (username, password_hash, created_at) VALUES (?, ?, ?)", -1, &insert, NULL) != SQLITE_OK) {
+        goto done;
+    }
+
+    sqlite3_exec(handle, "BEGIN", NULL, NULL, NULL);
+    for (int i = 0; i < count; i++) {
+        char username[MAX_USERNAME];
+        snprintf(username, sizeof(username), "filler_%d", i);
+        sqlite3_bind_text(insert, 1, username, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(insert, 2, hash, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(insert, 3, time(NULL));
+        if (sqlite3_step(insert) != SQLITE_DONE) break;
+        sqlite3_reset(insert);
+    }
+    sqlite3_exec(handle, "COMMIT", NULL, NULL, NULL);
+    result = 1;
+
+done:
+    sqlite3_finalize(select);
+    sqlite3_finalize(insert);
+    return result;
+}
+
+static void bench_authenticate(void) {
+    if (!selected("authenticate_user") && !selected("update_last_login") && !selected("record_login")) return;
+
+    UserDB* db = init_user_db(":memory:");
+    if (!db) {
+        fprintf(stderr, "Cannot open an in-memory database\n");
+        return;
+    }
+    if (create_user(db, "bench_user", AUTH_PASSWORD) != DB_SUCCESS ||
+        add_filler_users(db, AUTH_FILLER_USERS) < 0) {
+        fprintf(stderr, "Cannot populate the benchmark database\n");
+        close_user_db(db);
+        return;
+    }
+
+    char name[64];
+    AuthBench bench = { db, AUTH_PASSWORD, DB_AUTH_FAILED, 0 };
+    snprintf(name, sizeof(name), "authenticate_user/unknown/users=%d", AUTH_FILLER_USERS + 1);
+    measure(name, auth_trial, &bench, 20000);
+
+    snprintf(name, sizeof(name), "update_last_login/users=%d", AUTH_FILLER_USERS + 1);
+    measure(name, update_last_login_trial, &bench, 20000);
+    snprintf(name, sizeof(name), "record_login/users=%d", AUTH_FILLER_USERS + 1);
+    // One batch per trial: the writer takes it at the end, so no trial waits on a full buffer
+    measure(name, record_login_trial, &bench, DB_LOGIN_BATCH);
+
+    // bcrypt at the server's work factor, one login per trial is plenty
+    bench.expect = DB_SUCCESS;
+    snprintf(name, sizeof(name), "authenticate_user/success/users=%d", AUTH_FILLER_USERS + 1);
+    measure(name, auth_trial, &bench, 1);
+
+    close_user_db(db);
+}
+
+/* Output and baseline */
+
+static void print_json(void) {
+    fprintf(out, "{\"bench\": \"hotpath\", \"trials\": %d, \"warmup\": %d, \"results\": [\n",
+            options.trials, options.warmup);
+    for (int i = 0; i < num_results; i++) {
+        Result* r = &results[i];
+        fprintf(out, "  {\"name\": \"%s\", \"ops\": %ld, \"trials\": %d, \"median_ns\": %.3f, \"min_ns\": %.3f, \"mean_ns\": %.3f, \"stddev_ns\": %.3f}%s\n",
+                r->name, r->ops, r->trials, r->median_ns, r->min_ns, r->mean_ns, r->stddev_ns,
+                i + 1 < num_results ? "," : "");
+    }
+    fprintf(out, "]}\n");
+}
+
+static Result* find_result(const char* name) {
+    for (int i = 0; i < num_results; i++) {
+        if (strcmp(results[i].name, name) == 0) return &results[i];
+    }
+    return NULL;
+}
+
+/*
+ * Reads what print_json writes, one result per line, not JSON in general
+ * @return the number of regressions, -1 if the file cannot be read
+ */
+static int compare_baseline(const char* path, FILE* report) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open baseline %s\n", path);
+        return -1;
+    }
+
+    fprintf(report, "\nAgainst %s (median ns/op, threshold +%.1f%%)\n", path, options.threshold);
+    int regressions = 0;
+    int compared = 0;
+    char line[BASELINE_LINE_MAX];
+    while (fgets(line, sizeof(line), file)) {
+        char name[64];
+        double baseline_ns;
+        const char* start = strstr(line, "{\"name\": \"");
+        if (!start || sscanf(start, "{\"name\": \"%63[^\"]\"", name) != 1) continue;
+        const char* median = strstr(line, "\"median_ns\": ");
+        if (!median || sscanf(median, "\"median_ns\": %lf", &baseline_ns) != 1) continue;
+
+        Result* result = find_result(name);
+        if (!result) continue;
+        compared++;
+
+        double change = baseline_ns > 0 ? (result->median_ns - baseline_ns) / baseline_ns * 100 : 0;
+        const char* verdict = "";
+        if (change > options.threshold) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (change < -options.threshold) {
+            verdict = "faster";
+        }
+        fprintf(report, "%-44s %12.1f -> %12.1f  %+7.1f%%  %s\n", name, baseline_ns, result->median_ns, change, verdict);
+    }
+    fclose(file);
+
+    fprintf(report, "%d compared, %d regressions\n", compared, regressions);
+    return regressions;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -n, --trials N        timed trials per benchmark, at most %d (%d)\n"
+            "  -w, --warmup N        untimed trials first (%d)\n"
+            "  -f, --filter TEXT     only benchmarks whose name contains TEXT\n"
+            "  -j, --json            JSON report, one result per line\n"
+            "  -b, --baseline FILE   compare with a -j report, exit 1 on a regression\n"
+            "  -T, --threshold PCT   median slowdown that counts as a regression (%.0f)\n",
+            program, MAX_TRIALS, options.trials, options.warmup, options.threshold);
+}
+
+int main(int argc, char** argv) {
+    static const struct option long_options[] = {
+        { "trials", required_argument, NULL, 'n' },
+        { "warmup", required_argument, NULL, 'w' },
+        { "filter", required_argument, NULL, 'f' },
+        { "json", no_argument, NULL, 'j' },
+        { "baseline", required_argument, NULL, 'b' },
+        { "threshold", required_argument, NULL, 'T' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "n:w:f:jb:T:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'n': options.trials = atoi(optarg); break;
+            case 'w': options.warmup = atoi(optarg); break;
+            case 'f': options.filter = optarg; break;
+            case 'j': options.json = 1; break;
+            case 'b': options.baseline = optarg; break;
+            case 'T': options.threshold = atof(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (options.trials < 1 || options.trials > MAX_TRIALS || options.warmup < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Report on the real stdout, server logging to /dev/null
+    int report_fd = dup(STDOUT_FILENO);
+    out = report_fd >= 0 ? fdopen(report_fd, "w") : NULL;
+    if (!out || !freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Cannot set up output\n");
+        return 1;
+    }
+
+    bench_hash_username();
+    bench_user_cache();
+    bench_assignment();
+    bench_session_key();
+    bench_authenticate();
+
+    if (options.json) print_json();
+
+    int status = 0;
+    if (options.baseline) {
+        int regressions = compare_baseline(options.baseline, options.json ? stderr : out);
+        status = regressions != 0 ? 1 : 0;
+    }
+    fclose(out);
+    return status;
+}
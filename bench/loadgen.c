@@ -0,0 +1,676 @@
+/*
+ * bench/loadgen.c
+ * End-to-end load generator: many clients through REG, AUTH, session connect and SEND
+ *
+ * Each thread drives its share of the clients from its own epoll set. A client
+ * registers and authenticates on the router port (binary frames, pipelined),
+ * connects to the port it was given and sends its session key, then sends a
+ * SEND to the next client every think time. Bodies carry the send time, so the
+ * receiving client measures delivery latency (both ends share the host clock).
+ * The server must have room for the clients (NUMBER_OF_USERS in router.h)
+ * The messaging window (duration) starts once every client is connected or
+ * has failed: bcrypt makes logins slow, and they should not eat into it
+ *
+ * Usage: loadgen [-c clients] [-t threads] [-r ramp/s] [-d seconds] [-k think ms]
+ *                [-s message bytes] [-H host] [-p port] [-u prefix] [-x] [-j]
+ */
+#include "server/protocol.h"
+#include "util/histogram.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define MAX_THREADS 64
+#define MAX_EVENTS 256
+#define NAME_LENGTH 32          // MAX_USERNAME_LENGTH on the server
+#define PASSWORD "loadgen-pw"
+#define OUT_BUFFER 8192         // Unsent requests per client, a SEND is skipped while it is full
+#define DRAIN_MS 1000           // Reading on after the last SEND, for messages still in flight
+#define MAX_TICK_MS 50          // Longest epoll wait, bounds how late a start or send can be
+#define LOGIN_TIMEOUT_S 120     // After the last start, messaging is timed even if logins are still pending
+#define ACCEPTED_LINE "Connection accepted\n"
+
+enum {
+    CLIENT_WAITING,             // Not started yet (ramp)
+    CLIENT_ROUTER_CONNECT,
+    CLIENT_LOGIN,               // REG and AUTH sent, waiting for both replies
+    CLIENT_SOCKET_CONNECT,
+    CLIENT_HANDSHAKE,           // Session key sent, waiting for ACCEPTED_LINE
+    CLIENT_ACTIVE,
+    CLIENT_DONE,                // Failed or closed
+};
+
+typedef struct {
+    char host[64];
+    int router_port;
+    int clients;
+    int threads;
+    double ramp;                // Clients started per second, 0 = all at once
+    double duration;            // Seconds of messaging once every client connected or failed
+    int think_ms;               // Between a client's messages, 0 = log in only
+    int message_size;           // Body bytes, send timestamp included
+    char prefix[16];
+    int handoff;                // Server runs with ROUTER_FD_HANDOFF
+    int json;
+} Options;
+
+typedef struct {
+    int id;
+    int state;
+    int fd;
+    int replies;                // Router replies seen
+    int want_out;               // EPOLLOUT registered
+    uint16_t port;
+    uint32_t session_key;
+    uint64_t start_at;
+    uint64_t login_at;          // REG and AUTH sent
+    uint64_t connect_at;        // Socket connect started
+    uint64_t next_send_at;
+    FrameParser parser;
+    uint8_t in[PROTO_BUFFER_SIZE];
+    uint8_t out[OUT_BUFFER];
+    size_t out_start;
+    size_t out_end;
+    char name[NAME_LENGTH];
+} Client;
+
+typedef struct {
+    unsigned long logins;
+    unsigned long login_failures;
+    unsigned long connects;
+    unsigned long connect_failures;
+    unsigned long messages_sent;
+    unsigned long messages_received;
+    unsigned long message_errors;   // ERROR replies on user sockets (recipient offline, output full)
+    unsigned long sends_skipped;    // Client's own output still full at send time
+    unsigned long disconnects;      // Active clients the server closed
+    uint64_t last_login_at;
+    uint64_t last_connect_at;
+    uint64_t first_send_at;
+    Histogram login_latency;        // REG + AUTH sent until SESSION
+    Histogram connect_latency;      // Socket connect until accepted
+    Histogram message_latency;      // SEND written until MESSAGE read
+} Stats;
+
+typedef struct {
+    int index;
+    int epoll_fd;
+    Client* clients;
+    int num_clients;
+    Stats stats;
+} Worker;
+
+static Options options;
+static struct sockaddr_in router_address;
+static uint64_t run_start;
+static uint64_t start_end;      // Last client's start time
+static uint64_t send_end;       // Messaging window end, 0 (no SEND yet) until every client settled
+static int settled;             // Clients connected or failed
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void client_name(int id, char* name) {
+    snprintf(name, NAME_LENGTH, "%s%d", options.prefix, id);
+}
+
+// Once the last client settles, the messaging window starts
+static void client_settled(void) {
+    if (__atomic_add_fetch(&settled, 1, __ATOMIC_ACQ_REL) == options.clients) {
+        __atomic_store_n(&send_end, now_ns() + (uint64_t)(options.duration * 1e9), __ATOMIC_RELEASE);
+    }
+}
+
+static void client_fail(Worker* worker, Client* client, int active) {
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+    if (active) {
+        worker->stats.disconnects++;
+    } else if (client->state == CLIENT_ROUTER_CONNECT || client->state == CLIENT_LOGIN) {
+        worker->stats.login_failures++;
+    } else {
+        worker->stats.connect_failures++;
+    }
+    if (!active) client_settled();
+    client->state = CLIENT_DONE;
+}
+
+// Non-blocking connect, completion shows up as EPOLLOUT
+static int client_connect(Worker* worker, Client* client, uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct sockaddr_in address = router_address;
+    address.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN | EPOLLOUT, .data.ptr = client };
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        close(fd);
+        return -1;
+    }
+    client->fd = fd;
+    client->want_out = 1;
+    client->out_start = client->out_end = 0;
+    frame_parser_init(&client->parser, client->in, sizeof(client->in), PROTO_MODE_RAW);
+    return 1;
+}
+
+static int client_queue(Client* client, const void* data, size_t length) {
+    if (client->out_start == client->out_end) {
+        client->out_start = client->out_end = 0;
+    }
+    if (OUT_BUFFER - client->out_end < length) return -1;
+    memcpy(client->out + client->out_end, data, length);
+    client->out_end += length;
+    return 1;
+}
+
+// Write what is queued, EPOLLOUT stays armed while anything is left
+static int client_flush(Worker* worker, Client* client) {
+    while (client->out_start < client->out_end) {
+        ssize_t sent = send(client->fd, client->out + client->out_start,
+                            client->out_end - client->out_start, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        client->out_start += sent;
+    }
+
+    int want_out = client->out_start < client->out_end;
+    if (want_out == client->want_out) return 1;
+
+    struct epoll_event event = { .events = EPOLLIN | (want_out ? EPOLLOUT : 0), .data.ptr = client };
+    client->want_out = want_out;
+    return epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+}
+
+static size_t encode_credentials(uint8_t* out, size_t size, uint8_t opcode, const char* name) {
+    uint8_t payload[2 + NAME_LENGTH + sizeof(PASSWORD)];
+    size_t name_length = strlen(name);
+    size_t password_length = strlen(PASSWORD);
+    payload[0] = (uint8_t)name_length;
+    memcpy(payload + 1, name, name_length);
+    payload[1 + name_length] = (uint8_t)password_length;
+    memcpy(payload + 2 + name_length, PASSWORD, password_length);
+    return proto_encode_frame(out, size, opcode, 0, payload, (uint32_t)(2 + name_length + password_length));
+}
+
+static void client_start(Worker* worker, Client* client) {
+    client->state = CLIENT_ROUTER_CONNECT;
+    if (client_connect(worker, client, (uint16_t)options.router_port) < 0) {
+        client_fail(worker, client, 0);
+        return;
+    }
+
+    // REG then AUTH in one write, the router answers them in order
+    uint8_t request[2 * PROTO_HEADER_SIZE + 2 * (2 + NAME_LENGTH + sizeof(PASSWORD))];
+    size_t length = encode_credentials(request, sizeof(request), PROTO_OP_REG, client->name);
+    length += encode_credentials(request + length, sizeof(request) - length, PROTO_OP_AUTH, client->name);
+    client_queue(client, request, length);
+    client->replies = 0;
+    client->login_at = now_ns();
+}
+
+static void client_send_message(Worker* worker, Client* client, uint64_t now) {
+    char recipient[NAME_LENGTH];
+    client_name((client->id + 1) % options.clients, recipient);
+    size_t recipient_length = strlen(recipient);
+
+    uint8_t frame[PROTO_BUFFER_SIZE];
+    uint32_t payload_length = (uint32_t)(1 + recipient_length + options.message_size);
+    uint8_t* payload = frame + PROTO_HEADER_SIZE;
+    proto_encode_header(frame, PROTO_OP_SEND, 0, payload_length);
+    payload[0] = (uint8_t)recipient_length;
+    memcpy(payload + 1, recipient, recipient_length);
+    uint8_t* body = payload + 1 + recipient_length;
+    memset(body, 'x', options.message_size);
+    memcpy(body, &now, sizeof(now));
+
+    if (client_queue(client, frame, PROTO_HEADER_SIZE + payload_length) < 0) {
+        worker->stats.sends_skipped++;
+        return;
+    }
+    if (worker->stats.first_send_at == 0) worker->stats.first_send_at = now;
+    worker->stats.messages_sent++;
+}
+
+static void client_session(Worker* worker, Client* client, const Frame* frame, uint64_t now) {
+    if (frame->length < 6) {
+        client_fail(worker, client, 0);
+        return;
+    }
+
+    worker->stats.logins++;
+    worker->stats.last_login_at = now;
+    histogram_record(&worker->stats.login_latency, now - client->login_at);
+
+    client->port = (uint16_t)((frame->payload[0] << 8) | frame->payload[1]);
+    client->session_key = ((uint32_t)frame->payload[2] << 24) | ((uint32_t)frame->payload[3] << 16) |
+                          ((uint32_t)frame->payload[4] << 8) | frame->payload[5];
+    client->connect_at = now;
+
+    // With fd handoff the router passes this connection on and the socket answers on it
+    if (options.handoff) {
+        client->state = CLIENT_HANDSHAKE;
+        return;
+    }
+
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+    client->state = CLIENT_SOCKET_CONNECT;
+    if (client_connect(worker, client, client->port) < 0) {
+        client_fail(worker, client, 0);
+        return;
+    }
+    client_queue(client, &client->session_key, sizeof(client->session_key));
+}
+
+// Router replies: REG (OK, or ERROR if the user exists) then AUTH (SESSION or ERROR)
+static void client_login_frame(Worker* worker, Client* client, const Frame* frame, uint64_t now) {
+    client->replies++;
+    if (frame->opcode == PROTO_OP_SESSION) {
+        client_session(worker, client, frame, now);
+    } else if (client->replies >= 2) {
+        client_fail(worker, client, 0);
+    }
+}
+
+static void client_active_frame(Worker* worker, const Frame* frame, uint64_t now) {
+    if (frame->opcode == PROTO_OP_ERROR) {
+        worker->stats.message_errors++;
+        return;
+    }
+    if (frame->opcode != PROTO_OP_MESSAGE || frame->length < 1) return;
+
+    size_t body_offset = 1 + (size_t)frame->payload[0];
+    if (frame->length < body_offset + sizeof(uint64_t)) return;
+
+    uint64_t sent_at;
+    memcpy(&sent_at, frame->payload + body_offset, sizeof(sent_at));
+    worker->stats.messages_received++;
+    if (now > sent_at) {
+        histogram_record(&worker->stats.message_latency, now - sent_at);
+    }
+}
+
+// Accepted line ends the handshake, frames may follow in the same read
+static int client_handshake(Worker* worker, Client* client, uint64_t now) {
+    FrameParser* parser = &client->parser;
+    const uint8_t* start = parser->data + parser->start;
+    const uint8_t* newline = memchr(start, '\n', frame_parser_pending(parser));
+    if (!newline) return 0;
+
+    size_t line_length = (size_t)(newline - start) + 1;
+    int accepted = line_length == strlen(ACCEPTED_LINE) && memcmp(start, ACCEPTED_LINE, line_length) == 0;
+    parser->start += line_length;
+    if (!accepted) {
+        client_fail(worker, client, 0);
+        return -1;
+    }
+
+    worker->stats.connects++;
+    worker->stats.last_connect_at = now;
+    histogram_record(&worker->stats.connect_latency, now - client->connect_at);
+    client->state = CLIENT_ACTIVE;
+    client_settled();
+    // Spread the first SENDs over one think time
+    client->next_send_at = now + (options.think_ms ? (uint64_t)(client->id * 7919 % options.think_ms) * 1000000ULL : 0);
+
+    // The parser decides binary mode from the first byte after the line
+    parser->mode = PROTO_MODE_UNKNOWN;
+    return 1;
+}
+
+// Reads until the socket is drained, or the client moved on to its user socket
+static void client_readable(Worker* worker, Client* client) {
+    while (client->state == CLIENT_LOGIN || client->state == CLIENT_HANDSHAKE || client->state == CLIENT_ACTIVE) {
+        size_t available;
+        uint8_t* space = frame_parser_space(&client->parser, &available);
+        ssize_t received = available ? recv(client->fd, space, available, 0) : 0;
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (received <= 0) {
+            client_fail(worker, client, client->state == CLIENT_ACTIVE);
+            return;
+        }
+        frame_parser_commit(&client->parser, (size_t)received);
+
+        uint64_t now = now_ns();
+        if (client->state == CLIENT_HANDSHAKE && client_handshake(worker, client, now) <= 0) {
+            continue;
+        }
+
+        Frame frame;
+        int result = 0;
+        while ((client->state == CLIENT_LOGIN || client->state == CLIENT_ACTIVE) &&
+               (result = frame_parser_next(&client->parser, &frame)) > 0) {
+            if (client->state == CLIENT_LOGIN) {
+                client_login_frame(worker, client, &frame, now);
+                // The rest of this buffer belongs to the handshake
+                if (client->state == CLIENT_HANDSHAKE && client_handshake(worker, client, now) <= 0) break;
+            } else if (client->state == CLIENT_ACTIVE) {
+                client_active_frame(worker, &frame, now);
+            }
+        }
+        if (result < 0 && client->state != CLIENT_DONE) {
+            client_fail(worker, client, client->state == CLIENT_ACTIVE);
+        }
+    }
+}
+
+static void client_event(Worker* worker, Client* client, uint32_t events) {
+    if (client->state == CLIENT_DONE) return;
+
+    if (client->state == CLIENT_ROUTER_CONNECT || client->state == CLIENT_SOCKET_CONNECT) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+            client_fail(worker, client, 0);
+            return;
+        }
+        client->state = client->state == CLIENT_ROUTER_CONNECT ? CLIENT_LOGIN : CLIENT_HANDSHAKE;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        client_readable(worker, client);
+    }
+    if (client->state != CLIENT_DONE && client_flush(worker, client) < 0) {
+        client_fail(worker, client, client->state == CLIENT_ACTIVE);
+    }
+}
+
+// Start clients whose ramp time came and send for those whose think time passed
+static uint64_t run_due(Worker* worker, uint64_t now) {
+    uint64_t next = now + MAX_TICK_MS * 1000000ULL;
+    uint64_t end = __atomic_load_n(&send_end, __ATOMIC_ACQUIRE);
+
+    for (int i = 0; i < worker->num_clients; i++) {
+        Client* client = &worker->clients[i];
+        if (client->state == CLIENT_WAITING) {
+            if (client->start_at <= now) {
+                client_start(worker, client);
+                if (client->state != CLIENT_DONE) client_flush(worker, client);
+            } else if (client->start_at < next) {
+                next = client->start_at;
+            }
+        } else if (client->state == CLIENT_ACTIVE && options.think_ms > 0 && end != 0 && now < end) {
+            if (client->next_send_at <= now) {
+                client_send_message(worker, client, now);
+                client_flush(worker, client);
+                // Keep the schedule, but never burst to catch up
+                client->next_send_at += options.think_ms * 1000000ULL;
+                if (client->next_send_at <= now) client->next_send_at = now + options.think_ms * 1000000ULL;
+            }
+            if (client->next_send_at < next) next = client->next_send_at;
+        }
+    }
+    return next;
+}
+
+static void* worker_thread(void* arg) {
+    Worker* worker = (Worker*)arg;
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t login_deadline = start_end + LOGIN_TIMEOUT_S * 1000000000ULL;
+
+    while (1) {
+        uint64_t now = now_ns();
+        uint64_t end = __atomic_load_n(&send_end, __ATOMIC_ACQUIRE);
+        if (end == 0 && now >= login_deadline) {
+            // Stragglers still logging in, time the window from here
+            uint64_t expected = 0;
+            end = now + (uint64_t)(options.duration * 1e9);
+            if (!__atomic_compare_exchange_n(&send_end, &expected, end, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                end = expected;
+            }
+        }
+        uint64_t stop_at = end ? end + DRAIN_MS * 1000000ULL : UINT64_MAX;
+        if (now >= stop_at) break;
+
+        uint64_t next = run_due(worker, now);
+        if (next > stop_at) next = stop_at;
+        now = now_ns();
+        int timeout = next > now ? (int)((next - now + 999999) / 1000000) : 0;
+
+        int count = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, timeout);
+        if (count < 0 && errno != EINTR) break;
+        for (int i = 0; i < count; i++) {
+            client_event(worker, (Client*)events[i].data.ptr, events[i].events);
+        }
+    }
+
+    for (int i = 0; i < worker->num_clients; i++) {
+        if (worker->clients[i].fd >= 0) close(worker->clients[i].fd);
+    }
+    return NULL;
+}
+
+static void merge_stats(Stats* into, const Stats* from) {
+    into->logins += from->logins;
+    into->login_failures += from->login_failures;
+    into->connects += from->connects;
+    into->connect_failures += from->connect_failures;
+    into->messages_sent += from->messages_sent;
+    into->messages_received += from->messages_received;
+    into->message_errors += from->message_errors;
+    into->sends_skipped += from->sends_skipped;
+    into->disconnects += from->disconnects;
+    if (from->last_login_at > into->last_login_at) into->last_login_at = from->last_login_at;
+    if (from->last_connect_at > into->last_connect_at) into->last_connect_at = from->last_connect_at;
+    if (from->first_send_at && (!into->first_send_at || from->first_send_at < into->first_send_at)) {
+        into->first_send_at = from->first_send_at;
+    }
+    histogram_merge(&into->login_latency, &from->login_latency);
+    histogram_merge(&into->connect_latency, &from->connect_latency);
+    histogram_merge(&into->message_latency, &from->message_latency);
+}
+
+static double rate(unsigned long count, uint64_t from, uint64_t to) {
+    return to > from ? count / ((to - from) / 1e9) : 0.0;
+}
+
+static void print_latency(const char* name, const Histogram* histogram, int json, int last) {
+    double p50 = histogram_percentile(histogram, 50) / 1e6;
+    double p90 = histogram_percentile(histogram, 90) / 1e6;
+    double p99 = histogram_percentile(histogram, 99) / 1e6;
+    double p999 = histogram_percentile(histogram, 99.9) / 1e6;
+    double max = histogram_max(histogram) / 1e6;
+    if (json) {
+        printf("    \"%s\": {\"count\": %llu, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}%s\n",
+               name, (unsigned long long)histogram->count, p50, p90, p99, p999, max, last ? "" : ",");
+    } else {
+        printf("%-8s latency ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f  (%llu samples)\n",
+               name, p50, p90, p99, p999, max, (unsigned long long)histogram->count);
+    }
+}
+
+static void report(const Stats* stats, uint64_t end) {
+    double logins_per_sec = rate(stats->logins, run_start, stats->last_login_at);
+    double connects_per_sec = rate(stats->connects, run_start, stats->last_connect_at);
+    double messages_per_sec = rate(stats->messages_received, stats->first_send_at, send_end);
+
+    if (options.json) {
+        printf("{\n  \"bench\": \"loadgen\",\n");
+        printf("  \"config\": {\"clients\": %d, \"threads\": %d, \"ramp\": %.1f, \"duration\": %.1f, "
+               "\"think_ms\": %d, \"message_size\": %d, \"handoff\": %d},\n",
+               options.clients, options.threads, options.ramp, options.duration,
+               options.think_ms, options.message_size, options.handoff);
+        printf("  \"elapsed_s\": %.3f,\n", (end - run_start) / 1e9);
+        printf("  \"logins\": %lu, \"login_failures\": %lu, \"logins_per_s\": %.1f,\n",
+               stats->logins, stats->login_failures, logins_per_sec);
+        printf("  \"connects\": %lu, \"connect_failures\": %lu, \"connects_per_s\": %.1f,\n",
+               stats->connects, stats->connect_failures, connects_per_sec);
+        printf("  \"messages_sent\": %lu, \"messages_received\": %lu, \"messages_per_s\": %.1f,\n",
+               stats->messages_sent, stats->messages_received, messages_per_sec);
+        printf("  \"message_errors\": %lu, \"sends_skipped\": %lu, \"disconnects\": %lu,\n",
+               stats->message_errors, stats->sends_skipped, stats->disconnects);
+        printf("  \"latency_ms\": {\n");
+        print_latency("login", &stats->login_latency, 1, 0);
+        print_latency("connect", &stats->connect_latency, 1, 0);
+        print_latency("message", &stats->message_latency, 1, 1);
+        printf("  }\n}\n");
+        return;
+    }
+
+    printf("loadgen: %d clients, %d threads, %.3f s\n", options.clients, options.threads, (end - run_start) / 1e9);
+    printf("logins   %lu ok, %lu failed, %.1f/s\n", stats->logins, stats->login_failures, logins_per_sec);
+    printf("connects %lu ok, %lu failed, %.1f/s\n", stats->connects, stats->connect_failures, connects_per_sec);
+    printf("messages %lu sent, %lu received, %.1f/s, %lu errors, %lu skipped, %lu disconnects\n",
+           stats->messages_sent, stats->messages_received, messages_per_sec,
+           stats->message_errors, stats->sends_skipped, stats->disconnects);
+    print_latency("login", &stats->login_latency, 0, 0);
+    print_latency("connect", &stats->connect_latency, 0, 0);
+    print_latency("message", &stats->message_latency, 0, 1);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -c, --clients N      simulated users (100)\n"
+            "  -t, --threads N      client threads (cores, at most 4)\n"
+            "  -r, --ramp N         clients started per second, 0 = all at once (0)\n"
+            "  -d, --duration S     seconds of messaging once every client is in (10)\n"
+            "  -k, --think MS       between a client's messages, 0 = log in only (100)\n"
+            "  -s, --size BYTES     message body size, at least 8 (64)\n"
+            "  -H, --host ADDR      server address (127.0.0.1)\n"
+            "  -p, --port PORT      router port (8080)\n"
+            "  -u, --prefix NAME    username prefix (lg<pid>-)\n"
+            "  -x, --handoff        server runs with ROUTER_FD_HANDOFF\n"
+            "  -j, --json           machine-readable report\n",
+            program);
+}
+
+static int parse_options(int argc, char** argv) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    options.clients = 100;
+    options.threads = cores < 4 ? (int)cores : 4;
+    options.ramp = 0;
+    options.duration = 10;
+    options.think_ms = 100;
+    options.message_size = 64;
+    snprintf(options.host, sizeof(options.host), "127.0.0.1");
+    options.router_port = 8080;
+    snprintf(options.prefix, sizeof(options.prefix), "lg%d-", (int)getpid() % 100000);
+
+    static const struct option long_options[] = {
+        { "clients", required_argument, NULL, 'c' }, { "threads", required_argument, NULL, 't' },
+        { "ramp", required_argument, NULL, 'r' }, { "duration", required_argument, NULL, 'd' },
+        { "think", required_argument, NULL, 'k' }, { "size", required_argument, NULL, 's' },
+        { "host", required_argument, NULL, 'H' }, { "port", required_argument, NULL, 'p' },
+        { "prefix", required_argument, NULL, 'u' }, { "handoff", no_argument, NULL, 'x' },
+        { "json", no_argument, NULL, 'j' }, { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "c:t:r:d:k:s:H:p:u:xjh", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'c': options.clients = atoi(optarg); break;
+            case 't': options.threads = atoi(optarg); break;
+            case 'r': options.ramp = atof(optarg); break;
+            case 'd': options.duration = atof(optarg); break;
+            case 'k': options.think_ms = atoi(optarg); break;
+            case 's': options.message_size = atoi(optarg); break;
+            case 'H': snprintf(options.host, sizeof(options.host), "%s", optarg); break;
+            case 'p': options.router_port = atoi(optarg); break;
+            case 'u': snprintf(options.prefix, sizeof(options.prefix), "%s", optarg); break;
+            case 'x': options.handoff = 1; break;
+            case 'j': options.json = 1; break;
+            default: usage(argv[0]); return -1;
+        }
+    }
+
+    // Recipient name and length byte share the frame with the body
+    int max_size = PROTO_MAX_PAYLOAD - 1 - NAME_LENGTH;
+    if (options.clients < 1 || options.threads < 1 || options.duration < 0 || options.think_ms < 0 ||
+        options.message_size < (int)sizeof(uint64_t) || options.message_size > max_size) {
+        fprintf(stderr, "Invalid options (message size must be 8..%d)\n", max_size);
+        return -1;
+    }
+    if (options.threads > MAX_THREADS) options.threads = MAX_THREADS;
+    if (options.threads > options.clients) options.threads = options.clients;
+
+    memset(&router_address, 0, sizeof(router_address));
+    router_address.sin_family = AF_INET;
+    if (inet_pton(AF_INET, options.host, &router_address.sin_addr) != 1) {
+        fprintf(stderr, "Invalid host %s\n", options.host);
+        return -1;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (parse_options(argc, argv) < 0) return 1;
+
+    Worker* workers = (Worker*)calloc(options.threads, sizeof(Worker));
+    Client* clients = (Client*)calloc(options.clients, sizeof(Client));
+    if (!workers || !clients) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    run_start = now_ns() + 10000000ULL;
+    start_end = run_start + (options.ramp > 0 ? (uint64_t)((options.clients - 1) / options.ramp * 1e9) : 0);
+
+    // Each thread drives a contiguous range of clients
+    int offset = 0;
+    for (int t = 0; t < options.threads; t++) {
+        Worker* worker = &workers[t];
+        worker->index = t;
+        worker->clients = clients + offset;
+        worker->num_clients = options.clients / options.threads + (t < options.clients % options.threads);
+        worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        offset += worker->num_clients;
+    }
+    for (int i = 0; i < options.clients; i++) {
+        Client* client = &clients[i];
+        client->id = i;
+        client->fd = -1;
+        client->state = CLIENT_WAITING;
+        client->start_at = run_start + (options.ramp > 0 ? (uint64_t)(i / options.ramp * 1e9) : 0);
+        client_name(i, client->name);
+    }
+
+    pthread_t threads[MAX_THREADS];
+    for (int t = 0; t < options.threads; t++) {
+        pthread_create(&threads[t], NULL, worker_thread, &workers[t]);
+    }
+    Stats* total = (Stats*)calloc(1, sizeof(Stats));
+    for (int t = 0; t < options.threads; t++) {
+        pthread_join(threads[t], NULL);
+        merge_stats(total, &workers[t].stats);
+        close(workers[t].epoll_fd);
+    }
+
+    report(total, now_ns());
+
+    free(total);
+    free(clients);
+    free(workers);
+    return 0;
+}
@@ -0,0 +1,339 @@
+/*
+ * bench/room_fanout_bench.c
+ * Room fan-out throughput for 10, 100 and 1000 members spread over several loops
+ *
+ * Runs the server's room path in process: one user socket per event loop,
+ * members handed to them over socketpairs like the router's fd handoff, JOIN
+ * and PUBLISH frames parsed by the sockets. The publisher sits on the first
+ * loop, so every publish goes through room_publish, the hub's interest map and
+ * one RoomPost per other loop before the shared frame reaches each member's
+ * output. The peers count the ROOM frames they read: a frame a full output
+ * refused is reported as dropped, never as a delivery
+ *
+ * The server code logs every handoff. Its stdout goes to /dev/null so the
+ * report stays readable
+ *
+ * Usage: room_fanout_bench [loops]
+ */
+#include "server/room.h"
+#include "server/io_backend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define MAX_LOOPS 16
+#define PAYLOAD 256
+#define DELIVERIES 2000000L     // Per run, so every room size does the same work
+#define WINDOW 16               // Publishes ahead of the readers, keeps each member's frames under its output budget
+#define SETUP_TIMEOUT_MS 5000   // Accepted line and JOIN reply
+#define STALL_MS 1000           // No delivery for this long: the missing frames were dropped
+#define READ_EVENTS 256
+
+typedef struct {
+    int fd;                     // Peer end, the server holds the other one
+    FrameParser parser;
+    uint8_t in[2 * PROTO_BUFFER_SIZE];
+} Member;
+
+static FILE* out;               // The real stdout
+static int num_loops;
+static SlabClasses* slabs;
+static BufferPool* buffers;
+static EventLoopPool* loops;
+static SocketDirectory directory;
+static Socket sockets[MAX_LOOPS];
+static int num_sockets;         // Created, so torn down
+static uint32_t next_key = 1;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int write_all(int fd, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0 && errno == EAGAIN) {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            poll(&pfd, 1, SETUP_TIMEOUT_MS);
+            continue;
+        }
+        if (written <= 0) return -1;
+        data += written;
+        length -= (size_t)written;
+    }
+    return 1;
+}
+
+// Read what is there, -1 once the server closed the connection
+static int member_read(Member* member) {
+    size_t available;
+    uint8_t* space = frame_parser_space(&member->parser, &available);
+    ssize_t received = read(member->fd, space, available);
+    if (received < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+    if (received <= 0) return -1;
+    frame_parser_commit(&member->parser, (size_t)received);
+    return 1;
+}
+
+// Wait for the next frame during setup
+static int member_next_frame(Member* member, Frame* frame) {
+    int result;
+    while ((result = frame_parser_next(&member->parser, frame)) == 0) {
+        struct pollfd pfd = { member->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, SETUP_TIMEOUT_MS) <= 0 || member_read(member) < 0) return -1;
+    }
+    return result;
+}
+
+// Connect through sock's handoff, the socket then sends its accepted line
+static int member_connect(Member* member, Socket* sock, const char* owner) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0) {
+        fprintf(out, "socketpair failed: %s\n", strerror(errno));
+        return -1;
+    }
+    member->fd = fds[1];
+    frame_parser_init(&member->parser, member->in, sizeof(member->in), PROTO_MODE_RAW);
+
+    uint32_t key = next_key++;
+    if (reserve_socket_slot(sock, key, owner) < 0 || socket_handoff_client(sock, fds[0], key) < 0) {
+        fprintf(out, "No slot for %s on socket %d\n", owner, sock->port);
+        close(fds[0]);
+        return -1;
+    }
+
+    const char* accepted = "Connection accepted\n";
+    while (frame_parser_pending(&member->parser) < strlen(accepted)) {
+        struct pollfd pfd = { member->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, SETUP_TIMEOUT_MS) <= 0 || member_read(member) < 0) return -1;
+    }
+    if (memcmp(member->parser.data + member->parser.start, accepted, strlen(accepted)) != 0) return -1;
+    member->parser.start += strlen(accepted);
+
+    // Binary frames from here on
+    member->parser.mode = PROTO_MODE_UNKNOWN;
+    return 1;
+}
+
+static int member_join(Member* member, const char* room) {
+    uint8_t payload[1 + ROOM_NAME_LENGTH];
+    uint8_t frame_data[PROTO_HEADER_SIZE + sizeof(payload)];
+    size_t room_length = strlen(room);
+    payload[0] = (uint8_t)room_length;
+    memcpy(payload + 1, room, room_length);
+    size_t size = proto_encode_frame(frame_data, sizeof(frame_data), PROTO_OP_JOIN, 0, payload, (uint32_t)(1 + room_length));
+    if (write_all(member->fd, frame_data, size) < 0) return -1;
+
+    Frame reply;
+    if (member_next_frame(member, &reply) < 0 || reply.opcode != PROTO_OP_OK) {
+        fprintf(out, "JOIN %s refused\n", room);
+        return -1;
+    }
+    return 1;
+}
+
+// Take every complete frame, counting the ROOM ones
+static long member_drain(Member* member) {
+    long frames = 0;
+    Frame frame;
+    int result;
+    while ((result = frame_parser_next(&member->parser, &frame)) == 1) {
+        if (frame.opcode == PROTO_OP_ROOM) frames++;
+    }
+    return result < 0 ? -1 : frames;
+}
+
+// Read from ready members for up to timeout_ms, -1 if one of them broke
+static long read_deliveries(int epoll_fd, int timeout_ms) {
+    struct epoll_event events[READ_EVENTS];
+    int ready = epoll_wait(epoll_fd, events, READ_EVENTS, timeout_ms);
+    long frames = 0;
+    for (int i = 0; i < ready; i++) {
+        Member* member = (Member*)events[i].data.ptr;
+        int result;
+        while ((result = member_read(member)) > 0) {
+            long taken = member_drain(member);
+            if (taken < 0) return -1;
+            frames += taken;
+        }
+        if (result < 0) return -1;
+    }
+    return frames;
+}
+
+static int setup(int members_total) {
+    slabs = create_slab_classes("bench");
+    SocketConfig config = create_default_socket_config();
+    config.enable_listener = 0;
+    buffers = create_buffer_pool(socket_buffer_block_size(&config), 2 * (members_total + 3));
+    if (!slabs || !buffers) return -1;
+
+    const IoBackend* io = io_backend_by_id(IO_BACKEND_EPOLL);
+    const char* backend_name = getenv(IO_BACKEND_ENV);
+    if (backend_name && io_backend_by_name(backend_name)) {
+        io = io_backend_by_name(backend_name);
+    }
+    loops = create_event_loop_pool(num_loops, io, 0);
+    if (!loops) return -1;
+
+    directory.rooms = create_room_hub(loops, 0x5EEDF00DULL, slabs);
+    if (!directory.rooms) return -1;
+
+    // Slots stay reserved after a member leaves, so every run gets its own
+    SocketInitInfo info = { config, 0, members_total / num_loops + 4, buffers, slabs };
+    for (int l = 0; l < num_loops; l++) {
+        info.port_number = 40000 + l;
+        sockets[l] = create_socket(info);
+        if (sockets[l].status == SOCKET_STATUS_ERROR) return -1;
+        num_sockets++;
+        sockets[l].directory = &directory;
+        if (start_socket(&sockets[l], &loops->loops[l]) < 0) return -1;
+    }
+
+    if (start_room_hub(directory.rooms) < 0 || start_event_loop_pool(loops) < 0) return -1;
+    return 1;
+}
+
+static void teardown(void) {
+    if (loops) {
+        stop_event_loop_pool(loops);
+        destroy_event_loop_pool(loops);
+    }
+    // What the outputs refused, as the server counts it
+    unsigned long refused = 0;
+    for (int i = 0; directory.rooms && i < directory.rooms->num_shards; i++) {
+        refused += directory.rooms->shards[i].dropped;
+    }
+    fprintf(out, "Room outputs refused %lu frames\n", refused);
+    destroy_room_hub(directory.rooms);
+    for (int l = 0; l < num_sockets; l++) {
+        destroy_socket(&sockets[l]);
+    }
+    if (buffers) destroy_buffer_pool(buffers);
+    if (slabs) destroy_slab_classes(slabs);
+}
+
+static int run(int members) {
+    long messages = DELIVERIES / members;
+    Member* peers = calloc(members + 1, sizeof(Member));
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (!peers || epoll_fd < 0) {
+        free(peers);
+        return -1;
+    }
+
+    char room[ROOM_NAME_LENGTH];
+    snprintf(room, sizeof(room), "bench-%d", members);
+
+    // Members round robin over the loops, the publisher is peers[members] on the first
+    int connected = 0;
+    int result = 1;
+    for (; connected <= members && result > 0; connected++) {
+        Member* member = &peers[connected];
+        char owner[SLOT_OWNER_LENGTH] = "publisher";
+        if (connected < members) snprintf(owner, sizeof(owner), "m%d", connected);
+        result = member_connect(member, &sockets[connected < members ? connected % num_loops : 0], owner);
+        if (result > 0 && connected < members) {
+            struct epoll_event event = { .events = EPOLLIN, .data.ptr = member };
+            result = member_join(member, room);
+            if (result > 0) result = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, member->fd, &event) < 0 ? -1 : 1;
+        }
+    }
+
+    if (result > 0) {
+        // u8 length | room | body, the same frame every time
+        uint8_t payload[1 + ROOM_NAME_LENGTH + PAYLOAD];
+        size_t room_length = strlen(room);
+        payload[0] = (uint8_t)room_length;
+        memcpy(payload + 1, room, room_length);
+        memset(payload + 1 + room_length, 'x', PAYLOAD);
+        uint8_t publish[PROTO_HEADER_SIZE + sizeof(payload)];
+        size_t publish_size = proto_encode_frame(publish, sizeof(publish), PROTO_OP_PUBLISH, 0,
+                                                 payload, (uint32_t)(1 + room_length + PAYLOAD));
+        int publisher = peers[members].fd;
+
+        long expected = messages * members;
+        long delivered = 0;
+        long dropped = 0;
+        long published = 0;
+        double start = now_sec();
+        double last_progress = start;
+        while (delivered + dropped < expected) {
+            // Counted over every member, so the window is kept on the average one
+            while (published < messages && delivered + dropped >= (published - WINDOW + 1) * members) {
+                if (write_all(publisher, publish, publish_size) < 0) {
+                    fprintf(out, "Publisher lost its connection\n");
+                    result = -1;
+                    break;
+                }
+                published++;
+            }
+            if (result < 0) break;
+
+            long frames = read_deliveries(epoll_fd, STALL_MS);
+            if (frames < 0) {
+                fprintf(out, "A member lost its connection\n");
+                result = -1;
+                break;
+            }
+            delivered += frames;
+            double now = now_sec();
+            if (frames > 0) {
+                last_progress = now;
+            } else if (now - last_progress >= STALL_MS / 1000.0) {
+                // Nothing more arrives for what was published: a full output refused it
+                dropped = published * members - delivered;
+                last_progress = now;
+            }
+        }
+        double seconds = now_sec() - start;
+
+        fprintf(out, "members=%-5d messages=%-8ld %8.2f M deliveries/s %8.3f M messages/s dropped=%ld\n",
+               members, published, delivered / seconds / 1e6, published / seconds / 1e6, dropped);
+    }
+
+    // Closing makes the sockets leave the room for them
+    for (int i = 0; i < connected; i++) {
+        if (peers[i].fd > 0) close(peers[i].fd);
+    }
+    close(epoll_fd);
+    free(peers);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    // Report on the real stdout, server logging to /dev/null
+    int report_fd = dup(STDOUT_FILENO);
+    out = report_fd >= 0 ? fdopen(report_fd, "w") : NULL;
+    if (!out || !freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Cannot set up output\n");
+        return 1;
+    }
+
+    // One loop per core by default like the server, at most 4
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_loops = argc > 1 ? atoi(argv[1]) : (cores < 4 ? (int)cores : 4);
+    if (num_loops < 1) num_loops = 1;
+    if (num_loops > MAX_LOOPS) num_loops = MAX_LOOPS;
+    fprintf(out, "%d loops, %d byte payload\n", num_loops, PAYLOAD);
+
+    int sizes[] = { 10, 100, 1000 };
+    int status = setup(sizes[0] + sizes[1] + sizes[2] + 3);
+    for (int i = 0; i < 3 && status > 0; i++) {
+        status = run(sizes[i]);
+    }
+    if (status < 0) fprintf(out, "Benchmark failed\n");
+
+    teardown();
+    fclose(out);
+    return status < 0 ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * bench/slab_bench.c
+ * Slab size classes against malloc/free for the server's allocation patterns
+ *
+ * "local": each thread frees what it allocated, a window of live objects of
+ * mixed message sizes. "handoff": threads pass every object to the next
+ * thread to free, like user messages and room posts crossing event loops
+ */
+#include "util/slab.h"
+#include "util/mpsc_queue.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#define MAX_THREADS 16
+#define OPS_PER_THREAD 2000000L
+#define LIVE_WINDOW 256         // Objects each thread keeps live in "local"
+#define MAX_IN_FLIGHT 4096      // Objects a thread may be ahead of the one freeing them
+
+typedef struct {
+    MpscNode node;              // First member, objects travel to the next thread
+} Handoff;
+
+typedef struct {
+    MpscQueue queue;            // Objects the previous thread handed over
+    long in_flight __attribute__((aligned(64)));
+    int id;
+    int use_slab;
+} Worker;
+
+static SlabClasses* slabs;
+static Worker workers[MAX_THREADS];
+static int num_threads;
+static pthread_barrier_t start_barrier;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Mostly short chat messages, some up to a full frame
+static size_t message_size(uint64_t r) {
+    if (r % 10 < 8) return 32 + r % 224;
+    return 256 + r % 3840;
+}
+
+static void* allocate(Worker* worker, size_t size) {
+    void* object = worker->use_slab ? slab_alloc_size(slabs, size) : malloc(size);
+    memset(object, 0, sizeof(Handoff));
+    return object;
+}
+
+static void release(Worker* worker, void* object) {
+    if (worker->use_slab) {
+        slab_free(object);
+    } else {
+        free(object);
+    }
+}
+
+static void* local_thread(void* arg) {
+    Worker* worker = (Worker*)arg;
+    uint64_t rng = 0x9E3779B97F4A7C15ULL * (worker->id + 1);
+    void* live[LIVE_WINDOW] = { NULL };
+
+    pthread_barrier_wait(&start_barrier);
+    for (long i = 0; i < OPS_PER_THREAD; i++) {
+        uint64_t r = next_random(&rng);
+        int index = (int)(r >> 40) % LIVE_WINDOW;
+        if (live[index]) {
+            release(worker, live[index]);
+        }
+        live[index] = allocate(worker, message_size(r));
+    }
+    for (int i = 0; i < LIVE_WINDOW; i++) {
+        if (live[i]) release(worker, live[i]);
+    }
+    return NULL;
+}
+
+// Free whatever the previous thread handed over
+static long drain_handoffs(Worker* worker) {
+    long freed = 0;
+    MpscNode* node;
+    while ((node = mpsc_pop(&worker->queue))) {
+        release(worker, node);
+        freed++;
+    }
+    return freed;
+}
+
+static void* handoff_thread(void* arg) {
+    Worker* worker = (Worker*)arg;
+    Worker* next = &workers[(worker->id + 1) % num_threads];
+    uint64_t rng = 0x9E3779B97F4A7C15ULL * (worker->id + 1);
+    long freed = 0;
+
+    pthread_barrier_wait(&start_barrier);
+    for (long i = 0; i < OPS_PER_THREAD; i++) {
+        while (__atomic_load_n(&next->in_flight, __ATOMIC_ACQUIRE) >= MAX_IN_FLIGHT) {
+            long drained = drain_handoffs(worker);
+            __atomic_fetch_sub(&worker->in_flight, drained, __ATOMIC_RELEASE);
+            freed += drained;
+            if (!drained) sched_yield();
+        }
+        Handoff* object = (Handoff*)allocate(worker, message_size(next_random(&rng)));
+        __atomic_fetch_add(&next->in_flight, 1, __ATOMIC_RELAXED);
+        mpsc_push(&next->queue, &object->node);
+
+        long drained = drain_handoffs(worker);
+        __atomic_fetch_sub(&worker->in_flight, drained, __ATOMIC_RELEASE);
+        freed += drained;
+    }
+
+    // Every thread receives as many objects as it sends
+    while (freed < OPS_PER_THREAD) {
+        long drained = drain_handoffs(worker);
+        __atomic_fetch_sub(&worker->in_flight, drained, __ATOMIC_RELEASE);
+        freed += drained;
+        if (!drained) sched_yield();
+    }
+    return NULL;
+}
+
+static void run(const char* pattern, void* (*body)(void*), int use_slab) {
+    pthread_t ids[MAX_THREADS];
+
+    pthread_barrier_init(&start_barrier, NULL, num_threads + 1);
+    for (int t = 0; t < num_threads; t++) {
+        memset(&workers[t], 0, sizeof(Worker));
+        mpsc_init(&workers[t].queue);
+        workers[t].id = t;
+        workers[t].use_slab = use_slab;
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_create(&ids[t], NULL, body, &workers[t]);
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    double start = now_sec();
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    double seconds = now_sec() - start;
+    pthread_barrier_destroy(&start_barrier);
+
+    printf("%-8s %-6s threads=%-2d %8.2f M alloc+free/s\n", pattern, use_slab ? "slab" : "malloc",
+           num_threads, num_threads * OPS_PER_THREAD / seconds / 1e6);
+}
+
+int main(int argc, char** argv) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = argc > 1 ? atoi(argv[1]) : (cores < 4 ? (int)cores : 4);
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+
+    slabs = create_slab_classes("bench");
+    if (!slabs) return 1;
+
+    run("local", local_thread, 1);
+    run("local", local_thread, 0);
+    run("handoff", handoff_thread, 1);
+    run("handoff", handoff_thread, 0);
+
+    // Slabs taken per class: stays flat however many operations ran
+    destroy_slab_classes(slabs);
+    return 0;
+}
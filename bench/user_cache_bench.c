@@ -0,0 +1,85 @@
+/*
+ * bench/user_cache_bench.c
+ * Insert / lookup / remove throughput of UserCache at growing populations
+ */
+#include "util/user_cache.h"
+#include <stdio.h>
+#include <time.h>
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_name(char* out, int i) {
+    snprintf(out, MAX_USERNAME, "player_%d", i);
+}
+
+static void report(const char* op, int entries, int ops, double seconds) {
+    printf("%-8s entries=%-8d ops=%-8d %8.1f ns/op %8.2f Mops/s\n",
+           op, entries, ops, seconds * 1e9 / ops, ops / seconds / 1e6);
+}
+
+static void run(int entries) {
+    char (*names)[MAX_USERNAME] = malloc((size_t)entries * MAX_USERNAME);
+    if (!names) return;
+    for (int i = 0; i < entries; i++) {
+        make_name(names[i], i);
+    }
+
+    UserCache* cache = create_user_cache();
+    if (!cache) {
+        free(names);
+        return;
+    }
+
+    double start = now_sec();
+    for (int i = 0; i < entries; i++) {
+        add_user(cache, names[i], 8081 + (i % 1000), (uint32_t)i + 1);
+    }
+    report("insert", entries, entries, now_sec() - start);
+
+    // Hits in a scattered order so the hardware prefetcher does not help
+    int lookups = entries < 1000000 ? 1000000 : entries;
+    long checksum = 0;
+    start = now_sec();
+    for (int i = 0; i < lookups; i++) {
+        int idx = (int)(((uint64_t)i * 2654435761u) % entries);
+        checksum += get_user_port(cache, names[idx]);
+    }
+    report("hit", entries, lookups, now_sec() - start);
+
+    start = now_sec();
+    for (int i = 0; i < lookups; i++) {
+        char miss[MAX_USERNAME];
+        snprintf(miss, sizeof(miss), "absent_%d", i);
+        checksum += has_user(cache, miss);
+    }
+    report("miss", entries, lookups, now_sec() - start);
+
+    start = now_sec();
+    for (int i = 0; i < entries; i++) {
+        remove_user(cache, names[i]);
+    }
+    report("remove", entries, entries, now_sec() - start);
+
+    if (checksum == 42) printf("\n");  // Keep the lookups from being optimized out
+    destroy_user_cache(cache);
+    free(names);
+}
+
+int main(int argc, char** argv) {
+    int sizes[] = {10000, 100000, 1000000};
+    int count = sizeof(sizes) / sizeof(sizes[0]);
+
+    if (argc > 1) {
+        sizes[0] = atoi(argv[1]);
+        count = 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        run(sizes[i]);
+    }
+    return 0;
+}
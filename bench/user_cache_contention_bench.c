@@ -0,0 +1,121 @@
+/*
+ * bench/user_cache_contention_bench.c
+ * UserCache throughput under a read-mostly mix as the thread count grows
+ */
+#include "util/user_cache.h"
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#define PREFILL 100000
+#define OPS_PER_THREAD 2000000
+#define WRITE_PERCENT 10
+
+typedef struct {
+    UserCache* cache;
+    char (*names)[MAX_USERNAME];
+    int id;
+    long checksum;
+} Worker;
+
+static pthread_barrier_t start_barrier;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void* worker_thread(void* arg) {
+    Worker* worker = (Worker*)arg;
+    uint64_t rng = 0x9E3779B97F4A7C15ULL * (worker->id + 1);
+    char own[MAX_USERNAME];
+    long checksum = 0;
+
+    pthread_barrier_wait(&start_barrier);
+    for (int i = 0; i < OPS_PER_THREAD; i++) {
+        uint64_t r = next_random(&rng);
+        if (r % 100 < WRITE_PERCENT) {
+            // Writers churn their own keys so the prefilled set stays stable
+            snprintf(own, sizeof(own), "churn_%d_%d", worker->id, (int)(r >> 32) % 1024);
+            if (add_user(worker->cache, own, 8081, (uint32_t)i + 1) == -1) {
+                remove_user(worker->cache, own);
+            }
+        } else {
+            checksum += get_user_port(worker->cache, worker->names[(r >> 16) % PREFILL]);
+        }
+    }
+
+    worker->checksum = checksum;
+    return NULL;
+}
+
+static void run(UserCache* cache, char (*names)[MAX_USERNAME], int threads) {
+    pthread_t* ids = malloc(sizeof(pthread_t) * threads);
+    Worker* workers = calloc(threads, sizeof(Worker));
+    if (!ids || !workers) {
+        free(ids);
+        free(workers);
+        return;
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, threads + 1);
+    for (int t = 0; t < threads; t++) {
+        workers[t].cache = cache;
+        workers[t].names = names;
+        workers[t].id = t;
+        pthread_create(&ids[t], NULL, worker_thread, &workers[t]);
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    double start = now_sec();
+    long checksum = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+        checksum += workers[t].checksum;
+    }
+    double seconds = now_sec() - start;
+    pthread_barrier_destroy(&start_barrier);
+
+    long ops = (long)threads * OPS_PER_THREAD;
+    printf("threads=%-3d ops=%-9ld %8.1f ns/op %8.2f Mops/s (%d%% writes)\n",
+           threads, ops, seconds * 1e9 / ops * threads, ops / seconds / 1e6, WRITE_PERCENT);
+
+    if (checksum == 42) printf("\n");  // Keep the lookups from being optimized out
+    free(ids);
+    free(workers);
+}
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    if (max_threads < 1) max_threads = 1;
+
+    char (*names)[MAX_USERNAME] = malloc((size_t)PREFILL * MAX_USERNAME);
+    UserCache* cache = create_user_cache();
+    if (!names || !cache) {
+        printf("Failed to set up benchmark\n");
+        free(names);
+        destroy_user_cache(cache);
+        return 1;
+    }
+
+    for (int i = 0; i < PREFILL; i++) {
+        snprintf(names[i], MAX_USERNAME, "player_%d", i);
+        add_user(cache, names[i], 8081 + (i % 1000), (uint32_t)i + 1);
+    }
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        run(cache, names, threads);
+    }
+
+    destroy_user_cache(cache);
+    free(names);
+    return 0;
+}
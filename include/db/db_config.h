@@ -28,4 +28,12 @@
 // Query timeouts
 #define DB_TIMEOUT_MS 5000
 
+// Storage defaults (UserDBConfig)
+#define DB_POOL_CONNECTIONS 4       // One per auth worker
+#define DB_JOURNAL_MODE "WAL"
+#define DB_SYNCHRONOUS "NORMAL"
+#define DB_CACHE_KB 8192
+#define DB_LOGIN_BATCH 256          // Login updates per write-behind transaction
+#define DB_LOGIN_FLUSH_MS 1000      // Or sooner, once a batch is full
+
 #endif /* DB_CONFIG_H */
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <sqlite3.h>
 #include <time.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include "db_config.h"
 // Status codes for database operations
 #define DB_SUCCESS          0
 #define DB_ERROR          -1
@@ -21,24 +23,73 @@ typedef struct {
     int login_count;           // Number of successful logins
 } UserData;
 
-// Database connection handle
+// One SQLite connection with its prepared statements, used by one thread at a time
 typedef struct {
     sqlite3* db;                 // SQLite database connection
     sqlite3_stmt* auth_stmt;     // Prepared statement for authentication
     sqlite3_stmt* create_stmt;   // Prepared statement for user creation
     sqlite3_stmt* get_user_stmt; // For fetching user data
     sqlite3_stmt* update_user_stmt; // For updating user data
+    pthread_mutex_t lock;        // Only contended once threads outnumber connections
+} UserDBConnection;
+
+// Storage tuning, applied to every connection
+typedef struct {
+    int connections;             // Pool size, threads past it share connections
+    const char* journal_mode;    // "WAL": readers never block the writer
+    const char* synchronous;     // "NORMAL": with WAL, commits skip fsync, checkpoints sync
+    int cache_kb;                // Page cache per connection
+    int busy_timeout_ms;         // How long a writer waits for another connection's write
+    int login_batch;             // Login updates per write-behind transaction, 0 writes each one inline
+    int login_flush_ms;          // Longest a login update waits for its transaction
+} UserDBConfig;
+
+// A successful login's bookkeeping, waiting for the writer thread
+typedef struct {
+    char username[MAX_USERNAME_LENGTH];
+    time_t at;
+} PendingLogin;
+
+// Write-behind of last_login/login_count: logins append, one thread writes them in batches
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;         // A batch is full, or shutdown
+    pthread_cond_t space;        // The buffer was handed to the writer, appending can resume
+    PendingLogin* pending;       // Appended to by logins
+    PendingLogin* flushing;      // Being written, swapped with pending for every batch
+    int count;                   // Entries in pending
+    int capacity;                // Of each buffer, logins wait only when pending is full
+    int running;
+    UserDBConnection* conn;      // own, or the only connection of an in-memory database
+    UserDBConnection own;
+} LoginWriter;
+
+// Database handle: a pool of connections, each thread gets its own on first use
+typedef struct {
+    UserDBConnection* conns;
+    int num_conns;
+    int next_conn;               // Next connection a thread claims (atomic)
+    unsigned long id;            // Tells threads' cached connections apart across handles
+    UserDBConfig config;
+    LoginWriter* logins;         // NULL when login_batch is 0
 } UserDB;
 
 // Database initialization and cleanup
-UserDB* init_user_db(const char* db_path);
+UserDBConfig default_user_db_config(void);
+UserDB* open_user_db(const char* db_path, const UserDBConfig* config); // ":memory:" gets a single connection
+UserDB* init_user_db(const char* db_path);                            // Default config
 void close_user_db(UserDB* db);
 
+// The calling thread's connection, claimed on first use (NULL if db is NULL)
+UserDBConnection* user_db_connection(UserDB* db);
+
 // User management functions
 int create_user(UserDB* db, const char* username, const char* password);
 int authenticate_user(UserDB* db, const char* username, const char* password);
 int get_user_data(UserDB* db, const char* username, UserData* data);
-int update_last_login(UserDB* db, const char* username);
+int update_last_login(UserDB* db, const char* username);        // Written now, in its own transaction
+int record_login(UserDB* db, const char* username);             // Queued for the login writer (close_user_db flushes)
 
 // Database maintenance functions
 int init_db_tables(UserDB* db);
@@ -0,0 +1,60 @@
+/*
+ * include/server/admin.h
+ * Local admin endpoint serving the server's metrics in the Prometheus text format
+ *
+ * Runs on its own thread and only reads: per-thread metric blocks and latency
+ * histograms, socket stats and placement loads. A scrape never touches an event loop, so it
+ * costs the data plane nothing but the cache misses of being read
+ */
+#ifndef ADMIN_H
+#define ADMIN_H
+
+#include <pthread.h>
+#include "latency.h"
+
+#define ADMIN_ENV "CONNECTHUB_METRICS"  /* "<port>", "unix:<path>" or "off", read at startup */
+#define ADMIN_REQUEST_MAX 2048          /* Request head bytes read before answering */
+#define ADMIN_IO_TIMEOUT_MS 1000        /* Per scrape, a stalled client cannot hold the thread longer */
+#define ADMIN_UNIX_PATH_MAX 108
+
+struct Router;
+
+typedef struct {
+    struct Router* router;
+    int listen_fd;
+    int stop_fd;                /* eventfd, wakes the thread for shutdown */
+    int port;                   /* 127.0.0.1:port, 0 when on a Unix socket */
+    char unix_path[ADMIN_UNIX_PATH_MAX]; /* Unlinked again at shutdown */
+    pthread_t thread;
+    int running;
+    unsigned long scrapes;
+    LatencyInterval latency;    /* Quantiles cover the time since the previous scrape */
+} AdminServer;
+
+/*
+ * Parse an endpoint spec ("9100", "unix:/run/connecthub.sock", "off")
+ * @param port Receives the TCP port, 0 for a Unix socket or when disabled
+ * @param unix_path Receives the socket path, empty unless "unix:"
+ * @return 1 if the endpoint is enabled, 0 if disabled, -1 if spec is invalid
+ */
+int parse_admin_endpoint(const char* spec, int* port, char unix_path[ADMIN_UNIX_PATH_MAX]);
+
+/*
+ * Bind the endpoint and start its thread
+ * @param port TCP port on 127.0.0.1, used when unix_path is empty or NULL
+ * @return AdminServer or NULL on error
+ */
+AdminServer* start_admin_server(struct Router* router, int port, const char* unix_path);
+
+/*
+ * Stop the thread, close the endpoint and free the server (NULL is ignored)
+ */
+void stop_admin_server(AdminServer* admin);
+
+/*
+ * Render the metrics page into a malloc'd buffer, starting a new latency interval
+ * @return the text (caller frees) or NULL if out of memory
+ */
+char* render_admin_metrics(AdminServer* admin, size_t* length);
+
+#endif /* ADMIN_H */
@@ -0,0 +1,133 @@
+/*
+ * include/server/db_executor.h
+ * Asynchronous database API: jobs (bcrypt + SQLite) run on executor threads,
+ * never on an event loop
+ *
+ * Submitting pushes the job onto a worker's lock-free queue (mpsc_queue.h).
+ * The worker runs it on its own database connection and pushes it onto the
+ * submitter's completion queue, whose eventfd the submitter's loop watches;
+ * draining that queue runs each job's callback on the loop's thread
+ */
+#ifndef DB_EXECUTOR_H
+#define DB_EXECUTOR_H
+
+#include <pthread.h>
+#include "db/user_db.h"
+#include "db/db_config.h"
+#include "util/slab.h"
+#include "util/mpsc_queue.h"
+
+#define DEFAULT_DB_WORKERS 4        /* Worker threads when config asks for 0 */
+
+/* Job types */
+#define DB_JOB_AUTH    1            /* authenticate_user, result only */
+#define DB_JOB_REG     2            /* create_user */
+#define DB_JOB_PROFILE 3            /* get_user_data into profile */
+#define DB_JOB_LOGIN   4            /* record_login */
+
+/* Result of a job the executor shut down before running, next to the DB_* results of user_db.h */
+#define DB_CANCELLED  -5
+
+/* Executor status flags */
+#define DB_EXECUTOR_STOPPED 0
+#define DB_EXECUTOR_RUNNING 1
+
+struct DbJob;
+struct DbCompletionQueue;
+
+/*
+ * Runs on the thread that drains the completion queue, the job is freed when it returns
+ */
+typedef void (*DbCompletionHandler)(struct DbJob* job);
+
+/*
+ * A single database request
+ * Filled in by the submitter, executed by a worker, handed back on completion
+ */
+typedef struct DbJob {
+    MpscNode node;                          /* First member: worker queue, then completion queue */
+    int type;                               /* DB_JOB_* */
+    void* context;                          /* Caller's per-request data, returned untouched */
+    DbCompletionHandler on_complete;
+    char username[MAX_USERNAME_LENGTH];
+    char password[MAX_PASSWORD_LENGTH];     /* Wiped by the worker after use */
+    int result;                             /* DB_* status set by the worker, or DB_CANCELLED */
+    UserData profile;                       /* DB_JOB_PROFILE result */
+    struct DbCompletionQueue* completions;  /* Where the finished job is posted */
+} DbJob;
+
+/*
+ * Finished jobs waiting for their event loop
+ * event_fd becomes readable when a job is posted and no wakeup is pending yet
+ */
+typedef struct DbCompletionQueue {
+    MpscQueue queue;
+    int event_fd;
+    int signaled;               /* A wakeup is pending, later posts skip the eventfd write */
+} DbCompletionQueue;
+
+struct DbExecutor;
+
+/*
+ * One executor thread and its queue
+ * The thread blocks reading event_fd while the queue is empty
+ */
+typedef struct {
+    MpscQueue queue;
+    int event_fd;
+    int signaled;
+    int pending;                /* Jobs queued, not yet taken (atomic), submit picks the lowest */
+    pthread_t thread;
+    struct DbExecutor* executor;
+} DbWorker;
+
+typedef struct DbExecutor {
+    UserDB* user_db;            /* Each worker uses its own connection of the pool */
+    DbWorker* workers;
+    int num_workers;
+    int status;                 /* Read by submitters without a lock (atomic) */
+} DbExecutor;
+
+/*
+ * Create an executor (threads are not started yet)
+ * @param user_db Database the workers run jobs against
+ * @param num_workers Number of worker threads, 0 for DEFAULT_DB_WORKERS
+ * @return DbExecutor or NULL on error
+ */
+DbExecutor* create_db_executor(UserDB* user_db, int num_workers);
+
+/*
+ * Spawn the worker threads
+ * Returns -1 on error, 1 on success
+ */
+int start_db_executor(DbExecutor* executor);
+
+/*
+ * Queue a job on the least loaded worker, from any thread; ownership passes to the executor
+ * Jobs are slab objects, whoever ends up with one gives it back with slab_free()
+ * Returns -1 if the executor is not running, 1 on success
+ */
+int submit_db_job(DbExecutor* executor, DbJob* job);
+
+/*
+ * Stop and join the workers, then free the executor
+ * Jobs no worker started complete with DB_CANCELLED, so every job's callback still runs once;
+ * completion queues must outlive the executor
+ */
+void shut_down_db_executor(DbExecutor* executor);
+
+/*
+ * Set up / tear down a completion queue and its eventfd
+ * init returns -1 on error, 1 on success; destroy frees jobs never drained without their callbacks
+ */
+int init_db_completion_queue(DbCompletionQueue* queue);
+void destroy_db_completion_queue(DbCompletionQueue* queue);
+
+/*
+ * Clear the eventfd and run the callback of every finished job, then free it
+ * Only the thread that owns the queue may drain it
+ * @return number of jobs completed
+ */
+int drain_db_completions(DbCompletionQueue* queue);
+
+#endif /* DB_EXECUTOR_H */
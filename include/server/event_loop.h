@@ -0,0 +1,256 @@
+/*
+ * include/server/event_loop.h
+ * Fixed pool of event loop threads that multiplex many sockets and their clients
+ */
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "util/timer_wheel.h"
+#include "io_backend.h"
+
+#define DEFAULT_EVENT_LOOPS 0      /* 0 = one loop per online core */
+
+/* Loop status flags */
+#define EVENT_LOOP_STOPPED 0
+#define EVENT_LOOP_RUNNING 1
+#define EVENT_LOOP_ERROR   2
+
+struct EventSource;
+
+/*
+ * Called on the loop thread for every readiness event of a source
+ * @param source The source registered with event_loop_add
+ * @param events epoll event mask (EPOLLIN, EPOLLHUP, ...)
+ */
+typedef void (*EventHandler)(struct EventSource* source, uint32_t events);
+
+/*
+ * Called on the loop thread for a connection accepted by event_loop_accept
+ * @param client_fd Non-blocking, close-on-exec, owned by the handler
+ */
+typedef void (*AcceptHandler)(struct EventSource* source, int client_fd);
+
+/*
+ * Called on the loop thread when a stream operation finishes
+ * @param result Bytes moved, 0 at end of stream, or -errno
+ */
+typedef void (*CompletionHandler)(struct EventSource* source, ssize_t result);
+
+/* Source state kept by the backends (EventSource.io.flags) */
+#define IO_WATCHED     0x001   /* Readiness registration (event_loop_add) */
+#define IO_LISTENING   0x002   /* Accepting (event_loop_accept) */
+#define IO_RECV        0x004   /* Receive outstanding */
+#define IO_SEND        0x008   /* Send outstanding */
+#define IO_CLOSING     0x010   /* event_loop_close called, on_close pending */
+#define IO_SEND_DONE   0x020   /* Completion waiting on the loop's completed list */
+#define IO_CLOSE_DONE  0x040
+#define IO_QUEUED      0x080   /* On the completed list */
+
+#define IO_MAX_IOV 8           /* Buffers in one event_loop_send */
+
+/*
+ * Backend bookkeeping of a source, zeroed by event_source_init
+ * Holds what an outstanding operation needs until it completes
+ */
+typedef struct {
+    uint32_t flags;             /* IO_* */
+    uint32_t events;            /* epoll: interest currently registered, 0 if none */
+    int id;                     /* io_uring: registration slot, 0 if none */
+    int inflight;               /* io_uring: submissions the kernel has not completed */
+    void* recv_buffer;
+    size_t recv_length;
+    struct iovec iov[IO_MAX_IOV];
+    struct msghdr msg;          /* Outstanding send, points at iov */
+    ssize_t send_result;        /* Result of a send completed outside the backend's dispatch */
+    struct EventSource* next;   /* Loop's completed list */
+} IoState;
+
+/*
+ * Anything registered with a loop: a listener, a client, a wakeup fd
+ * Embedded in the owning structure, the backend hands it back with every event
+ * Wakeup fds and handshakes use readiness (handler), client connections use
+ * the stream operations and their completion callbacks
+ */
+typedef struct EventSource {
+    int fd;
+    EventHandler handler;
+    void* owner;                /* Structure that embeds or owns this source */
+    AcceptHandler on_accept;
+    CompletionHandler on_recv;
+    CompletionHandler on_send;
+    CompletionHandler on_close; /* Stream closed, nothing in flight references its buffers */
+    IoState io;
+} EventSource;
+
+struct FlushNode;
+typedef void (*FlushHandler)(struct FlushNode* node);
+
+/*
+ * Output waiting for the loop's next flush, embedded in a connection
+ * Handlers queue frames and defer the write, so everything a connection is
+ * sent during one iteration leaves in a single syscall
+ */
+typedef struct FlushNode {
+    struct FlushNode* next;
+    FlushHandler handler;
+    void* owner;
+    int queued;             /* On the loop's flush list */
+} FlushNode;
+
+/*
+ * Egress batching counters (loop thread only)
+ * frames / writes is frames per send, frames / syscalls what the backend costs per frame
+ */
+typedef struct {
+    uint64_t frames;        /* Messages queued for output */
+    uint64_t writes;        /* Sends that carried them */
+    uint64_t bytes;
+    uint64_t syscalls;      /* Every I/O syscall of the loop (waits, reads, sends, epoll_ctl, io_uring_enter) */
+} EgressStats;
+
+/*
+ * One event loop thread, its I/O backend and its timers
+ * now is read once per wait, handlers use it instead of calling time()
+ */
+typedef struct EventLoop {
+    const IoBackend* io;
+    void* backend;          /* Backend state (epoll set or io_uring rings) */
+    EventSource* completed; /* Completions the backend finished outside its dispatch */
+    pthread_t thread;
+    int status;
+    int index;
+    int num_sockets;        /* Sockets attached, used to balance placement */
+    uint64_t now;           /* Coarse monotonic ms, refreshed every iteration */
+    TimerWheel timers;      /* Only touched on the loop thread */
+    FlushNode* flush_list;  /* Connections with output queued this window */
+    uint64_t flush_since;   /* now when the first of them was queued */
+    int flush_window_ms;    /* 0: flush after every iteration */
+    EgressStats egress;
+    uint64_t woke_at;       /* Precise monotonic ns, splits each iteration into busy and idle */
+    uint64_t slept_at;
+} EventLoop;
+
+typedef struct {
+    EventLoop* loops;
+    int num_loops;
+} EventLoopPool;
+
+/*
+ * Set up one loop and its backend (no thread), io_uring falls back to epoll
+ * if the kernel refuses it
+ * @param io Backend to use, NULL for epoll
+ * Returns -1 on error, 1 on success
+ */
+int event_loop_init(EventLoop* loop, int index, const IoBackend* io, int flush_window_ms);
+
+/*
+ * Loop body, runs until status leaves EVENT_LOOP_RUNNING (pthread start routine)
+ */
+void* event_loop_run(void* loop);
+
+/*
+ * Release the loop's backend, the loop must be stopped
+ */
+void event_loop_destroy(EventLoop* loop);
+
+/*
+ * Print the loop's egress counters if it sent anything
+ */
+void event_loop_report(const EventLoop* loop, const char* name);
+
+/*
+ * Create the loops and their backends (threads are not started yet)
+ * @param num_loops Number of loop threads, 0 for one per online core
+ * @param io Backend for every loop, NULL for epoll
+ * @param flush_window_ms How long queued output may wait for more frames (coarse clock)
+ * @return EventLoopPool or NULL on error
+ */
+EventLoopPool* create_event_loop_pool(int num_loops, const IoBackend* io, int flush_window_ms);
+
+/*
+ * Start every loop thread
+ * Returns -1 on error, 1 on success
+ */
+int start_event_loop_pool(EventLoopPool* pool);
+
+/*
+ * Signal every loop to stop and join the threads (sources stay registered)
+ * Prints each loop's egress counters
+ */
+void stop_event_loop_pool(EventLoopPool* pool);
+
+/*
+ * Release the backends and free the pool, loops must be stopped
+ */
+void destroy_event_loop_pool(EventLoopPool* pool);
+
+/*
+ * Pick the loop with the fewest attached sockets and count one more on it
+ */
+EventLoop* event_loop_pool_attach(EventLoopPool* pool);
+
+/*
+ * Zero a source's state and set its fd, readiness handler and owner
+ */
+void event_source_init(EventSource* source, int fd, EventHandler handler, void* owner);
+
+/*
+ * Watch / re-watch / stop watching a source for readiness (EPOLLIN, ...)
+ * Return -1 on error, 1 on success
+ */
+int event_loop_add(EventLoop* loop, EventSource* source, uint32_t events);
+int event_loop_modify(EventLoop* loop, EventSource* source, uint32_t events);
+int event_loop_remove(EventLoop* loop, EventSource* source);
+
+/*
+ * Stream operations, completed through the source's callbacks on the loop thread
+ * At most one recv and one send may be outstanding per source; the buffer and
+ * the iovec contents must stay valid until on_recv / on_send
+ * Return -1 if the operation could not be started, 1 otherwise
+ */
+int event_loop_accept(EventLoop* loop, EventSource* source);
+int event_loop_recv(EventLoop* loop, EventSource* source, void* buffer, size_t length);
+int event_loop_send(EventLoop* loop, EventSource* source, const struct iovec* iov, int iovcnt);
+
+/*
+ * Close the source's fd and cancel what is outstanding
+ * on_close runs later on the loop thread, once nothing in flight can touch the
+ * source's buffers; the source must stay allocated until then
+ */
+int event_loop_close(EventLoop* loop, EventSource* source);
+
+/*
+ * Forget a source with nothing outstanding without closing its fd (e.g. fd handoff)
+ */
+int event_loop_release(EventLoop* loop, EventSource* source);
+
+/*
+ * Coarse monotonic clock in milliseconds (no syscall, vDSO), same base as EventLoop.now
+ */
+uint64_t event_loop_clock_ms(void);
+
+/*
+ * Precise monotonic clock in nanoseconds, for measuring rather than scheduling
+ */
+uint64_t event_loop_clock_ns(void);
+
+/*
+ * Schedule a timer on the loop, delay_ms after the loop's cached now
+ * Loop thread only
+ */
+void event_loop_schedule(EventLoop* loop, TimerNode* timer, uint64_t delay_ms);
+
+void event_loop_flush_init(FlushNode* node, FlushHandler handler, void* owner);
+
+/*
+ * Call node's handler once the current iteration (or flush window) ends
+ * Queuing an already queued node does nothing, loop thread only
+ */
+void event_loop_defer_flush(EventLoop* loop, FlushNode* node);
+
+#endif /* EVENT_LOOP_H */
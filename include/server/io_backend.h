@@ -0,0 +1,71 @@
+/*
+ * include/server/io_backend.h
+ * I/O backends behind an event loop
+ * epoll reports readiness and the loop makes the read/send calls itself,
+ * io_uring queues the operations and submits a whole iteration's worth
+ * together with the wait, in one io_uring_enter
+ */
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define IO_BACKEND_EPOLL    0
+#define IO_BACKEND_IO_URING 1
+
+#define IO_BACKEND_ENV "CONNECTHUB_IO_BACKEND"   /* "epoll" or "io_uring", read at startup */
+
+#define IO_URING_ENTRIES   256   /* Submission queue size per loop */
+#define IO_URING_CQ_FACTOR 8     /* Completion queue entries per submission entry */
+
+struct EventLoop;
+struct EventSource;
+
+/*
+ * Operations of one backend, see event_loop.h for their contract
+ * Every function runs on the loop thread, init and destroy excepted
+ */
+typedef struct IoBackend {
+    const char* name;
+    int  (*init)(struct EventLoop* loop);
+    void (*destroy)(struct EventLoop* loop);
+    int  (*add)(struct EventLoop* loop, struct EventSource* source, uint32_t events);
+    int  (*modify)(struct EventLoop* loop, struct EventSource* source, uint32_t events);
+    int  (*remove)(struct EventLoop* loop, struct EventSource* source);
+    int  (*accept)(struct EventLoop* loop, struct EventSource* source);
+    int  (*recv)(struct EventLoop* loop, struct EventSource* source, void* buffer, size_t length);
+    int  (*send)(struct EventLoop* loop, struct EventSource* source, const struct iovec* iov, int iovcnt);
+    int  (*close)(struct EventLoop* loop, struct EventSource* source);
+    int  (*release)(struct EventLoop* loop, struct EventSource* source);
+    /*
+     * Submit what is queued, wait up to timeout_ms, refresh loop->now and dispatch
+     * Returns -1 on a fatal error
+     */
+    int  (*wait)(struct EventLoop* loop, int timeout_ms);
+} IoBackend;
+
+extern const IoBackend epoll_backend;
+extern const IoBackend io_uring_backend;
+
+/*
+ * Backend for an IO_BACKEND_* id, or for a name ("epoll", "io_uring")
+ * NULL if unknown
+ */
+const IoBackend* io_backend_by_id(int id);
+const IoBackend* io_backend_by_name(const char* name);
+
+/*
+ * For backends: queue a send result (IO_SEND_DONE) or a finished close
+ * (IO_CLOSE_DONE) for the loop to deliver after the current dispatch
+ */
+void event_loop_complete(struct EventLoop* loop, struct EventSource* source, uint32_t done);
+
+/*
+ * For backends: call as soon as the blocking wait returns, before dispatching
+ * Refreshes loop->now and counts the wait as idle time
+ */
+void event_loop_woke(struct EventLoop* loop);
+
+#endif /* IO_BACKEND_H */
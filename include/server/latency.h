@@ -0,0 +1,82 @@
+/*
+ * include/server/latency.h
+ * Server-wide latency histograms, one set per thread
+ *
+ * Like metrics.h, a thread records into its own block without locked
+ * instructions and readers merge the blocks on demand. Blocks are allocated
+ * the first time a thread records. Nothing is ever cleared under a writer:
+ * an interval is the difference between two snapshots (latency_interval)
+ */
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include "util/histogram.h"
+
+#define LATENCY_MAX_THREADS 128   /* Threads with their own block, later ones share one (atomic adds) */
+
+typedef enum {
+    LATENCY_AUTH,                 /* authenticate_user, bcrypt included */
+    LATENCY_REGISTER,             /* create_user */
+    LATENCY_LAST_LOGIN,           /* Login writer transaction (a batch of last_login updates) */
+    LATENCY_SESSION,              /* Connection on a user socket until its session key claimed a slot */
+    LATENCY_MESSAGE,              /* SEND received until the MESSAGE is queued on the recipient */
+    LATENCY_COUNT
+} LatencyId;
+
+typedef struct {
+    Histogram histograms[LATENCY_COUNT];
+    int shared;                   /* The overflow block, written with atomic adds */
+} __attribute__((aligned(64))) LatencyBlock;
+
+typedef struct {
+    Histogram histograms[LATENCY_COUNT];
+} LatencySnapshot;
+
+/*
+ * Reader state for per-interval figures, zero it before the first call
+ */
+typedef struct {
+    LatencySnapshot previous;
+} LatencyInterval;
+
+extern __thread LatencyBlock* latency_thread_block;
+
+/*
+ * Allocate the calling thread's block (the shared one past LATENCY_MAX_THREADS)
+ * @return NULL if out of memory, the sample is then dropped
+ */
+LatencyBlock* latency_attach(void);
+
+static inline void latency_record(LatencyId id, uint64_t ns) {
+    LatencyBlock* block = latency_thread_block ? latency_thread_block : latency_attach();
+    if (!block) return;
+    if (block->shared) {
+        histogram_record_shared(&block->histograms[id], ns);
+    } else {
+        histogram_record(&block->histograms[id], ns);
+    }
+}
+
+/*
+ * Merge every thread's block, cumulative since startup
+ */
+void latency_collect(LatencySnapshot* snapshot);
+
+/*
+ * What was recorded since this interval's previous call (since startup on the first)
+ */
+void latency_interval(LatencyInterval* interval, LatencySnapshot* snapshot);
+
+/*
+ * Snake case name, e.g. "auth"
+ */
+const char* latency_name(LatencyId id);
+const char* latency_help(LatencyId id);
+
+/*
+ * Print count, mean, p50, p90, p99, p99.9 and max of every histogram with samples
+ */
+void latency_report(void);
+
+#endif /* LATENCY_H */
@@ -0,0 +1,116 @@
+/*
+ * include/server/metrics.h
+ * Server-wide counters, one cache-line aligned block per thread
+ *
+ * A thread only ever writes its own block, so counting is a plain add with
+ * no locked instruction and no line bouncing between cores. Readers sum the
+ * blocks on demand. Gauges (queue depths, connections) are counters too: the
+ * producer adds and the consumer subtracts, whichever threads those are, and
+ * the sum across blocks is the current value
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#define METRICS_MAX_THREADS 128   /* Threads with their own block, later ones share one (atomic adds) */
+#define METRICS_NAME_LENGTH 24
+
+typedef enum {
+    METRIC_BYTES_RECEIVED,        /* User socket clients */
+    METRIC_BYTES_SENT,
+    METRIC_FRAMES_RECEIVED,
+    METRIC_FRAMES_SENT,           /* Queued for clients, room frames once per member */
+    METRIC_ROUTER_ACCEPTS,        /* Connections on the router port */
+    METRIC_SOCKET_CONNECTS,       /* Clients bound to their reserved slot */
+    METRIC_SESSION_REJECTS,       /* Unknown or already connected session keys */
+    METRIC_AUTH_SUCCESS,
+    METRIC_AUTH_FAILURE,
+    METRIC_REGISTER_SUCCESS,
+    METRIC_REGISTER_FAILURE,
+    METRIC_EVICT_IDLE,            /* Connected clients past CONNECTION_TIMEOUT */
+    METRIC_EVICT_RESERVATION,     /* Reservations past SESSION_RESERVE_TIMEOUT */
+    METRIC_EVICT_HANDSHAKE,       /* Connections past HANDSHAKE_TIMEOUT without a key */
+    METRIC_MESSAGES_DELIVERED,    /* User messages queued for their recipient */
+    METRIC_MESSAGES_DROPPED,
+    METRIC_ROOM_PUBLISHES,
+    METRIC_ROOM_DROPS,            /* Members that missed a room frame */
+    METRIC_LOOP_BUSY_NS,          /* Event loop time spent handling events */
+    METRIC_LOOP_IDLE_NS,          /* Event loop time spent waiting */
+    METRIC_DB_CALLS,              /* DB executor jobs run against the database */
+    METRIC_DB_NS,                 /* Time those jobs took, bcrypt included */
+    METRIC_LOGIN_WRITES,          /* Login updates written by the login writer */
+    METRIC_GAUGES,                /* Gauges from here on */
+    METRIC_CONNECTIONS = METRIC_GAUGES, /* Clients connected to user sockets */
+    METRIC_DB_QUEUE,              /* DB executor jobs waiting for a worker */
+    METRIC_COMMAND_QUEUE,         /* Socket commands waiting for their loop */
+    METRIC_MAILBOX_QUEUE,         /* User messages and room posts waiting for their loop */
+    METRIC_OUTPUT_QUEUE,          /* Bytes queued on client outputs, not yet sent */
+    METRIC_LOGIN_QUEUE,           /* Login updates waiting for the login writer */
+    METRIC_COUNT
+} MetricId;
+
+typedef struct {
+    int64_t values[METRIC_COUNT];
+    char name[METRICS_NAME_LENGTH]; /* Set by metrics_thread_register */
+    int shared;                   /* The overflow block, written with atomic adds */
+} __attribute__((aligned(64))) MetricsBlock;
+
+typedef struct {
+    int64_t values[METRIC_COUNT];
+} MetricsSnapshot;
+
+extern __thread MetricsBlock* metrics_thread_block;
+
+/*
+ * Claim the calling thread's block (the shared one past METRICS_MAX_THREADS)
+ */
+MetricsBlock* metrics_attach(void);
+
+/*
+ * Name the calling thread's block, a thread keeps the first name it is given
+ */
+void metrics_thread_register(const char* name);
+
+static inline void metrics_add(MetricId id, int64_t amount) {
+    MetricsBlock* block = metrics_thread_block ? metrics_thread_block : metrics_attach();
+    if (block->shared) {
+        __atomic_fetch_add(&block->values[id], amount, __ATOMIC_RELAXED);
+        return;
+    }
+    // Single writer: no read-modify-write needed, the store only has to be untorn for readers
+    __atomic_store_n(&block->values[id], block->values[id] + amount, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_inc(MetricId id) {
+    metrics_add(id, 1);
+}
+
+/*
+ * Sum of every thread's block, each value as of some moment during the call
+ */
+void metrics_collect(MetricsSnapshot* snapshot);
+
+/*
+ * One thread's block, for per-thread figures such as loop utilization
+ * @param name Receives the thread's name (empty if it never registered)
+ * @return -1 past the last thread (the shared overflow block comes last), 1 otherwise
+ */
+int metrics_thread_collect(int index, char name[METRICS_NAME_LENGTH], MetricsSnapshot* snapshot);
+
+/*
+ * Snake case name of a metric, e.g. "bytes_received"
+ */
+const char* metrics_name(MetricId id);
+
+/*
+ * One line description of a metric
+ */
+const char* metrics_help(MetricId id);
+
+/*
+ * Print every non-zero counter and gauge
+ */
+void metrics_report(void);
+
+#endif /* METRICS_H */
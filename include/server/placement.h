@@ -0,0 +1,71 @@
+/*
+ * include/server/placement.h
+ * Load-aware placement of users onto buckets and sockets
+ */
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "socket_pool.h"
+
+/*
+ * Live load of one socket
+ * load counts reserved and connected slots, it drops when a slot is released
+ */
+typedef struct {
+    Socket* sock;
+    int bucket;
+    int load;
+    int capacity;
+    int heap_pos;           /* Position in Placement.heap */
+} PlacementEntry;
+
+/*
+ * Min-heap of sockets ordered by load plus per-bucket counters
+ * A bucket's bit in bucket_full is set while every socket in it is at capacity
+ */
+typedef struct {
+    PlacementEntry* entries; /* One per socket, bucket by bucket */
+    int* heap;               /* Entry indexes, least loaded first */
+    int num_entries;
+    int* bucket_load;
+    int* bucket_capacity;
+    uint64_t* bucket_full;   /* Bitmap, one bit per bucket */
+    int num_buckets;
+    int total_load;
+    pthread_mutex_t lock;
+} Placement;
+
+/*
+ * Build the index over every socket of every bucket
+ * @return Placement or NULL on error
+ */
+Placement* create_placement(SocketPool* buckets, int num_buckets);
+void destroy_placement(Placement* placement);
+
+/*
+ * Take one unit of load on the least loaded socket that has room
+ * @return entry index, or -1 if every socket is full
+ */
+int placement_acquire(Placement* placement);
+
+/*
+ * Give back one unit of load on an entry returned by placement_acquire
+ */
+void placement_release(Placement* placement, int entry);
+
+/*
+ * Query bucket state
+ * is_full returns 1 if full, 0 otherwise; first_open returns -1 when all buckets are full
+ */
+int placement_bucket_is_full(Placement* placement, int bucket);
+int placement_first_open_bucket(Placement* placement);
+
+/*
+ * Copy every entry's load and every bucket's load in one consistent view
+ * @param entry_loads num_entries ints, bucket_loads num_buckets ints
+ */
+void placement_loads(Placement* placement, int* entry_loads, int* bucket_loads);
+
+#endif /* PLACEMENT_H */
@@ -0,0 +1,131 @@
+/*
+ * include/server/protocol.h
+ * Length-prefixed binary framing shared by the router and user sockets
+ *
+ * Frame: 8 byte header in network byte order, then `length` payload bytes
+ *   u8 magic (PROTO_MAGIC) | u8 opcode | u16 flags | u32 length
+ *
+ * The first byte a client sends picks its mode: PROTO_MAGIC means binary
+ * frames, anything else falls back to the connection's compat mode
+ * (newline terminated AUTH/REG text on the router, raw bytes on sockets)
+ */
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PROTO_MAGIC        0xC4
+#define PROTO_HEADER_SIZE  8
+#define PROTO_MAX_PAYLOAD  4096   /* Same as MAX_MESSAGE_SIZE */
+#define PROTO_BUFFER_SIZE  (PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD)
+
+/* Connection modes */
+#define PROTO_MODE_UNKNOWN 0      /* Nothing received yet */
+#define PROTO_MODE_BINARY  1      /* Framed */
+#define PROTO_MODE_TEXT    2      /* Compat: one command per line */
+#define PROTO_MODE_RAW     3      /* Compat: whatever arrived is one message */
+
+/* Client -> server opcodes */
+#define PROTO_OP_AUTH      0x01   /* Credentials payload */
+#define PROTO_OP_REG       0x02   /* Credentials payload */
+#define PROTO_OP_DATA      0x03   /* Opaque message */
+#define PROTO_OP_SEND      0x04   /* Message for another user: u8 length | username | body */
+#define PROTO_OP_JOIN      0x05   /* u8 length | room */
+#define PROTO_OP_LEAVE     0x06   /* u8 length | room */
+#define PROTO_OP_PUBLISH   0x07   /* Message for a room: u8 length | room | body */
+
+/* Server -> client opcodes */
+#define PROTO_OP_SESSION   0x81   /* u16 port | u32 session key */
+#define PROTO_OP_OK        0x82   /* Text */
+#define PROTO_OP_ERROR     0x83   /* Text */
+#define PROTO_OP_MESSAGE   0x84   /* From another user: u8 length | username | body */
+#define PROTO_OP_ROOM      0x85   /* Published to a room: u8 length | room | u8 length | sender | body */
+
+/* Compat mode messages, never on the wire */
+#define PROTO_OP_TEXT      0xF0   /* One line, newline stripped */
+#define PROTO_OP_RAW       0xF1   /* Bytes as read */
+
+#define PROTO_FLAG_EXISTING 0x0001 /* SESSION: user was already logged in */
+
+/*
+ * One parsed message, payload points into the parser's buffer
+ * Valid until the next frame_parser_space call
+ */
+typedef struct {
+    uint8_t opcode;
+    uint16_t flags;
+    uint32_t length;
+    const uint8_t* payload;
+} Frame;
+
+/*
+ * Per-connection input buffer, bytes are read straight into it
+ * Consumed frames advance start, the tail is compacted only to make room
+ */
+typedef struct {
+    uint8_t* data;
+    size_t start;           /* First unparsed byte */
+    size_t end;             /* One past the last received byte */
+    size_t capacity;
+    int mode;               /* PROTO_MODE_* */
+    int compat;             /* Mode used when the first byte is not PROTO_MAGIC */
+} FrameParser;
+
+/*
+ * Parse out of memory the caller owns (a BufferPool block), at least PROTO_BUFFER_SIZE
+ * @param compat PROTO_MODE_TEXT or PROTO_MODE_RAW
+ */
+void frame_parser_init(FrameParser* parser, uint8_t* buffer, size_t capacity, int compat);
+
+/*
+ * Room to read into, compacting first if needed (invalidates earlier frames)
+ */
+uint8_t* frame_parser_space(FrameParser* parser, size_t* available);
+void frame_parser_commit(FrameParser* parser, size_t bytes);
+
+/*
+ * Take the next complete message
+ * @return 1 with frame filled, 0 if more bytes are needed, -1 on a protocol error
+ */
+int frame_parser_next(FrameParser* parser, Frame* frame);
+
+/* Received bytes not yet returned as frames */
+static inline size_t frame_parser_pending(const FrameParser* parser) {
+    return parser->end - parser->start;
+}
+
+/*
+ * Write a frame header into out (PROTO_HEADER_SIZE bytes)
+ */
+void proto_encode_header(uint8_t* out, uint8_t opcode, uint16_t flags, uint32_t length);
+
+/*
+ * Build a whole frame in out
+ * @return frame size, or 0 if it does not fit in out_size
+ */
+size_t proto_encode_frame(uint8_t* out, size_t out_size, uint8_t opcode, uint16_t flags,
+                          const void* payload, uint32_t length);
+
+/*
+ * AUTH/REG payload: u8 username length | username | u8 password length | password
+ * Copies NUL terminated strings, returns -1 if malformed or too long
+ */
+int proto_parse_credentials(const Frame* frame, char* username, size_t username_size,
+                            char* password, size_t password_size);
+
+/*
+ * JOIN/LEAVE payload: u8 room length | room
+ * Copies a NUL terminated string, returns -1 if malformed or too long
+ */
+int proto_parse_name(const Frame* frame, char* name, size_t name_size);
+
+/*
+ * SEND/PUBLISH payload: u8 name length | username or room | body (rest of the frame, may be empty)
+ * Copies the name as a NUL terminated string, body points into the frame
+ * @return -1 if malformed or the name is too long
+ */
+int proto_parse_message(const Frame* frame, char* username, size_t username_size,
+                        const uint8_t** body, uint32_t* body_length);
+
+#endif /* PROTOCOL_H */
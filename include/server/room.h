@@ -0,0 +1,118 @@
+/*
+ * include/server/room.h
+ * Rooms: clients join by name and everything published to a room reaches
+ * every member, on whichever socket and event loop they are
+ *
+ * Each event loop keeps its own room index (RoomShard), touched only by that
+ * loop's thread. A publish encodes the frame once into a SharedBuffer and
+ * sends one RoomPost per loop with members; each loop queues a reference to
+ * the same buffer on every local member's output, no per-member copy
+ */
+#ifndef ROOM_H
+#define ROOM_H
+
+#include <stdint.h>
+#include "socket.h"
+#include "util/mpsc_queue.h"
+#include "util/output_queue.h"
+
+#define ROOM_NAME_LENGTH      32    /* Including the NUL */
+#define ROOM_INDEX_BUCKETS   256    /* Chains in each loop's room index, power of 2 */
+#define ROOM_INTEREST_SLOTS 1024    /* Room hash slots in the hub's interest map, power of 2 */
+#define ROOM_MAX_LOOPS        64    /* Loops tracked one bit each, more loops get every post */
+
+/*
+ * A room as seen by one loop: its members on that loop's sockets
+ */
+typedef struct RoomLocal {
+    char name[ROOM_NAME_LENGTH];
+    uint64_t hash;
+    ClientConnection** members;
+    int count;
+    int capacity;
+    struct RoomLocal* next;    // Index chain
+} RoomLocal;
+
+/*
+ * One published frame on its way to another loop, holds a frame reference
+ */
+typedef struct {
+    MpscNode node;             // First member
+    SharedBuffer* frame;       // Encoded ROOM frame
+    uint64_t hash;
+    char name[ROOM_NAME_LENGTH];
+} RoomPost;
+
+struct RoomHub;
+
+typedef struct {
+    struct RoomHub* hub;
+    EventLoop* loop;
+    int index;
+    SocketMailbox mailbox;     // RoomPosts from publishers on other loops
+    EventSource mailbox_source;
+    RoomLocal* index_buckets[ROOM_INDEX_BUCKETS];
+    uint32_t interest[ROOM_INTEREST_SLOTS]; // Local rooms per hub interest slot
+    unsigned long published;   // Publishes from this loop's clients
+    unsigned long delivered;   // Frames queued for local members
+    unsigned long dropped;     // Members whose output was full
+} RoomShard;
+
+/*
+ * Shared by every loop; interest says which loops have a room in each hash slot,
+ * so a publish only posts to loops that may have members
+ */
+typedef struct RoomHub {
+    RoomShard* shards;         // One per event loop, by loop index
+    int num_shards;
+    uint64_t seed;             // Room name hash seed
+    SlabClasses* slabs;        // Frames, posts and room indexes
+    uint64_t interest[ROOM_INTEREST_SLOTS]; // Bit per loop (atomic)
+} RoomHub;
+
+/*
+ * One shard per loop of the pool
+ * @param seed Room name hash seed
+ * @param slabs Size classes every room allocation comes from
+ * @return RoomHub or NULL on error
+ */
+RoomHub* create_room_hub(EventLoopPool* loops, uint64_t seed, SlabClasses* slabs);
+
+/*
+ * Register every shard's mailbox with its loop, before the loops start
+ * Returns -1 on error, 1 on success
+ */
+int start_room_hub(RoomHub* hub);
+
+/*
+ * Free rooms and undelivered posts, the loops must be stopped
+ */
+void destroy_room_hub(RoomHub* hub);
+
+/*
+ * Shard of the loop a socket runs on
+ */
+RoomShard* room_shard_for(RoomHub* hub, EventLoop* loop);
+
+/*
+ * Add / remove a connection (shard's loop thread)
+ * @return 1 on success, 0 if already in (join) or not in (leave) the room,
+ * -1 if the connection is in ROOMS_PER_CLIENT rooms or out of memory
+ */
+int room_join(RoomShard* shard, ClientConnection* conn, const char* name);
+int room_leave(RoomShard* shard, ClientConnection* conn, const char* name);
+
+/*
+ * Remove a closing connection from every room it joined
+ */
+void room_leave_all(RoomShard* shard, ClientConnection* conn);
+
+/*
+ * Publish body to every member of a room, the sender included if it is one
+ * Never blocks: other loops get the frame through their mailboxes
+ * @return -1 if the frame could not be built, 1 otherwise
+ */
+int room_publish(RoomShard* shard, const char* name, const char* sender,
+                 const uint8_t* body, uint32_t length);
+
+#endif /* ROOM_H */
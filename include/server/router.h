@@ -4,6 +4,11 @@
 #define ROUTER_H
 #include "socket.h"
 #include "socket_pool.h"
+#include "db_executor.h"
+#include "placement.h"
+#include "protocol.h"
+#include "room.h"
+#include "admin.h"
 #include <pthread.h>
 #include "db/user_db.h"
 #include "util/user_cache.h"
@@ -13,6 +18,14 @@
 #define USERS_PER_SOCKET 5
 #define MAIN_SOCKET_PORT 8080
 #define USER_SOCKET_PORT_START 8081
+#define AUTH_WORKER_THREADS 4
+#define ROUTER_REACTOR_THREADS 2   // Router event loops sharing MAIN_SOCKET_PORT
+#define ROUTER_BACKLOG 128         // Listen queue per router reactor
+#define ROUTER_FD_HANDOFF 0        // 1: pass the AUTH connection to its socket instead of a second connect
+#define EVENT_LOOP_THREADS 0       // Loops shared by all user sockets, 0 = one per core
+#define EGRESS_FLUSH_WINDOW_MS 0   // Extra ms a socket loop may hold output to batch more frames per write
+#define IO_BACKEND IO_BACKEND_EPOLL // Default event loop backend, CONNECTHUB_IO_BACKEND=io_uring overrides it
+#define METRICS_PORT 9100          // /metrics on 127.0.0.1, 0 = off; CONNECTHUB_METRICS=<port>|unix:<path>|off overrides it
 
 typedef struct {
     int max_users;          // NUMBER_OF_USERS
@@ -20,17 +33,70 @@ typedef struct {
     int users_per_socket;   // USERS_PER_SOCKET
     int router_port;        // MAIN_SOCKET_PORT
     int start_port;         // USER_SOCKET_PORT_START
+    int auth_workers;       // AUTH_WORKER_THREADS
+    int reactor_threads;    // ROUTER_REACTOR_THREADS
+    int fd_handoff;         // ROUTER_FD_HANDOFF
+    int event_loops;        // EVENT_LOOP_THREADS
+    int flush_window_ms;    // EGRESS_FLUSH_WINDOW_MS
+    int io_backend;         // IO_BACKEND (IO_BACKEND_*)
+    int metrics_port;       // METRICS_PORT
+    char metrics_path[ADMIN_UNIX_PATH_MAX]; // Unix socket instead of metrics_port when set
 } RouterConfig;
 
-typedef struct{
+struct Router;
+
+/*
+* One router event loop: its own SO_REUSEPORT listener on the router port,
+* its own EventLoop (same backend as the user sockets) and its own DB completion queue
+*/
+typedef struct {
+    struct Router* router;
+    RouterSocket socket;
+    EventLoop loop;                // Runs on its own thread, not part of the user socket pool
+    DbCompletionQueue db_completions; // Finished DB jobs for this reactor, callbacks run here
+    EventSource listener_source;   // Accepts on the router port
+    EventSource completion_source; // Completion eventfd readiness
+    int index;
+} RouterReactor;
+
+/*
+* A connection on the router port, owned by one reactor
+* Requests are parsed incrementally, binary frames or AUTH/REG text lines
+* Replies are queued in out and sent once per loop iteration
+*/
+typedef struct {
+    EventSource source;     // First member, owner = RouterReactor
+    FrameParser parser;
+    RingBuffer out;
+    FlushNode flush;        // Queued while out has replies to send this iteration
+    int receiving;          // A receive is outstanding (never while busy, paused or closing)
+    int sending;            // A send of out is outstanding
+    int busy;               // An AUTH/REG is with the workers, later requests wait
+    int paused;             // out is over the high-water mark, requests wait until it drains
+    int closing;            // Final reply queued, close once out is empty
+    int closed;             // Close requested, freed when the loop confirms it
+    int handoff_port;       // Authenticated with fd handoff: moves to this socket once out is empty
+    uint32_t handoff_key;
+} RouterClient;
+
+typedef struct Router {
     RouterConfig config;
-    uint8_t* bucket_status;  // Each bit represents a bucket's full status
+    Placement* placement;    // Live bucket/socket load, least loaded socket first
     SocketPool* socket_pool; //the socket pool for the router
+    EventLoopPool* event_loops; // Threads that run every user socket
     int num_buckets;
-    RouterSocket socket;
-    pthread_t main_socket_thread;
+    RouterReactor* reactors; // Accept/parse loops, one thread each
+    int num_reactors;
     UserDB* user_db;
     UserCache* user_cache;
+    DbExecutor* db_executor; // Runs bcrypt/SQLite work off the reactor threads
+    BufferPool* buffers;     // Input/output blocks for router clients and user sockets
+    SlabClasses* slabs;      // Commands, handshakes, user messages and room frames
+    SlabCache* client_slab;  // RouterClient per router connection
+    SlabCache* job_slab;     // DbJob per AUTH/REG request
+    const IoBackend* io;     // Backend requested for every event loop
+    SocketDirectory directory; // Lets sockets route user messages to each other
+    AdminServer* admin;      // Metrics endpoint, NULL when disabled
 } Router;
 
 /*
@@ -43,18 +109,39 @@ Router* create_router(UserDB* user_db);
 */
 int start_router(Router* router);
 
-void* router_socket_thread(Router* router);
+/*
+* Reactor thread body, runs the reactor's event loop until shutdown
+*/
+void* router_socket_thread(RouterReactor* reactor);
 /*
 * New connection for the router so assign it if possible to a socket (not in use) 
+* @return 1 on success, 0 if the user is already logged in, -1 if no socket has room
 */
 int handle_new_connection(Router* router, const char *username);
 
 int remove_connection(Router* router, const char *username);
 
+/*
+* Session key a logging in user presents on their socket, read from /dev/urandom
+*/
+uint32_t generate_session_key(void);
+
+/*
+* Reserve a slot for the key on the least loaded socket with room
+* @return the socket's port, or -1 if every socket is full
+*/
+int assign_user_socket(Router* router, uint32_t session_key);
+
 void shut_down_router(Router* router);
 
 // Authentication related functions
-int handle_authentication(Router* router, int client_fd, const char* username, const char* password);
-int handle_registration(Router* router, int client_fd, const char* username, const char* password);
+// Both queue the request on the DB executor and return 0, or -1 if it was answered/rejected immediately
+int handle_authentication(RouterReactor* reactor, RouterClient* client, const char* username, const char* password);
+int handle_registration(RouterReactor* reactor, RouterClient* client, const char* username, const char* password);
+
+/*
+* Run the callbacks of DB jobs handed back by the executor (runs on the reactor's thread)
+*/
+void handle_db_completions(RouterReactor* reactor);
 
 #endif /* ROUTER_H*/
\ No newline at end of file
@@ -11,6 +11,12 @@
 #include <sys/epoll.h>      // For epoll_create1(), epoll_ctl(), epoll_wait()
 #include <pthread.h>        // For pthread_create() and thread handling
 #include <errno.h>          // For errno and error constants
+#include "event_loop.h"
+#include "protocol.h"
+#include "util/buffer_pool.h"
+#include "util/output_queue.h"
+#include "util/mpsc_queue.h"
+#include "util/user_cache.h"
 
 #ifndef SOCKET_H
 #define SOCKET_H
@@ -19,6 +25,7 @@
 #define DEFAULT_RECV_BUFFER 8192   /* 8KB receive buffer */
 #define DEFAULT_SEND_BUFFER 8192   /* 8KB send buffer */
 #define DEFAULT_BACKLOG     1      /* Single connection backlog (dedicated sockets) */
+#define DEFAULT_WRITE_HIGH_WATER (DEFAULT_SEND_BUFFER - PROTO_BUFFER_SIZE) /* Room for one more frame above it */
 
 /* Socket status flags */
 #define SOCKET_STATUS_UNUSED 0
@@ -29,10 +36,15 @@
 #define MAX_EVENTS               32    /* Max epoll events to handle at once */
 
 #define CONNECTION_TIMEOUT    100    /* Seconds before inactive connection dropped */
+#define SESSION_RESERVE_TIMEOUT 60   /* Seconds a reserved or disconnected slot keeps its session key */
+#define HANDSHAKE_TIMEOUT      10    /* Seconds to send the session key after connecting */
 #define EPOLL_TIMEOUT         100    /* MS to wait for epoll events */
 
 #define MAX_MESSAGE_SIZE    4096   /* Maximum message size */
 #define MIN_BUFFER_SIZE     1024   /* Minimum buffer allocation */
+#define SLOT_OWNER_LENGTH     32   /* Username recorded with a reservation */
+#define MAILBOX_DRAIN_BATCH  256   /* Messages delivered per mailbox wakeup, the rest wait one iteration */
+#define ROOMS_PER_CLIENT       8   /* Rooms one connection may be in at once */
 
 #define SOCKET_ERROR_NONE     0
 #define SOCKET_ERROR_EPOLL    1
@@ -50,55 +62,176 @@ typedef struct {
     int backlog;           /* Listen backlog size for incoming connections */
     int reuse_addr;        /* Enable SO_REUSEADDR option */
     int keep_alive;        /* Enable SO_KEEPALIVE option */
+    int reuse_port;        /* Enable SO_REUSEPORT option (sharded listeners) */
+    int enable_listener;   /* Bind/listen on the socket's port (off when the router hands fds over) */
+    int write_high_water;  /* Queued output bytes at which a client stops being read until half drains */
 } SocketConfig;
 
+/* Client slot states */
+#define SLOT_FREE      0   /* Available for reservation */
+#define SLOT_RESERVED  1   /* Session key assigned, client not connected */
+#define SLOT_CONNECTED 2   /* Client connected with its session key */
+
+struct RoomLocal;
+
 typedef struct {
+    EventSource source;    // Registration with the socket's event loop (owner = Socket)
     uint32_t session_key;  // Random 32-bit session identifier
     int fd;                // Connection file descriptor
-    time_t last_active;    // Last activity timestamp
+    int state;             // SLOT_* state
+    time_t last_active;    // Loop clock ms of the last message, reservation or disconnect
+    TimerNode timer;       // Idle (connected) or reservation (reserved) deadline, loop thread only
+    FrameParser parser;    // Input of a connected client, frames or raw bytes
+    OutputQueue out;       // Frames for the client not written yet, copied or shared
+    FlushNode flush;       // Queued on the loop while out has frames to write this iteration
+    int receiving;         // A receive into parser is outstanding (never while paused)
+    int sending;           // A send of out's head is outstanding, at most one at a time
+    int paused;            // Reads stopped, out is over the high-water mark
+    char owner[SLOT_OWNER_LENGTH]; // User the slot was reserved for
+    struct RoomLocal* rooms[ROOMS_PER_CLIENT]; // Rooms joined, in the loop's room index
+    int num_rooms;
 } ClientConnection;
+
+/* Socket command types */
+#define SOCKET_CMD_HANDOFF 1   /* Adopt an already-accepted, authenticated client fd */
+#define SOCKET_CMD_RESERVE 2   /* Start the reservation timer of a newly reserved slot */
+
+/*
+ * Work posted to a socket's thread from other threads
+ */
+typedef struct SocketCommand {
+    int type;               /* SOCKET_CMD_* */
+    int fd;                 /* Client fd for SOCKET_CMD_HANDOFF */
+    uint32_t session_key;   /* Reservation the fd should claim */
+    int slot;               /* Slot for SOCKET_CMD_RESERVE */
+    uint64_t posted_at;     /* SOCKET_CMD_HANDOFF: when the router passed the fd on (ns) */
+    struct SocketCommand* next;
+} SocketCommand;
+
+/*
+ * Queue of SocketCommand for one socket thread
+ * event_fd is watched by the socket's event loop and becomes readable on post
+ */
+typedef struct {
+    int event_fd;
+    pthread_mutex_t lock;
+    SocketCommand* head;
+    SocketCommand* tail;
+} SocketCommandQueue;
+/*
+ * A user message on its way to a client of another socket
+ * Allocated by the sender's thread, freed by the recipient socket's thread,
+ * or posted back to the sender's socket when it could not be delivered
+ */
+struct Socket;
+typedef struct {
+    MpscNode node;          /* First member */
+    uint32_t session_key;   /* Recipient's session on the target socket */
+    struct Socket* origin;  /* Sender's socket and session, for the bounce */
+    uint32_t origin_key;
+    int bounced;            /* On its way back to origin */
+    uint32_t length;        /* Body bytes */
+    uint64_t received_at;   /* Sender's loop wakeup (ns) that read the SEND */
+    char sender[MAX_USERNAME];
+    uint8_t body[];
+} SocketMessage;
+
+/*
+ * Messages posted to a socket's thread by other socket threads
+ * Senders never lock: they push onto the queue, and only the one that finds
+ * no wakeup pending writes the eventfd
+ */
+typedef struct {
+    MpscQueue queue;
+    int event_fd;
+    int signaled;           /* 1 while a wakeup is pending (atomic) */
+    unsigned long delivered; /* Loop thread only */
+    unsigned long dropped;  /* Recipient no longer connected or its output full */
+} SocketMailbox;
+
 /*
  * Manages multiple client connections
- * Handles epoll and connection tracking
+ * Free slots are kept on a stack and session keys are indexed, so reserving,
+ * claiming and releasing a slot never scans the clients array
  */
 typedef struct {
-    int epoll_fd;          /* epoll instance file descriptor */
     ClientConnection* clients;  /* Array of client connections */
     int max_connections;   /* Maximum allowed concurrent connections */
     int current_connections; /* Current number of active connections */
+    int* free_slots;       /* Stack of SLOT_FREE indexes */
+    int free_count;        /* Entries on free_slots */
+    int* session_index;    /* Open-addressing session_key -> slot, -1 when empty */
+    int session_mask;      /* session_index size - 1 (power of 2) */
+    pthread_mutex_t lock;  /* Guards slot state shared with the router threads */
 } ConnectionManager;
 
 /*
  * Tracks socket and connection statistics
- * Maintains performance and activity metrics
+ * Written only on the socket's loop thread, other threads read a copy with get_socket_stats
+ * Server-wide totals are kept per thread in metrics.h
  */
 typedef struct {
-    unsigned long* bytes_sent_per_port;     /* Bytes sent tracking per port */
-    unsigned long* bytes_received_per_port;  /* Bytes received tracking per port */
-    int active_connections;                 /* Current number of active connections */
-    time_t* last_active_per_port;          /* Last activity timestamp per port */
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint64_t frames_sent;         /* Queued for clients */
+    uint64_t frames_received;
+    uint64_t connects;            /* Clients bound to a reserved slot */
+    uint64_t evictions;           /* Idle clients and expired reservations */
+    int64_t active_connections;   /* Current number of connected clients */
+    int64_t last_active;          /* Loop clock (ms) of the last client receive */
 } SocketStats;
 
 typedef struct {
     SocketConfig config;
     int port_number;
     int max_connections;
+    BufferPool* buffers;
+    SlabClasses* slabs;
 }SocketInitInfo;
 
+/*
+ * How a socket finds a user connected to another socket
+ * Built by the router before the sockets start, read-only afterwards
+ */
+typedef struct {
+    UserCache* users;          /* username -> port, session key */
+    struct Socket** by_port;   /* Indexed by port - first_port, NULL where no socket listens */
+    int first_port;
+    int num_ports;
+    struct RoomHub* rooms;     /* Room subscriptions, one shard per event loop (NULL: no rooms) */
+} SocketDirectory;
+
+/*
+ * Called on the socket's loop thread after a reservation times out and its slot is freed
+ * @param owner Username the slot was reserved for (empty if none was given)
+ */
+typedef void (*SlotExpiredHandler)(void* ctx, struct Socket* sock, uint32_t session_key, const char* owner);
+
 /*
  * Main socket structure
  * Manages multiple ports, connections, and associated resources
- * Each socket runs in its own thread handling multiple client connections
+ * Sockets share a fixed pool of event loop threads, many sockets per loop
  */
-typedef struct {
+typedef struct Socket {
     SocketConfig config;         /* Socket configuration parameters */
-    ConnectionManager conns;    /* Connection and epoll management */
+    ConnectionManager conns;    /* Connection tracking */
     SocketStats stats;         /* Performance and activity statistics */
-    pthread_t thread_id;       /* ID of thread managing this socket */
+    SocketCommandQueue commands; /* Handoffs and other cross-thread requests */
+    BufferPool* buffers;       /* Input and output blocks of connected clients (shared) */
+    SlabClasses* slabs;        /* Commands, handshakes and user messages (shared) */
+    EventLoop* loop;           /* Event loop thread multiplexing this socket */
+    EventSource listener_source; /* Listening fd registration (if enabled) */
+    EventSource command_source;  /* Command eventfd registration */
+    SocketMailbox mailbox;       /* User messages from other socket threads */
+    EventSource mailbox_source;  /* Mailbox eventfd registration */
+    const SocketDirectory* directory; /* Resolves message recipients, NULL disables messaging */
     int port;
     int socket_fd;
     int status;
     int error;
+    SlotExpiredHandler on_slot_expired; /* Optional, lets the owner release the session */
+    void* slot_expired_ctx;
+    int placement_entry;         /* The owner's placement index for this socket, -1 if none */
 } Socket;
 
 /*
@@ -108,7 +241,6 @@ typedef struct {
 typedef struct {
     SocketConfig config;         /* Socket configuration parameters */
     int socket_fd;              /* Main socket file descriptor */
-    int epoll_fd;
     int thread_id;
     time_t last_used;
     int port;                  /* Router port number */
@@ -125,6 +257,12 @@ typedef struct {
  */
 SocketConfig create_default_socket_config(void);
 
+/*
+ * Block size for a BufferPool serving sockets with this config
+ * Large enough for either buffer and a whole frame, rounded up to a power of 2
+ */
+size_t socket_buffer_block_size(const SocketConfig* config);
+
 /*
  * Initialize a socket with given configuration
  * @param config Configuration to use
@@ -137,9 +275,10 @@ RouterSocket create_router_socket(const SocketConfig config, int port);
 /*
 * Start the socket to be able to be accessed
 * @param socket the created socket held by the socket pool
+* @param loop event loop that will service the socket and its clients
 * @return the return value for error notification
 */
-int start_socket(Socket* sock);
+int start_socket(Socket* sock, EventLoop* loop);
 
 /*
  * Start the main router socket
@@ -149,24 +288,89 @@ int start_router_socket(RouterSocket* router_socket);
 
 /*
  * Clean up and free a socket
+ * The socket's event loop must already be stopped
  * @param socket Socket to destroy
  */
 int destroy_socket(Socket* sock);
 
 /*
- * Update socket activity timestamp
+ * Update socket activity timestamp (socket's loop thread)
  * @param socket Socket to update
  */
 void update_socket_activity(Socket* sock);
 
 /*
- * Update socket statistics
+ * Update socket statistics (socket's loop thread)
  * @param socket Socket to update
  * @param bytes_sent Number of bytes sent
  * @param bytes_received Number of bytes received
  */
 void update_socket_stats(Socket* sock, unsigned long bytes_sent, unsigned long bytes_received);
 
+/*
+ * Copy of a socket's statistics, from any thread without locking
+ */
+void get_socket_stats(const Socket* sock, SocketStats* stats);
+
 int is_socket_full(Socket* sock);
 
+/*
+ * Reserve a free client slot for a session key (callable from any thread)
+ * The slot is freed if no client claims it within SESSION_RESERVE_TIMEOUT
+ * @param owner Username passed back to on_slot_expired, may be NULL
+ * @return slot index, or -1 if the socket is full or the key is already in use
+ */
+int reserve_socket_slot(Socket* sock, uint32_t session_key, const char* owner);
+
+/*
+ * Return a reserved or disconnected slot to the free list
+ * @return -1 if the slot is connected or already free, 1 on success
+ */
+int release_socket_slot(Socket* sock, int slot);
+
+/*
+ * Hand an accepted, authenticated client fd to the socket's thread
+ * The fd must already have a reserved slot for session_key; ownership passes to the socket
+ * @return -1 on error (caller still owns the fd), 1 on success
+ */
+int socket_handoff_client(Socket* sock, int client_fd, uint32_t session_key);
+
+/*
+ * Set up a mailbox's queue and eventfd (the queue's stub must not move afterwards)
+ * Returns -1 on error, 1 on success
+ */
+int mailbox_open(SocketMailbox* mailbox);
+
+/*
+ * Queue a node from any thread, writing the eventfd only if no wakeup is pending
+ */
+void mailbox_post(SocketMailbox* mailbox, MpscNode* node);
+
+/*
+ * Owning loop: clear the eventfd and the pending wakeup, then pop until empty
+ * mailbox_wake asks for another pass when a drain stops early
+ */
+void mailbox_begin_drain(SocketMailbox* mailbox);
+void mailbox_wake(SocketMailbox* mailbox);
+
+/*
+ * Find the socket listening on a port (lock-free, any thread)
+ * @return the socket, or NULL if no socket has that port
+ */
+Socket* socket_directory_port(const SocketDirectory* directory, int port);
+
+/*
+ * Find the socket a logged in user was assigned to (lock-free, any thread)
+ * @param session_key Set to the user's current session
+ * @return the socket, or NULL if the user is not logged in
+ */
+Socket* socket_directory_find(const SocketDirectory* directory, const char* username, uint32_t* session_key);
+
+/*
+ * Queue a shared frame for a connected client without copying it (client's loop thread)
+ * Falls back to a copy when the client has too many shared frames queued
+ * @return -1 if the client is gone or its output is full (frame dropped), 1 otherwise
+ */
+int socket_queue_shared(ClientConnection* conn, SharedBuffer* frame);
+
 #endif /* SOCKET_H */
\ No newline at end of file
@@ -23,12 +23,19 @@ typedef struct {
     pthread_t thread_id;
 }SocketPool;
 
-SocketPool* create_socketpool(int num_sockets, int users_per_socket, int start_port);
+/*
+ * @param buffers Block pool the sockets draw client buffers from (shared, owned by the caller)
+ */
+SocketPool* create_socketpool(int num_sockets, int users_per_socket, int start_port, SocketConfig config, BufferPool* buffers, SlabClasses* slabs);
 
-int start_socketpool(SocketPool* socket_pool);
+int start_socketpool(SocketPool* socket_pool, EventLoopPool* loops);
 
 void* socket_pool_thread(void* arg);
 
+/*
+ * Destroy the pool's sockets and free their array
+ * The SocketPool itself is not freed, it may be an element of the caller's array
+ */
 int delete_socketpool(SocketPool* socket_pool);
 
 int find_open_socket(SocketPool* socket_pool, uint32_t session_key);
@@ -0,0 +1,43 @@
+/*
+ * include/util/buffer_pool.h
+ * Fixed-size I/O blocks shared by every connection, recycled through a free list
+ */
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define BUFFER_POOL_ALIGN 64
+
+typedef struct BufferBlock {
+    struct BufferBlock* next;   /* Free list link, stored in the block itself */
+} BufferBlock;
+
+typedef struct {
+    size_t block_size;
+    BufferBlock* free_list;
+    int free_count;
+    int total;                  /* Blocks allocated, free or in use */
+    pthread_mutex_t lock;
+} BufferPool;
+
+/*
+ * @param block_size Bytes per block (at least sizeof(BufferBlock))
+ * @param prealloc Blocks to allocate up front
+ * @return BufferPool or NULL on error
+ */
+BufferPool* create_buffer_pool(size_t block_size, int prealloc);
+
+/*
+ * Free the pool and its idle blocks, every block must have been put back
+ */
+void destroy_buffer_pool(BufferPool* pool);
+
+/*
+ * @return a block of pool->block_size bytes, or NULL if out of memory
+ */
+void* buffer_pool_get(BufferPool* pool);
+void buffer_pool_put(BufferPool* pool, void* block);
+
+#endif /* BUFFER_POOL_H */
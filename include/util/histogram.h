@@ -0,0 +1,84 @@
+/*
+ * include/util/histogram.h
+ * Log-linear (HDR style) histogram of 64-bit values, nanoseconds in practice
+ *
+ * Each power of 2 is split into HISTOGRAM_SUB_BUCKETS linear buckets, so a
+ * recorded value is known to within 1/16 of itself from 1 ns to about 18
+ * minutes in a fixed ~4.7 KB. Recording is one bucket index and three adds;
+ * a single writer uses plain relaxed stores so other threads can read the
+ * histogram while it is being written
+ */
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_BITS 40      /* Values from 2^40 up share the last bucket */
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+static inline int histogram_bucket(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) return (int)value;
+    if (value >> HISTOGRAM_MAX_BITS) return HISTOGRAM_BUCKETS - 1;
+
+    int magnitude = 63 - __builtin_clzll(value);
+    int shift = magnitude - HISTOGRAM_SUB_BITS;
+    return ((magnitude - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS) |
+           (int)((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/*
+ * Record from the histogram's only writer, concurrent readers see untorn counts
+ */
+static inline void histogram_record(Histogram* histogram, uint64_t value) {
+    uint64_t* bucket = &histogram->buckets[histogram_bucket(value)];
+    __atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->sum, histogram->sum + value, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Record into a histogram several threads write
+ */
+static inline void histogram_record_shared(Histogram* histogram, uint64_t value) {
+    __atomic_fetch_add(&histogram->buckets[histogram_bucket(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->sum, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Largest value that lands in bucket, what percentiles report
+ */
+uint64_t histogram_bucket_value(int bucket);
+
+void histogram_reset(Histogram* histogram);
+
+/*
+ * Add a histogram another thread may be writing (relaxed loads)
+ */
+void histogram_merge(Histogram* into, const Histogram* from);
+
+/*
+ * into = now - before, what was recorded between two reads of the same histogram
+ */
+void histogram_delta(Histogram* into, const Histogram* now, const Histogram* before);
+
+/*
+ * @param percentile 0 to 100, e.g. 99.9
+ * @return the bucket value at that rank, 0 if the histogram is empty
+ */
+uint64_t histogram_percentile(const Histogram* histogram, double percentile);
+
+/*
+ * Upper bound of the highest non-empty bucket, 0 if empty
+ */
+uint64_t histogram_max(const Histogram* histogram);
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,39 @@
+/*
+ * include/util/mpsc_queue.h
+ * Intrusive multi-producer single-consumer queue (Vyukov), no locks
+ * Producers may push from any thread, only the owning thread pops
+ */
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#define MPSC_CACHE_LINE 64
+
+typedef struct MpscNode {
+    struct MpscNode* next;
+} MpscNode;
+
+/*
+ * head is where producers append, tail is where the consumer takes from
+ * They sit on separate cache lines so pushes do not invalidate the consumer
+ */
+typedef struct {
+    MpscNode* head __attribute__((aligned(MPSC_CACHE_LINE)));
+    MpscNode* tail __attribute__((aligned(MPSC_CACHE_LINE)));
+    MpscNode stub;
+} MpscQueue;
+
+void mpsc_init(MpscQueue* queue);
+
+/*
+ * Append a node (any thread), wait-free: one exchange and one store
+ */
+void mpsc_push(MpscQueue* queue, MpscNode* node);
+
+/*
+ * Take the oldest node (consumer thread only)
+ * @return NULL when empty, or while the newest producer is between its two steps
+ * (that producer signals the consumer after finishing)
+ */
+MpscNode* mpsc_pop(MpscQueue* queue);
+
+#endif /* MPSC_QUEUE_H */
@@ -0,0 +1,91 @@
+/*
+ * include/util/output_queue.h
+ * Pending output of one connection: bytes copied into a RingBuffer, interleaved
+ * with references to SharedBuffers that many connections send from
+ */
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include "util/ring_buffer.h"
+#include "util/slab.h"
+
+#define OUTPUT_MAX_SHARED 64    /* Shared buffers queued per connection, power of 2 */
+
+/*
+ * Immutable bytes written once and sent by every holder of a reference
+ * The last unref gives it back to its slab, from whichever thread that is
+ */
+typedef struct {
+    uint32_t refs;          /* Atomic */
+    uint32_t length;
+    uint8_t data[];
+} SharedBuffer;
+
+/*
+ * @param slabs Size classes the buffer is taken from
+ * @return a buffer with one reference held by the caller, or NULL (also past SLAB_MAX_OBJECT)
+ */
+SharedBuffer* shared_buffer_create(SlabClasses* slabs, uint32_t length);
+void shared_buffer_ref(SharedBuffer* buffer);
+void shared_buffer_unref(SharedBuffer* buffer);
+
+typedef struct {
+    SharedBuffer* buffer;
+    uint32_t position;      /* Ring position the buffer follows: ring bytes before it go first */
+} OutputRef;
+
+/*
+ * Ring bytes and shared buffers in the order they were queued
+ * ref_head and ref_tail only grow, like the ring's head and tail
+ */
+typedef struct {
+    RingBuffer ring;
+    OutputRef refs[OUTPUT_MAX_SHARED];
+    uint32_t ref_head;
+    uint32_t ref_tail;
+    uint32_t ref_sent;      /* Bytes of the oldest shared buffer already sent */
+    uint32_t shared_bytes;  /* Unsent bytes across the shared buffers */
+} OutputQueue;
+
+/*
+ * Use memory the caller owns for the ring (e.g. a BufferPool block)
+ * @param capacity Power of 2
+ */
+void output_init(OutputQueue* queue, uint8_t* data, uint32_t capacity);
+
+/* Bytes queued, copied and shared */
+static inline uint32_t output_used(const OutputQueue* queue) {
+    return ring_used(&queue->ring) + queue->shared_bytes;
+}
+
+/*
+ * Copy every iovec in, or nothing if they do not all fit in the ring
+ * @return -1 if there is not enough room, 1 otherwise
+ */
+int output_append(OutputQueue* queue, const struct iovec* iov, int iovcnt);
+
+/*
+ * Queue a whole shared buffer, taking a reference (no copy)
+ * @return -1 if OUTPUT_MAX_SHARED buffers are already queued, 1 otherwise
+ */
+int output_append_shared(OutputQueue* queue, SharedBuffer* buffer);
+
+/*
+ * Describe the oldest pending bytes as at most max iovecs
+ * @return iovec count, 0 when empty
+ */
+int output_peek_iov(const OutputQueue* queue, struct iovec* iov, int max);
+
+/*
+ * Drop bytes that were sent, releasing shared buffers sent in full
+ */
+void output_consume(OutputQueue* queue, uint32_t length);
+
+/*
+ * Drop everything queued and release the shared buffers (ring memory stays with the caller)
+ */
+void output_reset(OutputQueue* queue);
+
+#endif /* OUTPUT_QUEUE_H */
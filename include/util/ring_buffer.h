@@ -0,0 +1,53 @@
+/*
+ * include/util/ring_buffer.h
+ * Byte ring for pending socket output, capacity a power of 2
+ * head and tail only grow, their difference is the byte count
+ */
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+typedef struct {
+    uint8_t* data;
+    uint32_t capacity;
+    uint32_t head;          /* Next byte to send */
+    uint32_t tail;          /* Next byte to fill */
+} RingBuffer;
+
+static inline uint32_t ring_used(const RingBuffer* ring) {
+    return ring->tail - ring->head;
+}
+
+static inline uint32_t ring_free(const RingBuffer* ring) {
+    return ring->capacity - ring_used(ring);
+}
+
+/*
+ * Use memory the caller owns (e.g. a BufferPool block)
+ * @param capacity Power of 2
+ */
+void ring_init(RingBuffer* ring, uint8_t* data, uint32_t capacity);
+
+/*
+ * Copy bytes in, at most ring_free
+ * @return bytes copied
+ */
+uint32_t ring_write(RingBuffer* ring, const void* bytes, uint32_t length);
+
+/*
+ * Copy every iovec in, or nothing if they do not all fit
+ * @return -1 if there is not enough room, 1 otherwise
+ */
+int ring_append(RingBuffer* ring, const struct iovec* iov, int iovcnt);
+
+/*
+ * Describe the pending bytes as at most two iovecs (the ring may wrap)
+ * @return iovec count, 0 when empty
+ */
+int ring_peek_iov(const RingBuffer* ring, struct iovec iov[2]);
+void ring_consume(RingBuffer* ring, uint32_t length);
+
+#endif /* RING_BUFFER_H */
@@ -0,0 +1,123 @@
+/*
+ * include/util/slab.h
+ * Fixed-size object caches carved out of aligned slabs, and size classes of
+ * them for variable-length payloads
+ *
+ * Each thread allocates from and frees into its own magazine of the cache,
+ * the locked depot is only touched to refill or spill half a magazine at a
+ * time. Memory is taken from the system a slab at a time and kept until the
+ * cache is destroyed, so a warm cache never calls malloc or free
+ */
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define SLAB_SIZE (64 * 1024)   /* Bytes per slab, slabs are aligned to it */
+#define SLAB_HEADER 64          /* Slab bytes before the first object */
+#define SLAB_MAX_OBJECT 8192    /* Largest object, at least 7 per slab */
+#define SLAB_MAX_THREADS 64     /* Threads with their own magazines, later ones share the depot */
+#define SLAB_MAGAZINE 32        /* Objects a thread keeps per cache */
+#define SLAB_NAME_LENGTH 24
+#define SLAB_CLASSES 8          /* Size classes 64, 128 ... SLAB_MAX_OBJECT */
+#define SLAB_MIN_CLASS 64
+
+struct SlabCache;
+
+/*
+ * Start of every slab, found from any object by masking its address
+ */
+typedef struct Slab {
+    struct SlabCache* cache;
+    struct Slab* next;          /* Every slab of the cache */
+} Slab;
+
+typedef struct SlabObject {
+    struct SlabObject* next;    /* Depot link, stored in the free object itself */
+} SlabObject;
+
+/*
+ * Written only by the thread owning the slot
+ */
+typedef struct {
+    void* objects[SLAB_MAGAZINE];
+    int count;
+    unsigned long allocs;
+    unsigned long frees;
+} __attribute__((aligned(64))) SlabMagazine;
+
+typedef struct SlabCache {
+    char name[SLAB_NAME_LENGTH];
+    size_t object_size;         /* Rounded up, 16 byte aligned (64 from 64 bytes up) */
+    int per_slab;
+    pthread_mutex_t lock;       /* Depot, slab list and the counters below */
+    SlabObject* depot;
+    int depot_count;
+    Slab* slabs;
+    int num_slabs;
+    unsigned long refills;      /* Magazine refills and spills through the depot */
+    unsigned long shared_allocs; /* Threads past SLAB_MAX_THREADS */
+    unsigned long shared_frees;
+    SlabMagazine magazines[SLAB_MAX_THREADS];
+} SlabCache;
+
+/*
+ * One cache per power of 2 from SLAB_MIN_CLASS to SLAB_MAX_OBJECT
+ */
+typedef struct {
+    SlabCache* classes[SLAB_CLASSES];
+} SlabClasses;
+
+typedef struct {
+    size_t object_size;
+    int slabs;                  /* Slabs taken from the system */
+    unsigned long objects;      /* Objects those slabs hold */
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long in_use;
+    unsigned long refills;
+} SlabStats;
+
+/*
+ * @param name Shown in statistics
+ * @param object_size Bytes per object, at most SLAB_MAX_OBJECT
+ * @param prealloc Objects to carve up front
+ * @return SlabCache or NULL on error
+ */
+SlabCache* create_slab_cache(const char* name, size_t object_size, int prealloc);
+
+/*
+ * Print its statistics and free every slab, objects still in use included
+ */
+void destroy_slab_cache(SlabCache* cache);
+
+/*
+ * @return an object of cache->object_size bytes (not zeroed), or NULL if out of memory
+ */
+void* slab_alloc(SlabCache* cache);
+
+/*
+ * Give back an object of any cache, from any thread (NULL is ignored)
+ */
+void slab_free(void* object);
+
+/*
+ * Totals across every thread, approximate while other threads allocate
+ */
+void slab_cache_stats(SlabCache* cache, SlabStats* stats);
+
+/*
+ * @param name Prefix of the class names ("<name>-<size>")
+ * @return SlabClasses or NULL on error
+ */
+SlabClasses* create_slab_classes(const char* name);
+void destroy_slab_classes(SlabClasses* classes);
+
+/*
+ * Object from the smallest class that holds size bytes, free it with slab_free
+ * @return NULL if size is over SLAB_MAX_OBJECT or out of memory
+ */
+void* slab_alloc_size(SlabClasses* classes, size_t size);
+
+#endif /* SLAB_H */
@@ -0,0 +1,67 @@
+/*
+ * include/util/timer_wheel.h
+ * Hierarchical timing wheel: O(1) schedule and cancel, timers fire in tick order
+ * Not thread-safe, each wheel belongs to one thread (an event loop)
+ */
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TIMER_WHEEL_TICK_MS   100  /* Resolution of one tick */
+#define TIMER_WHEEL_BITS      6
+#define TIMER_WHEEL_SLOTS     (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS    4    /* 64^4 ticks, about 19 days at 100ms */
+
+struct TimerNode;
+
+/*
+ * Called on the wheel's thread once the timer is due
+ * The timer is already unlinked, so the callback may schedule it again
+ */
+typedef void (*TimerCallback)(struct TimerNode* timer);
+
+/*
+ * Embedded in whatever it times, linked into one wheel slot while pending
+ */
+typedef struct TimerNode {
+    struct TimerNode* next;   /* NULL while not scheduled */
+    struct TimerNode* prev;
+    uint64_t expires;         /* Tick the timer is due */
+    TimerCallback callback;
+    void* owner;              /* Structure that embeds this timer */
+} TimerNode;
+
+typedef struct {
+    TimerNode slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; /* List heads */
+    uint64_t current;         /* Next tick to run */
+    int pending;              /* Timers scheduled */
+} TimerWheel;
+
+/*
+ * Start the wheel at a clock reading in milliseconds
+ */
+void timer_wheel_init(TimerWheel* wheel, uint64_t now_ms);
+
+void timer_init(TimerNode* timer, TimerCallback callback, void* owner);
+
+/*
+ * Schedule (or move) a timer to fire at expires_ms on the wheel's clock
+ * Deadlines are rounded up to the next tick, never fired early
+ */
+void timer_wheel_schedule(TimerWheel* wheel, TimerNode* timer, uint64_t expires_ms);
+
+void timer_wheel_cancel(TimerWheel* wheel, TimerNode* timer);
+
+static inline int timer_pending(const TimerNode* timer) {
+    return timer->next != NULL;
+}
+
+/*
+ * Run every timer due at or before now_ms
+ * @return number of timers fired
+ */
+int timer_wheel_advance(TimerWheel* wheel, uint64_t now_ms);
+
+#endif /* TIMER_WHEEL_H */
@@ -1,14 +1,20 @@
 /**
  * @file user_cache.h
  * @author Gabriel Perez
- * @brief 
- * A hashmap data strcture to hold active users on the server and their respevite ports 
+ * @brief
+ * A hashmap data strcture to hold active users on the server and their respevite ports
  * <char[], int> key value format
- * @version 0.1
+ * Open addressing (Robin Hood) with inline usernames and stored hashes,
+ * grown incrementally so no single call pays for a full rehash.
+ * Safe for concurrent use: the table is split into stripes, writers take the
+ * stripe lock, readers never lock (per-stripe seqlock, tables retired by epoch)
+ * Port counts and a per-stripe expiry queue keep is_port_in_use O(1) and
+ * cleanup_inactive_users proportional to the entries that expired
+ * @version 0.4
  * @date 2025-01-15
- * 
+ *
  * @copyright Copyright (c) 2025
- * 
+ *
  */
 
 
@@ -19,22 +25,89 @@
 #include <stdlib.h>
 #include <time.h>
 #include <stdint.h>
+#include <pthread.h>
 
-#define HASH_SIZE 1024  // Size of hash table, power of 2
+#define HASH_SIZE 1024  // Initial number of slots across all stripes, power of 2
 #define MAX_USERNAME 32 // Max length of username
 #define HASH_MASK (HASH_SIZE - 1)  // For fast modulo
 
-typedef struct UserNode {
-    char username[MAX_USERNAME];
+#define USER_CACHE_MAX_LOAD 7       // Grow when entries exceed 7/8 of the slots
+#define USER_CACHE_MIGRATE_STEP 16  // Old slots moved per operation while growing
+#define USER_CACHE_STRIPES 64       // Independently locked shards, power of 2
+#define USER_CACHE_MAX_READERS 256  // Threads with a lock-free read slot, others fall back to the stripe lock
+#define USER_CACHE_LINE 64
+#define USER_CACHE_MAX_PORT 65535   // Ports are counted in a flat array
+#define USER_CACHE_EXPIRY_INIT 16   // Initial expiry queue capacity per stripe
+
+typedef struct {
+    uint32_t hash;            // Stored hash, 0 marks an empty slot
     int port;
     uint32_t session_key;     // For verification
+    uint32_t flags;           // Removal marker while the entry's table is draining
     time_t last_active;       // For timeout management
-    struct UserNode* next;    // For collision handling
-} UserNode;
+    char username[MAX_USERNAME]; // Inline, zero padded
+    uint32_t ticket;          // Matches the entry's one live expiry record
+} UserEntry;
+
+/*
+ * One open-addressing table, allocated with its slots so readers see
+ * mask and slots from the same snapshot
+ */
+typedef struct {
+    uint32_t mask;            // Slot count - 1
+    int size;                 // Entries in this table
+    UserEntry slots[];
+} UserTable;
+
+/*
+ * Expiry queue record, appended whenever an entry's last_active changes
+ * Records are in last_active order; one whose ticket no longer matches its
+ * entry is stale and skipped
+ */
+typedef struct {
+    uint32_t hash;
+    uint32_t ticket;
+    time_t stamp;             // last_active when queued
+    char username[MAX_USERNAME];
+} ExpiryRecord;
 
 typedef struct {
-    UserNode* buckets[HASH_SIZE];
-    int size;                 // Current number of entries
+    ExpiryRecord* records;    // Ring buffer, oldest at head
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;
+} ExpiryQueue;
+
+typedef struct {
+    pthread_mutex_t lock;     // Held by writers
+    uint32_t seq;             // Seqlock, odd while a writer is changing the stripe
+    UserTable* table;         // Current table, all inserts go here
+    UserTable* old;           // Table being drained while growing (NULL otherwise)
+    uint32_t migrate_pos;     // Next old slot to move
+    int count;                // Live entries across both tables
+    uint32_t next_ticket;
+    ExpiryQueue expiry;       // Writer side only
+} __attribute__((aligned(USER_CACHE_LINE))) UserCacheStripe;
+
+typedef struct {
+    uint64_t active;          // Epoch the reader entered with, 0 when not reading
+} __attribute__((aligned(USER_CACHE_LINE))) UserCacheReader;
+
+typedef struct RetiredTable {
+    UserTable* table;
+    uint64_t epoch;           // Global epoch when it was unlinked
+    struct RetiredTable* next;
+} RetiredTable;
+
+typedef struct {
+    UserCacheStripe stripes[USER_CACHE_STRIPES];
+    UserCacheReader readers[USER_CACHE_MAX_READERS];
+    uint64_t seed;            // Per-cache hash seed
+    uint64_t epoch;           // Advanced every time a table is retired
+    pthread_mutex_t retire_lock;
+    RetiredTable* retired;    // Tables waiting for readers to move past their epoch
+    int size;                 // Current number of entries (atomic)
+    int* port_counts;         // Users per port, 0..USER_CACHE_MAX_PORT (atomic)
 } UserCache;
 
 // Core functions
@@ -44,21 +117,43 @@ void destroy_user_cache(UserCache* cache);
 // Operations
 int add_user(UserCache* cache, const char* username, int port, uint32_t session_key);
 int remove_user(UserCache* cache, const char* username);
+int remove_user_session(UserCache* cache, const char* username, uint32_t session_key); // Only if the session still matches
 int get_user_port(UserCache* cache, const char* username);
 uint32_t get_user_session(UserCache* cache, const char* username);
+int get_user_route(UserCache* cache, const char* username, int* port, uint32_t* session_key); // Port and session in one read, -1 if not found
 int update_user_activity(UserCache* cache, const char* username);
 
 // Utility functions
 int has_user(UserCache* cache, const char* username);
 int is_port_in_use(UserCache* cache, int port);
 void cleanup_inactive_users(UserCache* cache, time_t timeout);
+int user_cache_size(UserCache* cache);
+int user_cache_port_count(UserCache* cache, int port);
+
+// Seeded hash for usernames (8 bytes per round, splitmix finalizer)
+static inline uint64_t hash_username(const char* username, uint64_t seed) {
+    uint64_t hash = seed ^ 0x9E3779B97F4A7C15ULL;
+    size_t len = strnlen(username, MAX_USERNAME - 1);
+    size_t remaining = len;
 
-// Hash function for strings
-static inline unsigned int hash_username(const char* username) {
-    unsigned int hash = 0;
-    while (*username) {
-        hash = hash * 31 + *username++;
+    while (remaining >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, username, 8);
+        hash = (hash ^ chunk) * 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 31;
+        username += 8;
+        remaining -= 8;
     }
-    return hash & HASH_MASK;
+
+    uint64_t tail = 0;
+    memcpy(&tail, username, remaining);
+    hash ^= tail ^ ((uint64_t)len << 56);
+
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+    return hash;
 }
-#endif
\ No newline at end of file
+#endif
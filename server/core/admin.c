@@ -0,0 +1,436 @@
+#define _GNU_SOURCE
+#include "server/admin.h"
+#include "server/router.h"
+#include "server/metrics.h"
+#include "server/latency.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define METRIC_PREFIX "connecthub_"
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int failed;             // Out of memory, the page is dropped
+} Page;
+
+static void page_printf(Page* page, const char* format, ...) {
+    if (page->failed) return;
+
+    while (1) {
+        va_list args;
+        va_start(args, format);
+        int needed = vsnprintf(page->data + page->length, page->capacity - page->length, format, args);
+        va_end(args);
+        if (needed < 0) {
+            page->failed = 1;
+            return;
+        }
+        if ((size_t)needed < page->capacity - page->length) {
+            page->length += needed;
+            return;
+        }
+
+        size_t capacity = page->capacity * 2;
+        while (capacity - page->length <= (size_t)needed) capacity *= 2;
+        char* data = (char*)realloc(page->data, capacity);
+        if (!data) {
+            page->failed = 1;
+            return;
+        }
+        page->data = data;
+        page->capacity = capacity;
+    }
+}
+
+static void page_header(Page* page, const char* name, const char* type, const char* help) {
+    page_printf(page, "# HELP " METRIC_PREFIX "%s %s\n# TYPE " METRIC_PREFIX "%s %s\n", name, help, name, type);
+}
+
+// Nanosecond counters are exported in seconds, Prometheus' base unit
+static int is_nanoseconds(MetricId id) {
+    return id == METRIC_LOOP_BUSY_NS || id == METRIC_LOOP_IDLE_NS || id == METRIC_DB_NS;
+}
+
+static void exported_name(MetricId id, char* name, size_t size) {
+    const char* base = metrics_name(id);
+    size_t length = strlen(base);
+    if (is_nanoseconds(id)) {
+        snprintf(name, size, "%.*s_seconds_total", (int)(length - 3), base);
+    } else if (id < METRIC_GAUGES) {
+        snprintf(name, size, "%s_total", base);
+    } else {
+        snprintf(name, size, "%s", base);
+    }
+}
+
+static void render_metric_values(Page* page, const MetricsSnapshot* snapshot) {
+    char name[64];
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        exported_name(id, name, sizeof(name));
+        page_header(page, name, id < METRIC_GAUGES ? "counter" : "gauge", metrics_help(id));
+        if (is_nanoseconds(id)) {
+            page_printf(page, METRIC_PREFIX "%s %.9f\n", name, snapshot->values[id] / 1e9);
+        } else {
+            page_printf(page, METRIC_PREFIX "%s %lld\n", name, (long long)snapshot->values[id]);
+        }
+    }
+}
+
+// Busy and idle time of every thread that runs an event loop, busy / (busy + idle) is its utilization
+static void render_thread_values(Page* page) {
+    static const MetricId loop_metrics[] = { METRIC_LOOP_BUSY_NS, METRIC_LOOP_IDLE_NS };
+    char base[64];
+    char name[80];
+    char thread[METRICS_NAME_LENGTH];
+    MetricsSnapshot snapshot;
+
+    for (size_t m = 0; m < sizeof(loop_metrics) / sizeof(loop_metrics[0]); m++) {
+        MetricId id = loop_metrics[m];
+        exported_name(id, base, sizeof(base));
+        snprintf(name, sizeof(name), "thread_%s", base);
+        page_header(page, name, "counter", metrics_help(id));
+        for (int i = 0; metrics_thread_collect(i, thread, &snapshot) > 0; i++) {
+            if (snapshot.values[METRIC_LOOP_BUSY_NS] == 0 && snapshot.values[METRIC_LOOP_IDLE_NS] == 0) continue;
+            page_printf(page, METRIC_PREFIX "%s{thread=\"%s\"} %.9f\n", name,
+                        thread[0] ? thread : "unnamed", snapshot.values[id] / 1e9);
+        }
+    }
+}
+
+static void render_placement(Page* page, Router* router) {
+    Placement* placement = router->placement;
+    if (!placement) return;
+
+    int* entry_loads = (int*)calloc(placement->num_entries + placement->num_buckets, sizeof(int));
+    if (!entry_loads) {
+        page->failed = 1;
+        return;
+    }
+    int* bucket_loads = entry_loads + placement->num_entries;
+    placement_loads(placement, entry_loads, bucket_loads);
+
+    page_header(page, "bucket_load", "gauge", "Reserved and connected slots per bucket");
+    for (int b = 0; b < placement->num_buckets; b++) {
+        page_printf(page, METRIC_PREFIX "bucket_load{bucket=\"%d\"} %d\n", b, bucket_loads[b]);
+    }
+    page_header(page, "bucket_capacity", "gauge", "Slots per bucket");
+    for (int b = 0; b < placement->num_buckets; b++) {
+        page_printf(page, METRIC_PREFIX "bucket_capacity{bucket=\"%d\"} %d\n", b, placement->bucket_capacity[b]);
+    }
+
+    page_header(page, "socket_load", "gauge", "Reserved and connected slots per user socket");
+    for (int i = 0; i < placement->num_entries; i++) {
+        const PlacementEntry* entry = &placement->entries[i];
+        page_printf(page, METRIC_PREFIX "socket_load{bucket=\"%d\",port=\"%d\"} %d\n",
+                    entry->bucket, entry->sock->port, entry_loads[i]);
+    }
+    page_header(page, "socket_capacity", "gauge", "Slots per user socket");
+    for (int i = 0; i < placement->num_entries; i++) {
+        const PlacementEntry* entry = &placement->entries[i];
+        page_printf(page, METRIC_PREFIX "socket_capacity{bucket=\"%d\",port=\"%d\"} %d\n",
+                    entry->bucket, entry->sock->port, entry->capacity);
+    }
+    free(entry_loads);
+
+    // Socket stats are written by their loops, each read is untorn but the set is not atomic
+    SocketStats* stats = (SocketStats*)calloc(placement->num_entries, sizeof(SocketStats));
+    if (!stats) {
+        page->failed = 1;
+        return;
+    }
+    for (int i = 0; i < placement->num_entries; i++) {
+        get_socket_stats(placement->entries[i].sock, &stats[i]);
+    }
+
+#define SOCKET_FIELD(metric, type, help, expr) \
+    page_header(page, metric, type, help); \
+    for (int i = 0; i < placement->num_entries; i++) { \
+        page_printf(page, METRIC_PREFIX metric "{port=\"%d\"} %lld\n", \
+                    placement->entries[i].sock->port, (long long)(expr)); \
+    }
+
+    SOCKET_FIELD("socket_connections", "gauge", "Clients connected per user socket", stats[i].active_connections);
+    SOCKET_FIELD("socket_bytes_received_total", "counter", "Bytes received per user socket", stats[i].bytes_received);
+    SOCKET_FIELD("socket_bytes_sent_total", "counter", "Bytes sent per user socket", stats[i].bytes_sent);
+    SOCKET_FIELD("socket_frames_received_total", "counter", "Frames received per user socket", stats[i].frames_received);
+    SOCKET_FIELD("socket_frames_sent_total", "counter", "Frames queued per user socket", stats[i].frames_sent);
+    SOCKET_FIELD("socket_evictions_total", "counter", "Idle clients and expired reservations per user socket", stats[i].evictions);
+#undef SOCKET_FIELD
+
+    free(stats);
+}
+
+// Summaries: quantiles over the last scrape interval, sum and count since startup
+static void render_latencies(Page* page, AdminServer* admin) {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    LatencySnapshot* interval = (LatencySnapshot*)malloc(sizeof(LatencySnapshot));
+    LatencySnapshot* total = (LatencySnapshot*)malloc(sizeof(LatencySnapshot));
+    if (!interval || !total) {
+        free(interval);
+        free(total);
+        page->failed = 1;
+        return;
+    }
+    latency_interval(&admin->latency, interval);
+    latency_collect(total);
+
+    char name[64];
+    for (int id = 0; id < LATENCY_COUNT; id++) {
+        const Histogram* recent = &interval->histograms[id];
+        snprintf(name, sizeof(name), "%s_latency_seconds", latency_name(id));
+        page_header(page, name, "summary", latency_help(id));
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            // No samples this interval: NaN, as Prometheus clients report an empty summary
+            if (recent->count == 0) {
+                page_printf(page, METRIC_PREFIX "%s{quantile=\"%g\"} NaN\n", name, quantiles[q]);
+            } else {
+                page_printf(page, METRIC_PREFIX "%s{quantile=\"%g\"} %.9f\n", name, quantiles[q],
+                            histogram_percentile(recent, quantiles[q] * 100) / 1e9);
+            }
+        }
+        page_printf(page, METRIC_PREFIX "%s_sum %.9f\n", name, total->histograms[id].sum / 1e9);
+        page_printf(page, METRIC_PREFIX "%s_count %llu\n", name, (unsigned long long)total->histograms[id].count);
+    }
+    free(interval);
+    free(total);
+}
+
+char* render_admin_metrics(AdminServer* admin, size_t* length) {
+    Router* router = admin->router;
+    Page page = { NULL, 0, 16384, 0 };
+    page.data = (char*)malloc(page.capacity);
+    if (!page.data) return NULL;
+
+    MetricsSnapshot snapshot;
+    metrics_collect(&snapshot);
+    render_metric_values(&page, &snapshot);
+    render_thread_values(&page);
+    render_placement(&page, router);
+    render_latencies(&page, admin);
+
+    page_header(&page, "user_cache_entries", "gauge", "Users in the session cache");
+    page_printf(&page, METRIC_PREFIX "user_cache_entries %d\n",
+                router->user_cache ? user_cache_size(router->user_cache) : 0);
+
+    if (page.failed) {
+        free(page.data);
+        return NULL;
+    }
+    *length = page.length;
+    return page.data;
+}
+
+static int send_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return 1;
+}
+
+static void send_status(int fd, const char* status) {
+    char response[256];
+    int length = snprintf(response, sizeof(response),
+                          "HTTP/1.0 %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s\n",
+                          status, strlen(status) + 1, status);
+    send_all(fd, response, length);
+}
+
+// One request per connection, answered in full before the next accept
+static void serve_client(AdminServer* admin, int fd) {
+    struct timeval timeout = { ADMIN_IO_TIMEOUT_MS / 1000, (ADMIN_IO_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[ADMIN_REQUEST_MAX + 1];
+    size_t received = 0;
+    while (received < ADMIN_REQUEST_MAX) {
+        ssize_t count = recv(fd, request + received, ADMIN_REQUEST_MAX - received, 0);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+        received += count;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+    request[received] = '\0';
+
+    if (strncmp(request, "GET ", 4) != 0) {
+        send_status(fd, "405 Method Not Allowed");
+        return;
+    }
+    const char* path = request + 4;
+    size_t path_length = strcspn(path, " ?\r\n");
+    if (!(path_length == 8 && strncmp(path, "/metrics", 8) == 0)) {
+        send_status(fd, "404 Not Found");
+        return;
+    }
+
+    size_t length = 0;
+    char* body = render_admin_metrics(admin, &length);
+    if (!body) {
+        send_status(fd, "500 Internal Server Error");
+        return;
+    }
+
+    char head[160];
+    int head_length = snprintf(head, sizeof(head),
+                               "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: %zu\r\nConnection: close\r\n\r\n", length);
+    if (send_all(fd, head, head_length) > 0) {
+        send_all(fd, body, length);
+    }
+    free(body);
+    admin->scrapes++;
+}
+
+static void* admin_thread(void* arg) {
+    AdminServer* admin = (AdminServer*)arg;
+    metrics_thread_register("admin");
+
+    struct pollfd fds[2] = {
+        { .fd = admin->listen_fd, .events = POLLIN },
+        { .fd = admin->stop_fd, .events = POLLIN },
+    };
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            printf("Admin endpoint poll failed: %s\n", strerror(errno));
+            break;
+        }
+        if (fds[1].revents) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int client_fd = accept4(admin->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client_fd < 0) continue;
+        serve_client(admin, client_fd);
+        close(client_fd);
+    }
+    return NULL;
+}
+
+int parse_admin_endpoint(const char* spec, int* port, char unix_path[ADMIN_UNIX_PATH_MAX]) {
+    *port = 0;
+    unix_path[0] = '\0';
+    if (!spec || spec[0] == '\0' || strcmp(spec, "off") == 0 || strcmp(spec, "0") == 0) return 0;
+
+    if (strncmp(spec, "unix:", 5) == 0) {
+        size_t length = strlen(spec + 5);
+        if (length == 0 || length >= ADMIN_UNIX_PATH_MAX) return -1;
+        memcpy(unix_path, spec + 5, length + 1);
+        return 1;
+    }
+
+    char* end = NULL;
+    long value = strtol(spec, &end, 10);
+    if (*end != '\0' || value <= 0 || value > 65535) return -1;
+    *port = (int)value;
+    return 1;
+}
+
+static int bind_endpoint(AdminServer* admin) {
+    if (admin->unix_path[0]) {
+        admin->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (admin->listen_fd < 0) return -1;
+
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, admin->unix_path, strlen(admin->unix_path) + 1);
+        // A stale socket file from an earlier run would fail the bind
+        unlink(admin->unix_path);
+        if (bind(admin->listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0) return -1;
+    } else {
+        admin->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (admin->listen_fd < 0) return -1;
+
+        int reuse = 1;
+        setsockopt(admin->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        // Loopback only, the page is not meant for the outside world
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(admin->port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(admin->listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0) return -1;
+    }
+    return listen(admin->listen_fd, 16);
+}
+
+static void close_admin_server(AdminServer* admin) {
+    if (admin->listen_fd >= 0) close(admin->listen_fd);
+    if (admin->stop_fd >= 0) close(admin->stop_fd);
+    if (admin->unix_path[0]) unlink(admin->unix_path);
+    free(admin);
+}
+
+AdminServer* start_admin_server(Router* router, int port, const char* unix_path) {
+    if (!router) return NULL;
+
+    AdminServer* admin = (AdminServer*)calloc(1, sizeof(AdminServer));
+    if (!admin) return NULL;
+
+    admin->router = router;
+    admin->port = port;
+    admin->listen_fd = -1;
+    admin->stop_fd = -1;
+    if (unix_path && unix_path[0]) {
+        snprintf(admin->unix_path, sizeof(admin->unix_path), "%s", unix_path);
+        admin->port = 0;
+    }
+
+    if (bind_endpoint(admin) < 0) {
+        printf("Failed to bind the metrics endpoint: %s\n", strerror(errno));
+        admin->unix_path[0] = '\0';  // Not ours to unlink
+        close_admin_server(admin);
+        return NULL;
+    }
+
+    admin->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (admin->stop_fd < 0 || pthread_create(&admin->thread, NULL, admin_thread, admin) != 0) {
+        printf("Failed to start the metrics endpoint\n");
+        close_admin_server(admin);
+        return NULL;
+    }
+    admin->running = 1;
+
+    if (admin->unix_path[0]) {
+        printf("Metrics on unix:%s/metrics\n", admin->unix_path);
+    } else {
+        printf("Metrics on http://127.0.0.1:%d/metrics\n", admin->port);
+    }
+    return admin;
+}
+
+void stop_admin_server(AdminServer* admin) {
+    if (!admin) return;
+
+    if (admin->running) {
+        uint64_t one = 1;
+        if (write(admin->stop_fd, &one, sizeof(one)) < 0) {
+            printf("Failed to signal the metrics endpoint\n");
+        }
+        pthread_join(admin->thread, NULL);
+        admin->running = 0;
+    }
+
+    printf("Metrics endpoint served %lu scrapes\n", admin->scrapes);
+    close_admin_server(admin);
+}
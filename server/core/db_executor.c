@@ -0,0 +1,262 @@
+#include "server/db_executor.h"
+#include "server/metrics.h"
+#include "server/event_loop.h"
+#include "server/latency.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+// Whoever flips signaled pays for the eventfd write, later posts ride along
+static void signal_once(int* signaled, int event_fd) {
+    if (__atomic_exchange_n(signaled, 1, __ATOMIC_SEQ_CST) == 0) {
+        uint64_t one = 1;
+        if (write(event_fd, &one, sizeof(one)) != sizeof(one)) {
+            printf("[DbExecutor] Failed to signal eventfd %d\n", event_fd);
+        }
+    }
+}
+
+static void post_db_completion(DbCompletionQueue* queue, DbJob* job) {
+    mpsc_push(&queue->queue, &job->node);
+    signal_once(&queue->signaled, queue->event_fd);
+}
+
+static void run_db_job(DbExecutor* executor, DbJob* job) {
+    uint64_t started = event_loop_clock_ns();
+    switch (job->type) {
+        case DB_JOB_AUTH:
+            job->result = authenticate_user(executor->user_db, job->username, job->password);
+            latency_record(LATENCY_AUTH, event_loop_clock_ns() - started);
+            break;
+        case DB_JOB_REG:
+            job->result = create_user(executor->user_db, job->username, job->password);
+            latency_record(LATENCY_REGISTER, event_loop_clock_ns() - started);
+            break;
+        case DB_JOB_PROFILE:
+            job->result = get_user_data(executor->user_db, job->username, &job->profile);
+            break;
+        case DB_JOB_LOGIN:
+            job->result = record_login(executor->user_db, job->username);
+            break;
+        default:
+            job->result = DB_ERROR;
+            break;
+    }
+
+    // Plaintext password is no longer needed
+    memset(job->password, 0, sizeof(job->password));
+
+    metrics_inc(METRIC_DB_CALLS);
+    metrics_add(METRIC_DB_NS, (int64_t)(event_loop_clock_ns() - started));
+}
+
+static void* db_worker_thread(void* arg) {
+    DbWorker* worker = (DbWorker*)arg;
+    DbExecutor* executor = worker->executor;
+    metrics_thread_register("db-worker");
+
+    while (1) {
+        // Sleep until a submit signals; clearing signaled first makes the next submit signal again
+        uint64_t count;
+        if (read(worker->event_fd, &count, sizeof(count)) != sizeof(count) && errno != EINTR) {
+            printf("[DbExecutor] Worker eventfd %d failed\n", worker->event_fd);
+            break;
+        }
+        __atomic_exchange_n(&worker->signaled, 0, __ATOMIC_SEQ_CST);
+
+        // Stop between jobs, what is still queued is cancelled by the shutdown
+        MpscNode* node;
+        while (__atomic_load_n(&executor->status, __ATOMIC_ACQUIRE) == DB_EXECUTOR_RUNNING &&
+               (node = mpsc_pop(&worker->queue))) {
+            DbJob* job = (DbJob*)node;
+            __atomic_sub_fetch(&worker->pending, 1, __ATOMIC_RELAXED);
+            metrics_add(METRIC_DB_QUEUE, -1);
+
+            run_db_job(executor, job);
+            post_db_completion(job->completions, job);
+        }
+
+        if (__atomic_load_n(&executor->status, __ATOMIC_ACQUIRE) != DB_EXECUTOR_RUNNING) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// Wake a worker for shutdown, whether or not a wakeup is pending
+static void stop_db_worker(DbWorker* worker) {
+    uint64_t one = 1;
+    if (write(worker->event_fd, &one, sizeof(one)) != sizeof(one)) {
+        printf("[DbExecutor] Failed to wake worker on eventfd %d\n", worker->event_fd);
+    }
+    pthread_join(worker->thread, NULL);
+}
+
+DbExecutor* create_db_executor(UserDB* user_db, int num_workers) {
+    if (!user_db) return NULL;
+
+    if (num_workers <= 0) {
+        num_workers = DEFAULT_DB_WORKERS;
+    }
+
+    DbExecutor* executor = (DbExecutor*)malloc(sizeof(DbExecutor));
+    if (!executor) return NULL;
+
+    executor->workers = (DbWorker*)calloc(num_workers, sizeof(DbWorker));
+    if (!executor->workers) {
+        free(executor);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        DbWorker* worker = &executor->workers[i];
+        mpsc_init(&worker->queue);
+        worker->executor = executor;
+        // Blocking: the worker sleeps in read() on it
+        worker->event_fd = eventfd(0, EFD_CLOEXEC);
+        if (worker->event_fd < 0) {
+            printf("Failed to create DB worker eventfd\n");
+            for (int j = 0; j < i; j++) {
+                close(executor->workers[j].event_fd);
+            }
+            free(executor->workers);
+            free(executor);
+            return NULL;
+        }
+    }
+
+    executor->user_db = user_db;
+    executor->num_workers = num_workers;
+    executor->status = DB_EXECUTOR_STOPPED;
+
+    return executor;
+}
+
+int start_db_executor(DbExecutor* executor) {
+    if (!executor) return -1;
+
+    __atomic_store_n(&executor->status, DB_EXECUTOR_RUNNING, __ATOMIC_RELEASE);
+    for (int i = 0; i < executor->num_workers; i++) {
+        if (pthread_create(&executor->workers[i].thread, NULL, db_worker_thread, &executor->workers[i]) != 0) {
+            printf("Failed to create DB worker %d\n", i);
+            // Stop the workers that did start
+            __atomic_store_n(&executor->status, DB_EXECUTOR_STOPPED, __ATOMIC_RELEASE);
+            for (int j = 0; j < i; j++) {
+                stop_db_worker(&executor->workers[j]);
+            }
+            return -1;
+        }
+    }
+
+    printf("Started %d DB executor threads\n", executor->num_workers);
+    return 1;
+}
+
+int submit_db_job(DbExecutor* executor, DbJob* job) {
+    if (!executor || !job || !job->completions) return -1;
+
+    if (__atomic_load_n(&executor->status, __ATOMIC_ACQUIRE) != DB_EXECUTOR_RUNNING) {
+        return -1;
+    }
+
+    // Least loaded worker; a stale count only costs balance, never correctness
+    DbWorker* target = &executor->workers[0];
+    int lowest = __atomic_load_n(&target->pending, __ATOMIC_RELAXED);
+    for (int i = 1; i < executor->num_workers && lowest > 0; i++) {
+        int pending = __atomic_load_n(&executor->workers[i].pending, __ATOMIC_RELAXED);
+        if (pending < lowest) {
+            target = &executor->workers[i];
+            lowest = pending;
+        }
+    }
+
+    __atomic_add_fetch(&target->pending, 1, __ATOMIC_RELAXED);
+    metrics_inc(METRIC_DB_QUEUE);
+    mpsc_push(&target->queue, &job->node);
+    signal_once(&target->signaled, target->event_fd);
+
+    return 1;
+}
+
+void shut_down_db_executor(DbExecutor* executor) {
+    if (!executor) return;
+
+    int was_running = __atomic_exchange_n(&executor->status, DB_EXECUTOR_STOPPED, __ATOMIC_SEQ_CST) == DB_EXECUTOR_RUNNING;
+    if (was_running) {
+        for (int i = 0; i < executor->num_workers; i++) {
+            stop_db_worker(&executor->workers[i]);
+        }
+    }
+
+    // Hand back anything that never reached a worker, its submitter still waits for an answer
+    for (int i = 0; i < executor->num_workers; i++) {
+        DbWorker* worker = &executor->workers[i];
+        MpscNode* node;
+        while ((node = mpsc_pop(&worker->queue))) {
+            DbJob* job = (DbJob*)node;
+            metrics_add(METRIC_DB_QUEUE, -1);
+            memset(job->password, 0, sizeof(job->password));
+            job->result = DB_CANCELLED;
+            post_db_completion(job->completions, job);
+        }
+        close(worker->event_fd);
+    }
+
+    free(executor->workers);
+    free(executor);
+}
+
+int init_db_completion_queue(DbCompletionQueue* queue) {
+    if (!queue) return -1;
+
+    queue->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->event_fd < 0) {
+        printf("Failed to create DB completion eventfd\n");
+        return -1;
+    }
+
+    mpsc_init(&queue->queue);
+    queue->signaled = 0;
+    return 1;
+}
+
+void destroy_db_completion_queue(DbCompletionQueue* queue) {
+    if (!queue) return;
+
+    // Results nobody will read, their callbacks do not run
+    if (queue->event_fd >= 0) {
+        MpscNode* node;
+        while ((node = mpsc_pop(&queue->queue))) {
+            slab_free(node);
+        }
+        close(queue->event_fd);
+        queue->event_fd = -1;
+    }
+}
+
+int drain_db_completions(DbCompletionQueue* queue) {
+    if (!queue) return 0;
+
+    // Cleared before draining: a post that finds it clear afterwards wakes the loop again
+    uint64_t count;
+    while (read(queue->event_fd, &count, sizeof(count)) == sizeof(count)) {
+    }
+    __atomic_exchange_n(&queue->signaled, 0, __ATOMIC_SEQ_CST);
+
+    int completed = 0;
+    MpscNode* node;
+    while ((node = mpsc_pop(&queue->queue))) {
+        DbJob* job = (DbJob*)node;
+        if (job->on_complete) {
+            job->on_complete(job);
+        }
+        slab_free(job);
+        completed++;
+    }
+    return completed;
+}
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+#include "server/event_loop.h"
+#include "server/socket.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef struct {
+    int epoll_fd;
+} EpollBackend;
+
+static int epoll_fd_of(EventLoop* loop) {
+    return ((EpollBackend*)loop->backend)->epoll_fd;
+}
+
+static int epoll_backend_init(EventLoop* loop) {
+    EpollBackend* state = (EpollBackend*)malloc(sizeof(EpollBackend));
+    if (!state) return -1;
+
+    state->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (state->epoll_fd < 0) {
+        printf("Failed to create epoll instance for event loop %d\n", loop->index);
+        free(state);
+        return -1;
+    }
+    loop->backend = state;
+    return 1;
+}
+
+static void epoll_backend_destroy(EventLoop* loop) {
+    EpollBackend* state = (EpollBackend*)loop->backend;
+    close(state->epoll_fd);
+    free(state);
+}
+
+static int epoll_control(EventLoop* loop, EventSource* source, int op, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = source;
+    loop->egress.syscalls++;
+    return epoll_ctl(epoll_fd_of(loop), op, source->fd, &ev) < 0 ? -1 : 1;
+}
+
+static int epoll_backend_add(EventLoop* loop, EventSource* source, uint32_t events) {
+    if (epoll_control(loop, source, EPOLL_CTL_ADD, events) < 0) return -1;
+    source->io.flags |= IO_WATCHED;
+    source->io.events = events;
+    return 1;
+}
+
+static int epoll_backend_modify(EventLoop* loop, EventSource* source, uint32_t events) {
+    if (epoll_control(loop, source, EPOLL_CTL_MOD, events) < 0) return -1;
+    source->io.events = events;
+    return 1;
+}
+
+static int epoll_backend_remove(EventLoop* loop, EventSource* source) {
+    source->io.flags &= ~IO_WATCHED;
+    source->io.events = 0;
+    return epoll_control(loop, source, EPOLL_CTL_DEL, 0);
+}
+
+// Register exactly the interest the outstanding operations need; with nothing
+// outstanding the fd leaves the set, a level-triggered hangup would spin the loop
+static int sync_stream(EventLoop* loop, EventSource* source) {
+    uint32_t flags = source->io.flags;
+    uint32_t events = ((flags & (IO_RECV | IO_LISTENING)) ? EPOLLIN : 0) |
+                      ((flags & IO_SEND) ? EPOLLOUT : 0);
+    if (events == source->io.events) return 1;
+
+    int op = events == 0 ? EPOLL_CTL_DEL : (source->io.events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD);
+    if (epoll_control(loop, source, op, events) < 0) return -1;
+    source->io.events = events;
+    return 1;
+}
+
+static int epoll_backend_accept(EventLoop* loop, EventSource* source) {
+    source->io.flags |= IO_LISTENING;
+    if (sync_stream(loop, source) < 0) {
+        source->io.flags &= ~IO_LISTENING;
+        return -1;
+    }
+    return 1;
+}
+
+// Readiness only, the read happens when the kernel has data
+static int epoll_backend_recv(EventLoop* loop, EventSource* source, void* buffer, size_t length) {
+    source->io.recv_buffer = buffer;
+    source->io.recv_length = length;
+    source->io.flags |= IO_RECV;
+    if (sync_stream(loop, source) < 0) {
+        source->io.flags &= ~IO_RECV;
+        return -1;
+    }
+    return 1;
+}
+
+// MSG_NOSIGNAL: a peer that went away is an error result, not SIGPIPE
+static ssize_t send_pending(EventLoop* loop, EventSource* source) {
+    ssize_t sent;
+    do {
+        loop->egress.syscalls++;
+        sent = sendmsg(source->fd, &source->io.msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (sent < 0 && errno == EINTR);
+
+    return sent < 0 ? -errno : sent;
+}
+
+// Try right away, the socket buffer usually has room; EPOLLOUT only for what it refused
+static int epoll_backend_send(EventLoop* loop, EventSource* source, const struct iovec* iov, int iovcnt) {
+    memcpy(source->io.iov, iov, sizeof(struct iovec) * iovcnt);
+    memset(&source->io.msg, 0, sizeof(struct msghdr));
+    source->io.msg.msg_iov = source->io.iov;
+    source->io.msg.msg_iovlen = iovcnt;
+
+    ssize_t result = send_pending(loop, source);
+    if (result == -EAGAIN || result == -EWOULDBLOCK) {
+        source->io.flags |= IO_SEND;
+        if (sync_stream(loop, source) < 0) {
+            source->io.flags &= ~IO_SEND;
+            return -1;
+        }
+        return 1;
+    }
+
+    source->io.send_result = result;
+    event_loop_complete(loop, source, IO_SEND_DONE);
+    return 1;
+}
+
+// close() drops the fd from the epoll set as well (fds are never dup'ed)
+static int epoll_backend_close(EventLoop* loop, EventSource* source) {
+    loop->egress.syscalls++;
+    close(source->fd);
+    source->io.events = 0;
+    source->io.flags &= ~(IO_WATCHED | IO_LISTENING | IO_RECV | IO_SEND);
+    source->io.flags |= IO_CLOSING;
+    event_loop_complete(loop, source, IO_CLOSE_DONE);
+    return 1;
+}
+
+static int epoll_backend_release(EventLoop* loop, EventSource* source) {
+    if (source->io.events) {
+        epoll_control(loop, source, EPOLL_CTL_DEL, 0);
+        source->io.events = 0;
+    }
+    source->io.flags &= ~(IO_WATCHED | IO_LISTENING);
+    source->io.flags |= IO_CLOSING;
+    event_loop_complete(loop, source, IO_CLOSE_DONE);
+    return 1;
+}
+
+// Level-triggered: take everything in the backlog, stop at EAGAIN (or EMFILE, retried on the next wakeup)
+static void accept_ready(EventLoop* loop, EventSource* source) {
+    while (source->io.flags & IO_LISTENING) {
+        loop->egress.syscalls++;
+        int client_fd = accept4(source->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        source->on_accept(source, client_fd);
+    }
+}
+
+// Finish what the readiness event allows, a handler that closes the source ends it here
+static void dispatch_stream(EventLoop* loop, EventSource* source, uint32_t events) {
+    if (source->io.flags & IO_LISTENING) {
+        accept_ready(loop, source);
+        return;
+    }
+
+    if ((source->io.flags & IO_SEND) && (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))) {
+        ssize_t result = send_pending(loop, source);
+        if (result != -EAGAIN && result != -EWOULDBLOCK) {
+            source->io.flags &= ~IO_SEND;
+            source->on_send(source, result);
+        }
+    }
+
+    if ((source->io.flags & IO_RECV) && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        loop->egress.syscalls++;
+        ssize_t result = recv(source->fd, source->io.recv_buffer, source->io.recv_length, 0);
+        if (result < 0) {
+            result = -errno;
+        }
+        if (result != -EAGAIN && result != -EWOULDBLOCK && result != -EINTR) {
+            source->io.flags &= ~IO_RECV;
+            source->on_recv(source, result);
+        }
+    }
+
+    if (!(source->io.flags & IO_CLOSING)) {
+        sync_stream(loop, source);
+    }
+}
+
+static int epoll_backend_wait(EventLoop* loop, int timeout_ms) {
+    struct epoll_event events[MAX_EVENTS];
+
+    loop->egress.syscalls++;
+    int nfds = epoll_wait(epoll_fd_of(loop), events, MAX_EVENTS, timeout_ms);
+    event_loop_woke(loop);
+
+    if (nfds < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    // Closed sources stay allocated until the loop delivers on_close, so later events are safe to skip
+    for (int i = 0; i < nfds; i++) {
+        EventSource* source = (EventSource*)events[i].data.ptr;
+        if (source->io.flags & IO_WATCHED) {
+            source->handler(source, events[i].events);
+        } else if (!(source->io.flags & IO_CLOSING)) {
+            dispatch_stream(loop, source, events[i].events);
+        }
+    }
+    return nfds;
+}
+
+const IoBackend epoll_backend = {
+    "epoll",
+    epoll_backend_init,
+    epoll_backend_destroy,
+    epoll_backend_add,
+    epoll_backend_modify,
+    epoll_backend_remove,
+    epoll_backend_accept,
+    epoll_backend_recv,
+    epoll_backend_send,
+    epoll_backend_close,
+    epoll_backend_release,
+    epoll_backend_wait,
+};
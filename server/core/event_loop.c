@@ -0,0 +1,317 @@
+#include "server/event_loop.h"
+#include "server/socket.h"
+#include "server/metrics.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Wait no longer than the pending flush allows
+static int flush_timeout(EventLoop* loop) {
+    if (!loop->flush_list) return EPOLL_TIMEOUT;
+
+    uint64_t waited = loop->now - loop->flush_since;
+    if (waited >= (uint64_t)loop->flush_window_ms) return 0;
+    return (int)((uint64_t)loop->flush_window_ms - waited);
+}
+
+// Handlers may queue again while flushing (e.g. resumed input), those wait for the next pass
+static void run_flushes(EventLoop* loop) {
+    FlushNode* node = loop->flush_list;
+    loop->flush_list = NULL;
+
+    while (node) {
+        FlushNode* next = node->next;
+        node->next = NULL;
+        node->queued = 0;
+        node->handler(node);
+        node = next;
+    }
+}
+
+// Send results and closes the backend finished inside a handler, delivered once it returned
+static void run_completions(EventLoop* loop) {
+    EventSource* source = loop->completed;
+    loop->completed = NULL;
+
+    while (source) {
+        EventSource* next = source->io.next;
+        uint32_t done = source->io.flags & (IO_SEND_DONE | IO_CLOSE_DONE);
+        source->io.next = NULL;
+        source->io.flags &= ~(IO_SEND_DONE | IO_CLOSE_DONE | IO_QUEUED);
+
+        // A close supersedes the send result, on_close may free the source
+        if (done & IO_CLOSE_DONE) {
+            if (source->on_close) source->on_close(source, 0);
+        } else if (done & IO_SEND_DONE) {
+            source->on_send(source, source->io.send_result);
+        }
+        source = next;
+    }
+}
+
+void event_loop_complete(EventLoop* loop, EventSource* source, uint32_t done) {
+    source->io.flags |= done;
+    if (source->io.flags & IO_QUEUED) return;
+
+    source->io.flags |= IO_QUEUED;
+    source->io.next = loop->completed;
+    loop->completed = source;
+}
+
+void event_loop_woke(EventLoop* loop) {
+    loop->now = event_loop_clock_ms();
+    loop->woke_at = event_loop_clock_ns();
+    metrics_add(METRIC_LOOP_IDLE_NS, (int64_t)(loop->woke_at - loop->slept_at));
+}
+
+void* event_loop_run(void* arg) {
+    EventLoop* loop = (EventLoop*)arg;
+
+    // Router reactors name their thread before entering the loop
+    char name[METRICS_NAME_LENGTH];
+    snprintf(name, sizeof(name), "loop-%d", loop->index);
+    metrics_thread_register(name);
+
+    loop->woke_at = event_loop_clock_ns();
+    while (loop->status == EVENT_LOOP_RUNNING) {
+        int timeout = loop->completed ? 0 : flush_timeout(loop);
+        loop->slept_at = event_loop_clock_ns();
+        metrics_add(METRIC_LOOP_BUSY_NS, (int64_t)(loop->slept_at - loop->woke_at));
+        if (loop->io->wait(loop, timeout) < 0) {
+            loop->status = EVENT_LOOP_ERROR;
+            break;
+        }
+
+        if (loop->flush_list && loop->now - loop->flush_since >= (uint64_t)loop->flush_window_ms) {
+            run_flushes(loop);
+        }
+        run_completions(loop);
+
+        timer_wheel_advance(&loop->timers, loop->now);
+    }
+
+    return NULL;
+}
+
+int event_loop_init(EventLoop* loop, int index, const IoBackend* io, int flush_window_ms) {
+    loop->index = index;
+    loop->status = EVENT_LOOP_STOPPED;
+    loop->now = event_loop_clock_ms();
+    timer_wheel_init(&loop->timers, loop->now);
+    loop->flush_window_ms = flush_window_ms > 0 ? flush_window_ms : 0;
+    loop->io = io ? io : &epoll_backend;
+
+    if (loop->io->init(loop) < 0) {
+        if (loop->io == &epoll_backend) return -1;
+        printf("Event loop %d: %s unavailable, falling back to epoll\n", index, loop->io->name);
+        loop->io = &epoll_backend;
+        if (loop->io->init(loop) < 0) return -1;
+    }
+    return 1;
+}
+
+void event_loop_destroy(EventLoop* loop) {
+    if (loop->io && loop->backend) {
+        loop->io->destroy(loop);
+    }
+    loop->backend = NULL;
+}
+
+void event_loop_report(const EventLoop* loop, const char* name) {
+    const EgressStats* egress = &loop->egress;
+    if (egress->writes == 0) return;
+
+    printf("%s %d (%s) sent %llu frames (%llu bytes) in %llu writes, %.2f frames per write, %.3f I/O syscalls per frame\n",
+           name, loop->index, loop->io->name, (unsigned long long)egress->frames,
+           (unsigned long long)egress->bytes, (unsigned long long)egress->writes,
+           (double)egress->frames / egress->writes,
+           egress->frames ? (double)egress->syscalls / egress->frames : 0.0);
+}
+
+EventLoopPool* create_event_loop_pool(int num_loops, const IoBackend* io, int flush_window_ms) {
+    if (num_loops <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_loops = cores > 0 ? (int)cores : 1;
+    }
+
+    EventLoopPool* pool = (EventLoopPool*)malloc(sizeof(EventLoopPool));
+    if (!pool) return NULL;
+
+    pool->loops = (EventLoop*)calloc(num_loops, sizeof(EventLoop));
+    if (!pool->loops) {
+        free(pool);
+        return NULL;
+    }
+    pool->num_loops = num_loops;
+
+    for (int i = 0; i < num_loops; i++) {
+        if (event_loop_init(&pool->loops[i], i, io, flush_window_ms) < 0) {
+            printf("Failed to set up I/O for event loop %d\n", i);
+            for (int j = 0; j < i; j++) {
+                event_loop_destroy(&pool->loops[j]);
+            }
+            free(pool->loops);
+            free(pool);
+            return NULL;
+        }
+    }
+
+    printf("Created %d event loops (%s)\n", num_loops, pool->loops[0].io->name);
+    return pool;
+}
+
+int start_event_loop_pool(EventLoopPool* pool) {
+    if (!pool) return -1;
+
+    for (int i = 0; i < pool->num_loops; i++) {
+        EventLoop* loop = &pool->loops[i];
+        loop->status = EVENT_LOOP_RUNNING;
+        if (pthread_create(&loop->thread, NULL, event_loop_run, loop) != 0) {
+            printf("Failed to create event loop thread %d\n", i);
+            loop->status = EVENT_LOOP_ERROR;
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+void stop_event_loop_pool(EventLoopPool* pool) {
+    if (!pool) return;
+
+    for (int i = 0; i < pool->num_loops; i++) {
+        if (pool->loops[i].status == EVENT_LOOP_RUNNING) {
+            pool->loops[i].status = EVENT_LOOP_STOPPED;
+        }
+    }
+
+    for (int i = 0; i < pool->num_loops; i++) {
+        if (pool->loops[i].thread) {
+            pthread_join(pool->loops[i].thread, NULL);
+            pool->loops[i].thread = 0;
+        }
+    }
+
+    for (int i = 0; i < pool->num_loops; i++) {
+        event_loop_report(&pool->loops[i], "Event loop");
+    }
+}
+
+void destroy_event_loop_pool(EventLoopPool* pool) {
+    if (!pool) return;
+
+    for (int i = 0; i < pool->num_loops; i++) {
+        event_loop_destroy(&pool->loops[i]);
+    }
+
+    free(pool->loops);
+    free(pool);
+}
+
+EventLoop* event_loop_pool_attach(EventLoopPool* pool) {
+    if (!pool || pool->num_loops == 0) return NULL;
+
+    EventLoop* best = &pool->loops[0];
+    for (int i = 1; i < pool->num_loops; i++) {
+        if (pool->loops[i].num_sockets < best->num_sockets) {
+            best = &pool->loops[i];
+        }
+    }
+
+    best->num_sockets++;
+    return best;
+}
+
+void event_source_init(EventSource* source, int fd, EventHandler handler, void* owner) {
+    memset(source, 0, sizeof(EventSource));
+    source->fd = fd;
+    source->handler = handler;
+    source->owner = owner;
+}
+
+int event_loop_add(EventLoop* loop, EventSource* source, uint32_t events) {
+    return loop->io->add(loop, source, events);
+}
+
+int event_loop_modify(EventLoop* loop, EventSource* source, uint32_t events) {
+    return loop->io->modify(loop, source, events);
+}
+
+int event_loop_remove(EventLoop* loop, EventSource* source) {
+    return loop->io->remove(loop, source);
+}
+
+int event_loop_accept(EventLoop* loop, EventSource* source) {
+    return loop->io->accept(loop, source);
+}
+
+int event_loop_recv(EventLoop* loop, EventSource* source, void* buffer, size_t length) {
+    if (source->io.flags & (IO_RECV | IO_CLOSING)) return -1;
+    return loop->io->recv(loop, source, buffer, length);
+}
+
+int event_loop_send(EventLoop* loop, EventSource* source, const struct iovec* iov, int iovcnt) {
+    if (iovcnt < 1 || iovcnt > IO_MAX_IOV) return -1;
+    if (source->io.flags & (IO_SEND | IO_SEND_DONE | IO_CLOSING)) return -1;
+    return loop->io->send(loop, source, iov, iovcnt);
+}
+
+int event_loop_close(EventLoop* loop, EventSource* source) {
+    if (source->io.flags & IO_CLOSING) return -1;
+    return loop->io->close(loop, source);
+}
+
+int event_loop_release(EventLoop* loop, EventSource* source) {
+    if (source->io.flags & (IO_RECV | IO_SEND | IO_SEND_DONE | IO_CLOSING)) return -1;
+    return loop->io->release(loop, source);
+}
+
+const IoBackend* io_backend_by_id(int id) {
+    switch (id) {
+    case IO_BACKEND_EPOLL:    return &epoll_backend;
+    case IO_BACKEND_IO_URING: return &io_uring_backend;
+    default:                  return NULL;
+    }
+}
+
+const IoBackend* io_backend_by_name(const char* name) {
+    if (!name) return NULL;
+    if (strcmp(name, epoll_backend.name) == 0) return &epoll_backend;
+    if (strcmp(name, io_uring_backend.name) == 0 || strcmp(name, "uring") == 0) return &io_uring_backend;
+    return NULL;
+}
+
+uint64_t event_loop_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+uint64_t event_loop_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void event_loop_schedule(EventLoop* loop, TimerNode* timer, uint64_t delay_ms) {
+    timer_wheel_schedule(&loop->timers, timer, loop->now + delay_ms);
+}
+
+void event_loop_flush_init(FlushNode* node, FlushHandler handler, void* owner) {
+    node->next = NULL;
+    node->handler = handler;
+    node->owner = owner;
+    node->queued = 0;
+}
+
+void event_loop_defer_flush(EventLoop* loop, FlushNode* node) {
+    if (node->queued) return;
+
+    if (!loop->flush_list) {
+        loop->flush_since = loop->now;
+    }
+    node->next = loop->flush_list;
+    node->queued = 1;
+    loop->flush_list = node;
+}
@@ -0,0 +1,573 @@
+#define _GNU_SOURCE
+#include "server/event_loop.h"
+#include "server/socket.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// Operation kind in the low bits of user_data, above it the registration slot and its generation
+#define URING_OP_POLL   1
+#define URING_OP_ACCEPT 2
+#define URING_OP_RECV   3
+#define URING_OP_SEND   4
+#define URING_OP_CANCEL 5   // Cancellations and poll removals, result ignored
+#define URING_OP_BITS   3
+#define URING_OP_MASK   ((1u << URING_OP_BITS) - 1)
+
+/*
+ * Sources are found through a slot table instead of a pointer in user_data:
+ * a completion that arrives after its source was released or reused carries an
+ * old generation and is dropped
+ */
+typedef struct {
+    EventSource* source;    // NULL while free
+    uint32_t generation;
+    int next_free;
+} UringSlot;
+
+typedef struct {
+    int ring_fd;
+    unsigned sq_entries;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;          // Same mapping as sq_ring with IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size;
+    size_t sqes_size;
+    int multishot;          // Cleared when the kernel rejects multishot poll/accept (before 5.19)
+    int inflight;           // Receives and sends not completed yet, across all sources
+    UringSlot* slots;       // Slot 0 is never used, io.id 0 means unregistered
+    int num_slots;
+    int free_slot;          // 0 when the table is full
+} UringBackend;
+
+static int uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                       void* arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static void uring_unmap(UringBackend* ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+}
+
+static int uring_map(UringBackend* ring, const struct io_uring_params* params) {
+    ring->sq_ring_size = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) return -1;
+
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) return -1;
+    }
+
+    ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) return -1;
+
+    uint8_t* sq = (uint8_t*)ring->sq_ring;
+    uint8_t* cq = (uint8_t*)ring->cq_ring;
+    ring->sq_entries = params->sq_entries;
+    ring->sq_head = (unsigned*)(sq + params->sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params->sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + params->sq_off.ring_mask);
+    ring->cq_head = (unsigned*)(cq + params->cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params->cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + params->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params->cq_off.cqes);
+
+    // Entry i of the submission array always names sqe i, so it is filled once
+    unsigned* array = (unsigned*)(sq + params->sq_off.array);
+    for (unsigned i = 0; i < params->sq_entries; i++) {
+        array[i] = i;
+    }
+    return 1;
+}
+
+static int uring_init(EventLoop* loop) {
+    UringBackend* ring = (UringBackend*)calloc(1, sizeof(UringBackend));
+    if (!ring) return -1;
+
+    // Kernels before 5.19 refuse COOP_TASKRUN, retry without it
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = IO_URING_ENTRIES * IO_URING_CQ_FACTOR;
+    ring->ring_fd = uring_setup(IO_URING_ENTRIES, &params);
+    if (ring->ring_fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = IO_URING_ENTRIES * IO_URING_CQ_FACTOR;
+        ring->ring_fd = uring_setup(IO_URING_ENTRIES, &params);
+    }
+    if (ring->ring_fd < 0) {
+        printf("io_uring_setup failed for event loop %d: %s\n", loop->index, strerror(errno));
+        free(ring);
+        return -1;
+    }
+
+    // Timed waits need EXT_ARG (5.11), a full completion queue must not drop results
+    uint32_t required = IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+    if ((params.features & required) != required || uring_map(ring, &params) < 0) {
+        printf("io_uring on event loop %d lacks required features\n", loop->index);
+        uring_unmap(ring);
+        close(ring->ring_fd);
+        free(ring);
+        return -1;
+    }
+
+    ring->multishot = 1;
+    ring->num_slots = 64;
+    ring->slots = (UringSlot*)calloc(ring->num_slots, sizeof(UringSlot));
+    if (!ring->slots) {
+        uring_unmap(ring);
+        close(ring->ring_fd);
+        free(ring);
+        return -1;
+    }
+    for (int i = 1; i < ring->num_slots; i++) {
+        ring->slots[i].next_free = i + 1 < ring->num_slots ? i + 1 : 0;
+    }
+    ring->free_slot = 1;
+
+    loop->backend = ring;
+    return 1;
+}
+
+static struct io_uring_sqe* uring_get_sqe(EventLoop* loop);
+
+/*
+ * Receives still in flight would write into pool blocks the sockets are about
+ * to give back: cancel everything and wait for those completions (bounded)
+ */
+static void uring_drain(EventLoop* loop) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    if (ring->inflight == 0) return;
+
+    struct io_uring_sqe* sqe = uring_get_sqe(loop);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = URING_OP_CANCEL;
+
+    struct __kernel_timespec timeout = { 0, 100 * 1000000LL };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&timeout;
+
+    for (int waits = 0; ring->inflight > 0 && waits < 10; waits++) {
+        unsigned pending = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        uring_enter(ring->ring_fd, pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            unsigned op = (unsigned)(ring->cqes[head & ring->cq_mask].user_data & URING_OP_MASK);
+            if (op == URING_OP_RECV || op == URING_OP_SEND) {
+                ring->inflight--;
+            }
+            head++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+static void uring_destroy(EventLoop* loop) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    uring_drain(loop);
+    uring_unmap(ring);
+    close(ring->ring_fd);
+    free(ring->slots);
+    free(ring);
+}
+
+// Give the kernel everything queued so far, without waiting
+static int uring_submit(EventLoop* loop) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+
+    unsigned pending;
+    while ((pending = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) > 0) {
+        loop->egress.syscalls++;
+        if (uring_enter(ring->ring_fd, pending, 0, 0, NULL, 0) < 0 && errno != EINTR) {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Next free submission entry, zeroed
+ * The kernel only reads entries inside io_uring_enter (no SQPOLL), so the tail
+ * can move before the caller fills the entry in
+ */
+static struct io_uring_sqe* uring_get_sqe(EventLoop* loop) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    unsigned tail = *ring->sq_tail;
+
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        // More operations in one iteration than the queue holds, submit early
+        if (uring_submit(loop) < 0) return NULL;
+    }
+
+    struct io_uring_sqe* sqe = &ring->sqes[tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+static int uring_register(UringBackend* ring, EventSource* source) {
+    if (source->io.id) return 1;
+
+    if (ring->free_slot == 0) {
+        int grown = ring->num_slots * 2;
+        UringSlot* slots = (UringSlot*)realloc(ring->slots, sizeof(UringSlot) * grown);
+        if (!slots) return -1;
+        memset(slots + ring->num_slots, 0, sizeof(UringSlot) * (grown - ring->num_slots));
+        for (int i = ring->num_slots; i < grown; i++) {
+            slots[i].next_free = i + 1 < grown ? i + 1 : 0;
+        }
+        ring->free_slot = ring->num_slots;
+        ring->slots = slots;
+        ring->num_slots = grown;
+    }
+
+    int id = ring->free_slot;
+    ring->free_slot = ring->slots[id].next_free;
+    ring->slots[id].source = source;
+    source->io.id = id;
+    return 1;
+}
+
+static void uring_unregister(UringBackend* ring, EventSource* source) {
+    int id = source->io.id;
+    if (!id) return;
+
+    ring->slots[id].source = NULL;
+    ring->slots[id].generation++;
+    ring->slots[id].next_free = ring->free_slot;
+    ring->free_slot = id;
+    source->io.id = 0;
+}
+
+static uint64_t uring_user_data(UringBackend* ring, EventSource* source, unsigned op) {
+    int id = source->io.id;
+    return ((uint64_t)ring->slots[id].generation << 32) | ((uint64_t)id << URING_OP_BITS) | op;
+}
+
+// Cancel one operation of the source by its user_data
+static void uring_cancel(EventLoop* loop, EventSource* source, unsigned op) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    struct io_uring_sqe* sqe = uring_get_sqe(loop);
+    if (!sqe) return;
+
+    sqe->opcode = op == URING_OP_POLL ? IORING_OP_POLL_REMOVE : IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = uring_user_data(ring, source, op);
+    sqe->user_data = URING_OP_CANCEL;
+}
+
+static int uring_arm_poll(EventLoop* loop, EventSource* source) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    struct io_uring_sqe* sqe = uring_get_sqe(loop);
+    if (!sqe) return -1;
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = source->fd;
+    sqe->poll32_events = source->io.events;
+    sqe->len = ring->multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = uring_user_data(ring, source, URING_OP_POLL);
+    return 1;
+}
+
+static int uring_arm_accept(EventLoop* loop, EventSource* source) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    struct io_uring_sqe* sqe = uring_get_sqe(loop);
+    if (!sqe) return -1;
+
+    // One multishot accept posts a completion per connection until cancelled
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = source->fd;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio = ring->multishot ? IORING_ACCEPT_MULTISHOT : 0;
+    sqe->user_data = uring_user_data(ring, source, URING_OP_ACCEPT);
+    return 1;
+}
+
+static int uring_add(EventLoop* loop, EventSource* source, uint32_t events) {
+    if (uring_register((UringBackend*)loop->backend, source) < 0) return -1;
+
+    source->io.events = events;
+    if (uring_arm_poll(loop, source) < 0) {
+        uring_unregister((UringBackend*)loop->backend, source);
+        return -1;
+    }
+    source->io.flags |= IO_WATCHED;
+    return 1;
+}
+
+// The old poll's completions carry the previous generation and are ignored
+static int uring_modify(EventLoop* loop, EventSource* source, uint32_t events) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    if (!source->io.id) return -1;
+
+    uring_cancel(loop, source, URING_OP_POLL);
+    ring->slots[source->io.id].generation++;
+    source->io.events = events;
+    return uring_arm_poll(loop, source);
+}
+
+static int uring_remove(EventLoop* loop, EventSource* source) {
+    if (!source->io.id) return -1;
+
+    uring_cancel(loop, source, URING_OP_POLL);
+    uring_unregister((UringBackend*)loop->backend, source);
+    source->io.flags &= ~IO_WATCHED;
+    source->io.events = 0;
+    return 1;
+}
+
+static int uring_accept(EventLoop* loop, EventSource* source) {
+    if (uring_register((UringBackend*)loop->backend, source) < 0) return -1;
+    if (uring_arm_accept(loop, source) < 0) return -1;
+    source->io.flags |= IO_LISTENING;
+    return 1;
+}
+
+// Straight into the caller's buffer (the connection's pool block)
+static int uring_recv(EventLoop* loop, EventSource* source, void* buffer, size_t length) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    if (uring_register(ring, source) < 0) return -1;
+
+    struct io_uring_sqe* sqe = uring_get_sqe(loop);
+    if (!sqe) return -1;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = source->fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = (uint32_t)length;
+    sqe->user_data = uring_user_data(ring, source, URING_OP_RECV);
+
+    source->io.flags |= IO_RECV;
+    source->io.inflight++;
+    ring->inflight++;
+    return 1;
+}
+
+static int uring_send(EventLoop* loop, EventSource* source, const struct iovec* iov, int iovcnt) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    if (uring_register(ring, source) < 0) return -1;
+
+    struct io_uring_sqe* sqe = uring_get_sqe(loop);
+    if (!sqe) return -1;
+
+    // The msghdr and iovecs are read when the request is issued, keep them with the source
+    memcpy(source->io.iov, iov, sizeof(struct iovec) * iovcnt);
+    memset(&source->io.msg, 0, sizeof(struct msghdr));
+    source->io.msg.msg_iov = source->io.iov;
+    source->io.msg.msg_iovlen = iovcnt;
+
+    sqe->fd = source->fd;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    if (iovcnt == 1) {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = (uint64_t)(uintptr_t)iov[0].iov_base;
+        sqe->len = (uint32_t)iov[0].iov_len;
+    } else {
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (uint64_t)(uintptr_t)&source->io.msg;
+        sqe->len = 1;
+    }
+    sqe->user_data = uring_user_data(ring, source, URING_OP_SEND);
+
+    source->io.flags |= IO_SEND;
+    source->io.inflight++;
+    ring->inflight++;
+    return 1;
+}
+
+// Nothing in flight references the source any more, hand it back to its owner
+static void uring_finish_close(EventLoop* loop, EventSource* source) {
+    uring_unregister((UringBackend*)loop->backend, source);
+    event_loop_complete(loop, source, IO_CLOSE_DONE);
+}
+
+// Stop polling / accepting, a registration with outstanding recv or send stays until they complete
+static void uring_stop_source(EventLoop* loop, EventSource* source) {
+    if (!source->io.id) return;
+
+    if (source->io.flags & IO_WATCHED) uring_cancel(loop, source, URING_OP_POLL);
+    if (source->io.flags & IO_LISTENING) uring_cancel(loop, source, URING_OP_ACCEPT);
+    if (source->io.flags & IO_RECV) uring_cancel(loop, source, URING_OP_RECV);
+    if (source->io.flags & IO_SEND) uring_cancel(loop, source, URING_OP_SEND);
+    source->io.flags &= ~(IO_WATCHED | IO_LISTENING);
+    source->io.flags |= IO_CLOSING;
+}
+
+// Outstanding operations hold their own file reference and finish with -ECANCELED
+static int uring_close(EventLoop* loop, EventSource* source) {
+    uring_stop_source(loop, source);
+    source->io.flags |= IO_CLOSING;
+
+    loop->egress.syscalls++;
+    close(source->fd);
+
+    if (source->io.inflight == 0) {
+        uring_finish_close(loop, source);
+    }
+    return 1;
+}
+
+static int uring_release(EventLoop* loop, EventSource* source) {
+    uring_stop_source(loop, source);
+    source->io.flags |= IO_CLOSING;
+    uring_finish_close(loop, source);
+    return 1;
+}
+
+static void uring_dispatch(EventLoop* loop, uint64_t user_data, int32_t result, uint32_t cqe_flags) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+    unsigned op = (unsigned)(user_data & URING_OP_MASK);
+    int id = (int)((user_data >> URING_OP_BITS) & 0x1fffffff);
+    uint32_t generation = (uint32_t)(user_data >> 32);
+
+    if (op == URING_OP_RECV || op == URING_OP_SEND) {
+        ring->inflight--;
+    }
+    if (op == URING_OP_CANCEL || id <= 0 || id >= ring->num_slots) return;
+    EventSource* source = ring->slots[id].source;
+    if (!source || ring->slots[id].generation != generation) return;
+
+    // Multishot requests end with a completion without F_MORE, re-arm if still wanted;
+    // the handler may release the source, so its slot is checked again afterwards
+    int more = (cqe_flags & IORING_CQE_F_MORE) != 0;
+    switch (op) {
+    case URING_OP_POLL:
+        if (result == -EINVAL && ring->multishot) {
+            ring->multishot = 0;
+        } else if (result > 0) {
+            source->handler(source, (uint32_t)result);
+        }
+        if (!more && ring->slots[id].source == source && ring->slots[id].generation == generation &&
+            (source->io.flags & IO_WATCHED)) {
+            uring_arm_poll(loop, source);
+        }
+        break;
+
+    case URING_OP_ACCEPT:
+        if (result == -EINVAL && ring->multishot) {
+            ring->multishot = 0;
+        } else if (result >= 0) {
+            source->on_accept(source, result);
+        }
+        if (!more && ring->slots[id].source == source && ring->slots[id].generation == generation &&
+            (source->io.flags & IO_LISTENING)) {
+            uring_arm_accept(loop, source);
+        }
+        break;
+
+    case URING_OP_RECV:
+    case URING_OP_SEND:
+        source->io.inflight--;
+        source->io.flags &= ~(op == URING_OP_RECV ? IO_RECV : IO_SEND);
+        if (source->io.flags & IO_CLOSING) {
+            if (source->io.inflight == 0) {
+                uring_finish_close(loop, source);
+            }
+        } else if (op == URING_OP_RECV) {
+            source->on_recv(source, result);
+        } else {
+            source->on_send(source, result);
+        }
+        break;
+    }
+}
+
+/*
+ * One io_uring_enter submits every operation queued since the last wait
+ * (sends from the flush, re-armed receives) and collects completions
+ */
+static int uring_wait(EventLoop* loop, int timeout_ms) {
+    UringBackend* ring = (UringBackend*)loop->backend;
+
+    unsigned pending = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned ready = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) - *ring->cq_head;
+    unsigned wait_for = (timeout_ms > 0 && ready == 0) ? 1 : 0;
+
+    if (pending > 0 || wait_for > 0) {
+        struct __kernel_timespec timeout;
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&timeout;
+
+        loop->egress.syscalls++;
+        if (uring_enter(ring->ring_fd, pending, wait_for, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                        &arg, sizeof(arg)) < 0 &&
+            errno != EINTR && errno != ETIME && errno != EAGAIN && errno != EBUSY) {
+            return -1;
+        }
+    }
+    event_loop_woke(loop);
+
+    // Release each entry before dispatching it, handlers queue new submissions meanwhile
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    int count = 0;
+    while (head != tail) {
+        struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+        uint64_t user_data = cqe->user_data;
+        int32_t result = cqe->res;
+        uint32_t cqe_flags = cqe->flags;
+
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        uring_dispatch(loop, user_data, result, cqe_flags);
+        count++;
+    }
+    return count;
+}
+
+const IoBackend io_uring_backend = {
+    "io_uring",
+    uring_init,
+    uring_destroy,
+    uring_add,
+    uring_modify,
+    uring_remove,
+    uring_accept,
+    uring_recv,
+    uring_send,
+    uring_close,
+    uring_release,
+    uring_wait,
+};
@@ -0,0 +1,100 @@
+#include "server/latency.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Filled in as threads record, never freed: readers may hold a block at any time
+static LatencyBlock* blocks[LATENCY_MAX_THREADS];
+static int next_block = 0;
+static LatencyBlock overflow_block = { .shared = 1 };
+
+__thread LatencyBlock* latency_thread_block = NULL;
+
+static const struct {
+    const char* name;
+    const char* help;
+} latency_info[LATENCY_COUNT] = {
+    [LATENCY_AUTH] = { "auth", "authenticate_user, bcrypt included" },
+    [LATENCY_REGISTER] = { "register", "create_user" },
+    [LATENCY_LAST_LOGIN] = { "last_login", "Login writer transaction, one per batch of login updates" },
+    [LATENCY_SESSION] = { "session", "User socket connection until its session key claimed a slot" },
+    [LATENCY_MESSAGE] = { "message", "SEND received until the MESSAGE is queued for the recipient" },
+};
+
+LatencyBlock* latency_attach(void) {
+    if (latency_thread_block) return latency_thread_block;
+
+    int index = __atomic_fetch_add(&next_block, 1, __ATOMIC_RELAXED);
+    if (index >= LATENCY_MAX_THREADS) {
+        latency_thread_block = &overflow_block;
+        return latency_thread_block;
+    }
+
+    LatencyBlock* block = (LatencyBlock*)aligned_alloc(64, sizeof(LatencyBlock));
+    if (!block) return NULL;
+    memset(block, 0, sizeof(LatencyBlock));
+    __atomic_store_n(&blocks[index], block, __ATOMIC_RELEASE);
+    latency_thread_block = block;
+    return block;
+}
+
+void latency_collect(LatencySnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(LatencySnapshot));
+
+    int used = __atomic_load_n(&next_block, __ATOMIC_RELAXED);
+    if (used > LATENCY_MAX_THREADS) used = LATENCY_MAX_THREADS;
+
+    // A slot claimed but not yet published is skipped, it has no samples yet
+    for (int i = 0; i < used; i++) {
+        LatencyBlock* block = __atomic_load_n(&blocks[i], __ATOMIC_ACQUIRE);
+        if (!block) continue;
+        for (int id = 0; id < LATENCY_COUNT; id++) {
+            histogram_merge(&snapshot->histograms[id], &block->histograms[id]);
+        }
+    }
+    for (int id = 0; id < LATENCY_COUNT; id++) {
+        histogram_merge(&snapshot->histograms[id], &overflow_block.histograms[id]);
+    }
+}
+
+void latency_interval(LatencyInterval* interval, LatencySnapshot* snapshot) {
+    LatencySnapshot* now = (LatencySnapshot*)malloc(sizeof(LatencySnapshot));
+    if (!now) {
+        memset(snapshot, 0, sizeof(LatencySnapshot));
+        return;
+    }
+
+    latency_collect(now);
+    for (int id = 0; id < LATENCY_COUNT; id++) {
+        histogram_delta(&snapshot->histograms[id], &now->histograms[id], &interval->previous.histograms[id]);
+    }
+    memcpy(&interval->previous, now, sizeof(LatencySnapshot));
+    free(now);
+}
+
+const char* latency_name(LatencyId id) {
+    return id >= 0 && id < LATENCY_COUNT ? latency_info[id].name : "unknown";
+}
+
+const char* latency_help(LatencyId id) {
+    return id >= 0 && id < LATENCY_COUNT ? latency_info[id].help : "";
+}
+
+void latency_report(void) {
+    LatencySnapshot* snapshot = (LatencySnapshot*)malloc(sizeof(LatencySnapshot));
+    if (!snapshot) return;
+
+    latency_collect(snapshot);
+    for (int id = 0; id < LATENCY_COUNT; id++) {
+        const Histogram* histogram = &snapshot->histograms[id];
+        if (histogram->count == 0) continue;
+
+        printf("Latency %s: %llu samples, mean %.3f ms, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n",
+               latency_info[id].name, (unsigned long long)histogram->count,
+               (double)histogram->sum / histogram->count / 1e6,
+               histogram_percentile(histogram, 50) / 1e6, histogram_percentile(histogram, 90) / 1e6,
+               histogram_percentile(histogram, 99) / 1e6, histogram_percentile(histogram, 99.9) / 1e6,
+               histogram_max(histogram) / 1e6);
+    }
+    free(snapshot);
+}
@@ -0,0 +1,113 @@
+#include "server/metrics.h"
+#include <stdio.h>
+#include <string.h>
+
+// Last block is shared by threads past METRICS_MAX_THREADS
+static MetricsBlock blocks[METRICS_MAX_THREADS + 1] = {
+    [METRICS_MAX_THREADS] = { .name = "overflow", .shared = 1 },
+};
+static int next_block = 0;
+
+__thread MetricsBlock* metrics_thread_block = NULL;
+
+static const struct {
+    const char* name;
+    const char* help;
+} metric_info[METRIC_COUNT] = {
+    [METRIC_BYTES_RECEIVED] = { "bytes_received", "Bytes received from user socket clients" },
+    [METRIC_BYTES_SENT] = { "bytes_sent", "Bytes sent to user socket clients" },
+    [METRIC_FRAMES_RECEIVED] = { "frames_received", "Frames received from user socket clients" },
+    [METRIC_FRAMES_SENT] = { "frames_sent", "Frames queued for user socket clients" },
+    [METRIC_ROUTER_ACCEPTS] = { "router_accepts", "Connections accepted on the router port" },
+    [METRIC_SOCKET_CONNECTS] = { "socket_connects", "Clients bound to their reserved slot" },
+    [METRIC_SESSION_REJECTS] = { "session_rejects", "Connections with an unknown or used session key" },
+    [METRIC_AUTH_SUCCESS] = { "auth_success", "Successful AUTH requests" },
+    [METRIC_AUTH_FAILURE] = { "auth_failure", "Failed AUTH requests" },
+    [METRIC_REGISTER_SUCCESS] = { "register_success", "Successful REG requests" },
+    [METRIC_REGISTER_FAILURE] = { "register_failure", "Failed REG requests" },
+    [METRIC_EVICT_IDLE] = { "evict_idle", "Clients evicted after CONNECTION_TIMEOUT" },
+    [METRIC_EVICT_RESERVATION] = { "evict_reservation", "Reservations expired after SESSION_RESERVE_TIMEOUT" },
+    [METRIC_EVICT_HANDSHAKE] = { "evict_handshake", "Connections closed after HANDSHAKE_TIMEOUT" },
+    [METRIC_MESSAGES_DELIVERED] = { "messages_delivered", "User messages queued for their recipient" },
+    [METRIC_MESSAGES_DROPPED] = { "messages_dropped", "User messages that could not be delivered" },
+    [METRIC_ROOM_PUBLISHES] = { "room_publishes", "Frames published to rooms" },
+    [METRIC_ROOM_DROPS] = { "room_drops", "Room frames a member missed" },
+    [METRIC_LOOP_BUSY_NS] = { "loop_busy_ns", "Event loop time spent handling events" },
+    [METRIC_LOOP_IDLE_NS] = { "loop_idle_ns", "Event loop time spent waiting" },
+    [METRIC_DB_CALLS] = { "db_calls", "DB executor jobs run against the database" },
+    [METRIC_DB_NS] = { "db_ns", "Time spent in DB executor jobs" },
+    [METRIC_LOGIN_WRITES] = { "login_writes", "Login updates written by the login writer" },
+    [METRIC_CONNECTIONS] = { "connections", "Clients connected to user sockets" },
+    [METRIC_DB_QUEUE] = { "db_queue", "DB executor jobs waiting for a worker" },
+    [METRIC_COMMAND_QUEUE] = { "command_queue", "Socket commands waiting for their loop" },
+    [METRIC_MAILBOX_QUEUE] = { "mailbox_queue", "User messages and room posts waiting for their loop" },
+    [METRIC_OUTPUT_QUEUE] = { "output_queue_bytes", "Bytes queued on client outputs" },
+    [METRIC_LOGIN_QUEUE] = { "login_queue", "Login updates waiting for the login writer" },
+};
+
+MetricsBlock* metrics_attach(void) {
+    if (!metrics_thread_block) {
+        int index = __atomic_fetch_add(&next_block, 1, __ATOMIC_RELAXED);
+        metrics_thread_block = &blocks[index < METRICS_MAX_THREADS ? index : METRICS_MAX_THREADS];
+    }
+    return metrics_thread_block;
+}
+
+void metrics_thread_register(const char* name) {
+    MetricsBlock* block = metrics_attach();
+    if (!block->shared && block->name[0] == '\0') {
+        strncpy(block->name, name, METRICS_NAME_LENGTH - 1);
+    }
+}
+
+void metrics_collect(MetricsSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(MetricsSnapshot));
+
+    int used = __atomic_load_n(&next_block, __ATOMIC_RELAXED);
+    if (used > METRICS_MAX_THREADS) used = METRICS_MAX_THREADS;
+
+    for (int i = 0; i < used; i++) {
+        for (int id = 0; id < METRIC_COUNT; id++) {
+            snapshot->values[id] += __atomic_load_n(&blocks[i].values[id], __ATOMIC_RELAXED);
+        }
+    }
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        snapshot->values[id] += __atomic_load_n(&blocks[METRICS_MAX_THREADS].values[id], __ATOMIC_RELAXED);
+    }
+}
+
+int metrics_thread_collect(int index, char name[METRICS_NAME_LENGTH], MetricsSnapshot* snapshot) {
+    int used = __atomic_load_n(&next_block, __ATOMIC_RELAXED);
+    if (used > METRICS_MAX_THREADS) used = METRICS_MAX_THREADS;
+    if (index < 0 || index > used) return -1;
+
+    // Past the claimed blocks comes the overflow block
+    const MetricsBlock* block = &blocks[index < used ? index : METRICS_MAX_THREADS];
+    memcpy(name, block->name, METRICS_NAME_LENGTH);
+    name[METRICS_NAME_LENGTH - 1] = '\0';
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        snapshot->values[id] = __atomic_load_n(&block->values[id], __ATOMIC_RELAXED);
+    }
+    return 1;
+}
+
+const char* metrics_name(MetricId id) {
+    return id >= 0 && id < METRIC_COUNT ? metric_info[id].name : "unknown";
+}
+
+const char* metrics_help(MetricId id) {
+    return id >= 0 && id < METRIC_COUNT ? metric_info[id].help : "";
+}
+
+void metrics_report(void) {
+    MetricsSnapshot snapshot;
+    metrics_collect(&snapshot);
+
+    printf("Metrics:");
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        if (snapshot.values[id] != 0) {
+            printf(" %s=%lld", metric_info[id].name, (long long)snapshot.values[id]);
+        }
+    }
+    printf("\n");
+}
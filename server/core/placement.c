@@ -0,0 +1,207 @@
+#include "server/placement.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+static int entry_less(Placement* placement, int a, int b) {
+    int load_a = placement->entries[a].load;
+    int load_b = placement->entries[b].load;
+    // Lower index wins ties so placement is deterministic
+    return load_a < load_b || (load_a == load_b && a < b);
+}
+
+static void heap_swap(Placement* placement, int i, int j) {
+    int a = placement->heap[i];
+    int b = placement->heap[j];
+    placement->heap[i] = b;
+    placement->heap[j] = a;
+    placement->entries[b].heap_pos = i;
+    placement->entries[a].heap_pos = j;
+}
+
+static void heap_sift_up(Placement* placement, int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!entry_less(placement, placement->heap[pos], placement->heap[parent])) {
+            break;
+        }
+        heap_swap(placement, pos, parent);
+        pos = parent;
+    }
+}
+
+static void heap_sift_down(Placement* placement, int pos) {
+    while (1) {
+        int left = pos * 2 + 1;
+        int right = left + 1;
+        int smallest = pos;
+
+        if (left < placement->num_entries &&
+            entry_less(placement, placement->heap[left], placement->heap[smallest])) {
+            smallest = left;
+        }
+        if (right < placement->num_entries &&
+            entry_less(placement, placement->heap[right], placement->heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == pos) {
+            break;
+        }
+        heap_swap(placement, pos, smallest);
+        pos = smallest;
+    }
+}
+
+static void update_bucket_bit(Placement* placement, int bucket) {
+    uint64_t bit = 1ULL << (bucket % 64);
+    if (placement->bucket_load[bucket] >= placement->bucket_capacity[bucket]) {
+        placement->bucket_full[bucket / 64] |= bit;
+    } else {
+        placement->bucket_full[bucket / 64] &= ~bit;
+    }
+}
+
+Placement* create_placement(SocketPool* buckets, int num_buckets) {
+    if (!buckets || num_buckets <= 0) return NULL;
+
+    int num_entries = 0;
+    for (int i = 0; i < num_buckets; i++) {
+        num_entries += buckets[i].total_sockets;
+    }
+
+    Placement* placement = (Placement*)calloc(1, sizeof(Placement));
+    if (!placement) return NULL;
+
+    int words = (num_buckets + 63) / 64;
+    placement->entries = (PlacementEntry*)calloc(num_entries, sizeof(PlacementEntry));
+    placement->heap = (int*)calloc(num_entries, sizeof(int));
+    placement->bucket_load = (int*)calloc(num_buckets, sizeof(int));
+    placement->bucket_capacity = (int*)calloc(num_buckets, sizeof(int));
+    placement->bucket_full = (uint64_t*)calloc(words, sizeof(uint64_t));
+    if (!placement->entries || !placement->heap || !placement->bucket_load ||
+        !placement->bucket_capacity || !placement->bucket_full) {
+        printf("Failed to allocate placement index\n");
+        destroy_placement(placement);
+        return NULL;
+    }
+
+    placement->num_entries = num_entries;
+    placement->num_buckets = num_buckets;
+    placement->total_load = 0;
+    pthread_mutex_init(&placement->lock, NULL);
+
+    // Entries start empty, so bucket-major order is already a valid heap
+    int entry = 0;
+    for (int i = 0; i < num_buckets; i++) {
+        for (int j = 0; j < buckets[i].total_sockets; j++) {
+            Socket* sock = &buckets[i].sockets[j];
+            placement->entries[entry].sock = sock;
+            placement->entries[entry].bucket = i;
+            placement->entries[entry].load = 0;
+            placement->entries[entry].capacity = sock->conns.max_connections;
+            placement->entries[entry].heap_pos = entry;
+            placement->heap[entry] = entry;
+            placement->bucket_capacity[i] += sock->conns.max_connections;
+            entry++;
+        }
+        update_bucket_bit(placement, i);
+    }
+
+    return placement;
+}
+
+void destroy_placement(Placement* placement) {
+    if (!placement) return;
+
+    if (placement->entries) {
+        pthread_mutex_destroy(&placement->lock);
+    }
+    free(placement->entries);
+    free(placement->heap);
+    free(placement->bucket_load);
+    free(placement->bucket_capacity);
+    free(placement->bucket_full);
+    free(placement);
+}
+
+int placement_acquire(Placement* placement) {
+    if (!placement || placement->num_entries == 0) return -1;
+
+    pthread_mutex_lock(&placement->lock);
+    int entry = placement->heap[0];
+    PlacementEntry* e = &placement->entries[entry];
+
+    // The least loaded socket is full, so all of them are
+    if (e->load >= e->capacity) {
+        pthread_mutex_unlock(&placement->lock);
+        return -1;
+    }
+
+    e->load++;
+    placement->bucket_load[e->bucket]++;
+    placement->total_load++;
+    update_bucket_bit(placement, e->bucket);
+    heap_sift_down(placement, e->heap_pos);
+    pthread_mutex_unlock(&placement->lock);
+
+    return entry;
+}
+
+void placement_release(Placement* placement, int entry) {
+    if (!placement || entry < 0 || entry >= placement->num_entries) return;
+
+    pthread_mutex_lock(&placement->lock);
+    PlacementEntry* e = &placement->entries[entry];
+    if (e->load > 0) {
+        e->load--;
+        placement->bucket_load[e->bucket]--;
+        placement->total_load--;
+        update_bucket_bit(placement, e->bucket);
+        heap_sift_up(placement, e->heap_pos);
+    }
+    pthread_mutex_unlock(&placement->lock);
+}
+
+int placement_bucket_is_full(Placement* placement, int bucket) {
+    if (!placement || bucket < 0 || bucket >= placement->num_buckets) return 1;
+
+    pthread_mutex_lock(&placement->lock);
+    int full = (placement->bucket_full[bucket / 64] >> (bucket % 64)) & 1;
+    pthread_mutex_unlock(&placement->lock);
+
+    return full;
+}
+
+int placement_first_open_bucket(Placement* placement) {
+    if (!placement) return -1;
+
+    int words = (placement->num_buckets + 63) / 64;
+    int bucket = -1;
+
+    pthread_mutex_lock(&placement->lock);
+    for (int w = 0; w < words; w++) {
+        uint64_t open = ~placement->bucket_full[w];
+        // Mask off bits past the last bucket in the final word
+        int valid = placement->num_buckets - w * 64;
+        if (valid < 64) {
+            open &= (1ULL << valid) - 1;
+        }
+        if (open) {
+            bucket = w * 64 + __builtin_ctzll(open);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&placement->lock);
+
+    return bucket;
+}
+
+void placement_loads(Placement* placement, int* entry_loads, int* bucket_loads) {
+    pthread_mutex_lock(&placement->lock);
+    for (int i = 0; i < placement->num_entries; i++) {
+        entry_loads[i] = placement->entries[i].load;
+    }
+    for (int b = 0; b < placement->num_buckets; b++) {
+        bucket_loads[b] = placement->bucket_load[b];
+    }
+    pthread_mutex_unlock(&placement->lock);
+}
@@ -0,0 +1,170 @@
+#include "server/protocol.h"
+#include <string.h>
+#include <arpa/inet.h>
+
+void frame_parser_init(FrameParser* parser, uint8_t* buffer, size_t capacity, int compat) {
+    parser->data = buffer;
+    parser->start = 0;
+    parser->end = 0;
+    parser->capacity = capacity;
+    parser->mode = PROTO_MODE_UNKNOWN;
+    parser->compat = compat;
+}
+
+uint8_t* frame_parser_space(FrameParser* parser, size_t* available) {
+    if (parser->start == parser->end) {
+        parser->start = 0;
+        parser->end = 0;
+    } else if (parser->end == parser->capacity && parser->start > 0) {
+        // Only the partial message moves, and only when the tail is out of room
+        memmove(parser->data, parser->data + parser->start, parser->end - parser->start);
+        parser->end -= parser->start;
+        parser->start = 0;
+    }
+
+    *available = parser->capacity - parser->end;
+    return parser->data + parser->end;
+}
+
+void frame_parser_commit(FrameParser* parser, size_t bytes) {
+    parser->end += bytes;
+    if (parser->mode == PROTO_MODE_UNKNOWN && parser->end > parser->start) {
+        parser->mode = parser->data[parser->start] == PROTO_MAGIC ? PROTO_MODE_BINARY : parser->compat;
+    }
+}
+
+static int next_binary(FrameParser* parser, Frame* frame) {
+    size_t pending = parser->end - parser->start;
+    if (pending < PROTO_HEADER_SIZE) return 0;
+
+    const uint8_t* header = parser->data + parser->start;
+    if (header[0] != PROTO_MAGIC) return -1;
+
+    uint16_t flags;
+    uint32_t length;
+    memcpy(&flags, header + 2, sizeof(flags));
+    memcpy(&length, header + 4, sizeof(length));
+    length = ntohl(length);
+    if (length > PROTO_MAX_PAYLOAD) return -1;
+    if (pending < PROTO_HEADER_SIZE + (size_t)length) return 0;
+
+    frame->opcode = header[1];
+    frame->flags = ntohs(flags);
+    frame->length = length;
+    frame->payload = header + PROTO_HEADER_SIZE;
+    parser->start += PROTO_HEADER_SIZE + length;
+    return 1;
+}
+
+static int next_line(FrameParser* parser, Frame* frame) {
+    uint8_t* line = parser->data + parser->start;
+    size_t pending = parser->end - parser->start;
+    uint8_t* newline = (uint8_t*)memchr(line, '\n', pending);
+
+    if (!newline) {
+        // A line that cannot fit the buffer will never complete
+        return pending == parser->capacity ? -1 : 0;
+    }
+
+    size_t length = (size_t)(newline - line);
+    parser->start += length + 1;
+    if (length > 0 && line[length - 1] == '\r') {
+        length--;
+    }
+
+    frame->opcode = PROTO_OP_TEXT;
+    frame->flags = 0;
+    frame->length = (uint32_t)length;
+    frame->payload = line;
+    return 1;
+}
+
+int frame_parser_next(FrameParser* parser, Frame* frame) {
+    if (parser->start == parser->end) return 0;
+
+    switch (parser->mode) {
+        case PROTO_MODE_BINARY:
+            return next_binary(parser, frame);
+        case PROTO_MODE_TEXT:
+            return next_line(parser, frame);
+        case PROTO_MODE_RAW:
+            frame->opcode = PROTO_OP_RAW;
+            frame->flags = 0;
+            frame->length = (uint32_t)(parser->end - parser->start);
+            frame->payload = parser->data + parser->start;
+            parser->start = parser->end;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+void proto_encode_header(uint8_t* out, uint8_t opcode, uint16_t flags, uint32_t length) {
+    uint16_t net_flags = htons(flags);
+    uint32_t net_length = htonl(length);
+
+    out[0] = PROTO_MAGIC;
+    out[1] = opcode;
+    memcpy(out + 2, &net_flags, sizeof(net_flags));
+    memcpy(out + 4, &net_length, sizeof(net_length));
+}
+
+size_t proto_encode_frame(uint8_t* out, size_t out_size, uint8_t opcode, uint16_t flags,
+                          const void* payload, uint32_t length) {
+    if (out_size < PROTO_HEADER_SIZE || out_size - PROTO_HEADER_SIZE < length) return 0;
+
+    proto_encode_header(out, opcode, flags, length);
+    if (length > 0) {
+        memcpy(out + PROTO_HEADER_SIZE, payload, length);
+    }
+    return PROTO_HEADER_SIZE + (size_t)length;
+}
+
+// Length-prefixed string at *pos, advanced past it
+static int take_string(const Frame* frame, size_t* pos, char* out, size_t out_size) {
+    if (*pos >= frame->length) return -1;
+
+    size_t length = frame->payload[*pos];
+    (*pos)++;
+    if (length == 0 || length >= out_size || *pos + length > frame->length) return -1;
+
+    memcpy(out, frame->payload + *pos, length);
+    out[length] = '\0';
+    // Embedded NULs would make the strings disagree with what was framed
+    if (strlen(out) != length) return -1;
+
+    *pos += length;
+    return 1;
+}
+
+int proto_parse_credentials(const Frame* frame, char* username, size_t username_size,
+                            char* password, size_t password_size) {
+    size_t pos = 0;
+
+    if (take_string(frame, &pos, username, username_size) < 0 ||
+        take_string(frame, &pos, password, password_size) < 0 ||
+        pos != frame->length) {
+        return -1;
+    }
+    return 1;
+}
+
+int proto_parse_name(const Frame* frame, char* name, size_t name_size) {
+    size_t pos = 0;
+
+    if (take_string(frame, &pos, name, name_size) < 0 || pos != frame->length) {
+        return -1;
+    }
+    return 1;
+}
+
+int proto_parse_message(const Frame* frame, char* username, size_t username_size,
+                        const uint8_t** body, uint32_t* body_length) {
+    size_t pos = 0;
+
+    if (take_string(frame, &pos, username, username_size) < 0) return -1;
+
+    *body = frame->payload + pos;
+    *body_length = frame->length - (uint32_t)pos;
+    return 1;
+}
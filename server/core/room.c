@@ -0,0 +1,322 @@
+#include "server/room.h"
+#include "server/metrics.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static void room_mailbox_handler(EventSource* source, uint32_t events);
+
+// Member arrays come from the size classes up to SLAB_MAX_OBJECT, bigger rooms use the heap
+static int members_pooled(int capacity) {
+    return (size_t)capacity * sizeof(ClientConnection*) <= SLAB_MAX_OBJECT;
+}
+
+static void free_members(RoomLocal* room) {
+    if (!room->members) return;
+    if (members_pooled(room->capacity)) {
+        slab_free(room->members);
+    } else {
+        free(room->members);
+    }
+}
+
+static ClientConnection** grow_members(SlabClasses* slabs, RoomLocal* room, int capacity) {
+    size_t size = sizeof(ClientConnection*) * capacity;
+    ClientConnection** members = members_pooled(capacity) ? (ClientConnection**)slab_alloc_size(slabs, size)
+                                                          : (ClientConnection**)malloc(size);
+    if (!members) return NULL;
+
+    if (room->count > 0) {
+        memcpy(members, room->members, sizeof(ClientConnection*) * room->count);
+    }
+    free_members(room);
+    return members;
+}
+
+RoomHub* create_room_hub(EventLoopPool* loops, uint64_t seed, SlabClasses* slabs) {
+    if (!loops || loops->num_loops < 1 || !slabs) return NULL;
+
+    RoomHub* hub = (RoomHub*)calloc(1, sizeof(RoomHub));
+    if (!hub) return NULL;
+
+    hub->shards = (RoomShard*)calloc(loops->num_loops, sizeof(RoomShard));
+    if (!hub->shards) {
+        free(hub);
+        return NULL;
+    }
+    hub->num_shards = loops->num_loops;
+    hub->seed = seed;
+    hub->slabs = slabs;
+
+    for (int i = 0; i < hub->num_shards; i++) {
+        RoomShard* shard = &hub->shards[i];
+        shard->hub = hub;
+        shard->loop = &loops->loops[i];
+        shard->index = i;
+        shard->mailbox.event_fd = -1;
+    }
+    return hub;
+}
+
+int start_room_hub(RoomHub* hub) {
+    if (!hub) return -1;
+
+    for (int i = 0; i < hub->num_shards; i++) {
+        RoomShard* shard = &hub->shards[i];
+        if (mailbox_open(&shard->mailbox) < 0) {
+            printf("Failed to create room mailbox for event loop %d\n", i);
+            return -1;
+        }
+        event_source_init(&shard->mailbox_source, shard->mailbox.event_fd, room_mailbox_handler, shard);
+        if (event_loop_add(shard->loop, &shard->mailbox_source, EPOLLIN) < 0) {
+            printf("Failed to add room mailbox to event loop %d\n", i);
+            return -1;
+        }
+    }
+    return 1;
+}
+
+void destroy_room_hub(RoomHub* hub) {
+    if (!hub) return;
+
+    for (int i = 0; i < hub->num_shards; i++) {
+        RoomShard* shard = &hub->shards[i];
+
+        if (shard->mailbox.event_fd >= 0) {
+            MpscNode* node;
+            while ((node = mpsc_pop(&shard->mailbox.queue))) {
+                RoomPost* post = (RoomPost*)node;
+                metrics_add(METRIC_MAILBOX_QUEUE, -1);
+                shared_buffer_unref(post->frame);
+                slab_free(post);
+            }
+            close(shard->mailbox.event_fd);
+        }
+
+        for (int b = 0; b < ROOM_INDEX_BUCKETS; b++) {
+            RoomLocal* room = shard->index_buckets[b];
+            while (room) {
+                RoomLocal* next = room->next;
+                free_members(room);
+                slab_free(room);
+                room = next;
+            }
+        }
+
+        if (shard->published || shard->delivered || shard->dropped) {
+            printf("Rooms on event loop %d: %lu published, %lu delivered, %lu dropped\n",
+                   i, shard->published, shard->delivered, shard->dropped);
+        }
+    }
+    free(hub->shards);
+    free(hub);
+}
+
+RoomShard* room_shard_for(RoomHub* hub, EventLoop* loop) {
+    if (!hub || !loop || loop->index < 0 || loop->index >= hub->num_shards) return NULL;
+    return &hub->shards[loop->index];
+}
+
+static uint64_t loop_bit(int index) {
+    return 1ULL << (index & (ROOM_MAX_LOOPS - 1));
+}
+
+static RoomLocal* find_room(RoomShard* shard, const char* name, uint64_t hash) {
+    RoomLocal* room = shard->index_buckets[hash & (ROOM_INDEX_BUCKETS - 1)];
+    while (room && (room->hash != hash || strcmp(room->name, name) != 0)) {
+        room = room->next;
+    }
+    return room;
+}
+
+// First room in an interest slot on this loop: publishers start posting here
+static void add_interest(RoomShard* shard, uint64_t hash) {
+    uint32_t slot = hash & (ROOM_INTEREST_SLOTS - 1);
+    if (shard->interest[slot]++ == 0) {
+        __atomic_fetch_or(&shard->hub->interest[slot], loop_bit(shard->index), __ATOMIC_RELEASE);
+    }
+}
+
+// Past ROOM_MAX_LOOPS loops share bits, so bits are never cleared there
+static void remove_interest(RoomShard* shard, uint64_t hash) {
+    uint32_t slot = hash & (ROOM_INTEREST_SLOTS - 1);
+    if (--shard->interest[slot] == 0 && shard->hub->num_shards <= ROOM_MAX_LOOPS) {
+        __atomic_fetch_and(&shard->hub->interest[slot], ~loop_bit(shard->index), __ATOMIC_RELEASE);
+    }
+}
+
+static RoomLocal* create_room(RoomShard* shard, const char* name, uint64_t hash) {
+    RoomLocal* room = (RoomLocal*)slab_alloc_size(shard->hub->slabs, sizeof(RoomLocal));
+    if (!room) return NULL;
+    memset(room, 0, sizeof(RoomLocal));
+
+    strncpy(room->name, name, ROOM_NAME_LENGTH - 1);
+    room->hash = hash;
+
+    RoomLocal** bucket = &shard->index_buckets[hash & (ROOM_INDEX_BUCKETS - 1)];
+    room->next = *bucket;
+    *bucket = room;
+    add_interest(shard, hash);
+    return room;
+}
+
+// Last local member left, other loops may still have the room
+static void delete_room(RoomShard* shard, RoomLocal* room) {
+    RoomLocal** link = &shard->index_buckets[room->hash & (ROOM_INDEX_BUCKETS - 1)];
+    while (*link != room) {
+        link = &(*link)->next;
+    }
+    *link = room->next;
+    remove_interest(shard, room->hash);
+    free_members(room);
+    slab_free(room);
+}
+
+int room_join(RoomShard* shard, ClientConnection* conn, const char* name) {
+    for (int i = 0; i < conn->num_rooms; i++) {
+        if (strcmp(conn->rooms[i]->name, name) == 0) return 0;
+    }
+    if (conn->num_rooms == ROOMS_PER_CLIENT) return -1;
+
+    uint64_t hash = hash_username(name, shard->hub->seed);
+    RoomLocal* room = find_room(shard, name, hash);
+    if (!room && !(room = create_room(shard, name, hash))) return -1;
+
+    if (room->count == room->capacity) {
+        int capacity = room->capacity ? room->capacity * 2 : 8;
+        ClientConnection** members = grow_members(shard->hub->slabs, room, capacity);
+        if (!members) {
+            if (room->count == 0) {
+                delete_room(shard, room);
+            }
+            return -1;
+        }
+        room->members = members;
+        room->capacity = capacity;
+    }
+
+    room->members[room->count++] = conn;
+    conn->rooms[conn->num_rooms++] = room;
+    return 1;
+}
+
+// Unordered removal from both sides
+static void remove_member(RoomShard* shard, RoomLocal* room, ClientConnection* conn) {
+    for (int i = 0; i < room->count; i++) {
+        if (room->members[i] == conn) {
+            room->members[i] = room->members[--room->count];
+            break;
+        }
+    }
+    for (int i = 0; i < conn->num_rooms; i++) {
+        if (conn->rooms[i] == room) {
+            conn->rooms[i] = conn->rooms[--conn->num_rooms];
+            break;
+        }
+    }
+    if (room->count == 0) {
+        delete_room(shard, room);
+    }
+}
+
+int room_leave(RoomShard* shard, ClientConnection* conn, const char* name) {
+    for (int i = 0; i < conn->num_rooms; i++) {
+        if (strcmp(conn->rooms[i]->name, name) == 0) {
+            remove_member(shard, conn->rooms[i], conn);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void room_leave_all(RoomShard* shard, ClientConnection* conn) {
+    while (conn->num_rooms > 0) {
+        remove_member(shard, conn->rooms[conn->num_rooms - 1], conn);
+    }
+}
+
+// Every local member gets a reference to the same frame
+static void deliver_local(RoomShard* shard, const char* name, uint64_t hash, SharedBuffer* frame) {
+    RoomLocal* room = find_room(shard, name, hash);
+    if (!room) return;
+
+    for (int i = 0; i < room->count; i++) {
+        if (socket_queue_shared(room->members[i], frame) < 0) {
+            shard->dropped++;
+            metrics_inc(METRIC_ROOM_DROPS);
+        } else {
+            shard->delivered++;
+        }
+    }
+}
+
+int room_publish(RoomShard* shard, const char* name, const char* sender,
+                 const uint8_t* body, uint32_t length) {
+    RoomHub* hub = shard->hub;
+    uint8_t name_length = (uint8_t)strnlen(name, ROOM_NAME_LENGTH - 1);
+    uint8_t sender_length = (uint8_t)strnlen(sender, MAX_USERNAME - 1);
+    uint32_t payload = 2 + name_length + sender_length + length;
+
+    // Encoded once, every member's output references these bytes
+    SharedBuffer* frame = shared_buffer_create(hub->slabs, PROTO_HEADER_SIZE + payload);
+    if (!frame) return -1;
+    uint8_t* out = frame->data;
+    proto_encode_header(out, PROTO_OP_ROOM, 0, payload);
+    out += PROTO_HEADER_SIZE;
+    *out++ = name_length;
+    memcpy(out, name, name_length);
+    out += name_length;
+    *out++ = sender_length;
+    memcpy(out, sender, sender_length);
+    out += sender_length;
+    memcpy(out, body, length);
+
+    uint64_t hash = hash_username(name, hub->seed);
+    uint64_t interest = __atomic_load_n(&hub->interest[hash & (ROOM_INTEREST_SLOTS - 1)], __ATOMIC_ACQUIRE);
+    shard->published++;
+    metrics_inc(METRIC_ROOM_PUBLISHES);
+
+    for (int i = 0; i < hub->num_shards; i++) {
+        if (!(interest & loop_bit(i))) continue;
+
+        if (i == shard->index) {
+            deliver_local(shard, name, hash, frame);
+            continue;
+        }
+
+        // One post per loop, however many members it has
+        RoomPost* post = (RoomPost*)slab_alloc_size(hub->slabs, sizeof(RoomPost));
+        if (!post) continue;
+        shared_buffer_ref(frame);
+        post->frame = frame;
+        post->hash = hash;
+        memcpy(post->name, name, name_length);
+        post->name[name_length] = '\0';
+        mailbox_post(&hub->shards[i].mailbox, &post->node);
+    }
+
+    shared_buffer_unref(frame);
+    return 1;
+}
+
+static void room_mailbox_handler(EventSource* source, uint32_t events) {
+    RoomShard* shard = (RoomShard*)source->owner;
+    (void)events;
+
+    mailbox_begin_drain(&shard->mailbox);
+
+    int handled = 0;
+    MpscNode* node;
+    while (handled < MAILBOX_DRAIN_BATCH && (node = mpsc_pop(&shard->mailbox.queue))) {
+        RoomPost* post = (RoomPost*)node;
+        metrics_add(METRIC_MAILBOX_QUEUE, -1);
+        deliver_local(shard, post->name, post->hash, post->frame);
+        shared_buffer_unref(post->frame);
+        slab_free(post);
+        handled++;
+    }
+
+    if (handled == MAILBOX_DRAIN_BATCH) {
+        mailbox_wake(&shard->mailbox);
+    }
+}
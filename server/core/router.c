@@ -1,9 +1,13 @@
+#define _GNU_SOURCE
 #include "server/router.h"
+#include "server/metrics.h"
+#include "server/latency.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include <arpa/inet.h>
 
-uint32_t generate_session_key()
+uint32_t generate_session_key(void)
 {
     uint32_t key;
     FILE *urandom = fopen("/dev/urandom", "r");
@@ -16,29 +20,51 @@ uint32_t generate_session_key()
     return 0; // Or handle error differently
 }
 
-// Set bucket as full
-void set_bucket_full(Router *router, int bucket_index)
+// A user's reservation timed out on its socket's loop: give back the load and log them out
+static void expire_user_session(void *ctx, Socket *sock, uint32_t session_key, const char *owner)
 {
-    router->bucket_status[bucket_index / 8] |= (1 << (bucket_index % 8));
-}
+    Router *router = (Router *)ctx;
 
-// Set bucket as not full
-void set_bucket_empty(Router *router, int bucket_index)
-{
-    router->bucket_status[bucket_index / 8] &= ~(1 << (bucket_index % 8));
-}
+    placement_release(router->placement, sock->placement_entry);
 
-// Check if bucket is full
-int is_bucket_full(Router *router, int bucket_index)
-{
-    return (router->bucket_status[bucket_index / 8] & (1 << (bucket_index % 8))) != 0;
+    if (owner[0] && remove_user_session(router->user_cache, owner, session_key) == 0)
+    {
+        printf("Session of %s expired, port %d released\n", owner, sock->port);
+    }
 }
 
-// Allocate the bit array
-void init_bucket_status(Router *router)
+// Port -> socket index over every placement entry, shared read-only by the socket threads
+static int build_socket_directory(Router *router)
 {
-    int num_bytes = (router->num_buckets + 7) / 8; // Round up to nearest byte
-    router->bucket_status = calloc(num_bytes, sizeof(uint8_t));
+    SocketDirectory *directory = &router->directory;
+    if (router->placement->num_entries == 0)
+        return -1;
+
+    int first = router->placement->entries[0].sock->port;
+    int last = first;
+    for (int i = 1; i < router->placement->num_entries; i++)
+    {
+        int port = router->placement->entries[i].sock->port;
+        if (port < first)
+            first = port;
+        if (port > last)
+            last = port;
+    }
+
+    directory->users = router->user_cache;
+    directory->first_port = first;
+    directory->num_ports = last - first + 1;
+    directory->by_port = (Socket **)calloc(directory->num_ports, sizeof(Socket *));
+    if (!directory->by_port)
+        return -1;
+
+    for (int i = 0; i < router->placement->num_entries; i++)
+    {
+        Socket *sock = router->placement->entries[i].sock;
+        directory->by_port[sock->port - first] = sock;
+        sock->directory = directory;
+    }
+    return 1;
 }
 
 Router *create_router(UserDB *user_db)
@@ -60,54 +86,135 @@ Router *create_router(UserDB *user_db)
         USERS_PER_SOCKET,
         MAIN_SOCKET_PORT,
         USER_SOCKET_PORT_START,
+        AUTH_WORKER_THREADS,
+        ROUTER_REACTOR_THREADS,
+        ROUTER_FD_HANDOFF,
+        EVENT_LOOP_THREADS,
+        EGRESS_FLUSH_WINDOW_MS,
+        IO_BACKEND,
+        METRICS_PORT,
+        "",
     };
 
     router->config = rcf;
+    router->directory.by_port = NULL;
+    router->directory.rooms = NULL;
+    router->slabs = NULL;
+    router->client_slab = NULL;
+    router->job_slab = NULL;
+    router->admin = NULL;
+
+    // The environment picks the backend at startup, each loop falls back to epoll if io_uring is refused
+    router->io = io_backend_by_id(router->config.io_backend);
+    const char *backend_name = getenv(IO_BACKEND_ENV);
+    if (backend_name)
+    {
+        const IoBackend *io = io_backend_by_name(backend_name);
+        if (io)
+        {
+            router->io = io;
+        }
+        else
+        {
+            printf("Unknown %s \"%s\", using %s\n", IO_BACKEND_ENV, backend_name, router->io ? router->io->name : "epoll");
+        }
+    }
+
+    const char *metrics_spec = getenv(ADMIN_ENV);
+    if (metrics_spec)
+    {
+        int port;
+        char path[ADMIN_UNIX_PATH_MAX];
+        if (parse_admin_endpoint(metrics_spec, &port, path) < 0)
+        {
+            printf("Invalid %s \"%s\", metrics stay on port %d\n", ADMIN_ENV, metrics_spec, router->config.metrics_port);
+        }
+        else
+        {
+            router->config.metrics_port = port;
+            memcpy(router->config.metrics_path, path, sizeof(path));
+        }
+    }
 
-    // First create default socket config
+    // First create default socket config, router listeners share the port
     SocketConfig socket_config = create_default_socket_config();
+    socket_config.backlog = ROUTER_BACKLOG;
+    socket_config.reuse_port = 1;
 
-    // Create router socket
-    RouterSocket main_socket = create_router_socket(
-        socket_config,
-        router->config.router_port // or MAIN_SOCKET_PORT
-    );
+    // Create one router socket per reactor
+    router->num_reactors = router->config.reactor_threads > 0 ? router->config.reactor_threads : 1;
+    router->reactors = (RouterReactor *)calloc(router->num_reactors, sizeof(RouterReactor));
+    if (!router->reactors)
+    {
+        printf("Failed to allocate router reactors\n");
+        return NULL;
+    }
 
-    router->socket = main_socket;
+    for (int i = 0; i < router->num_reactors; i++)
+    {
+        router->reactors[i].router = router;
+        router->reactors[i].index = i;
+        router->reactors[i].db_completions.event_fd = -1;
+        router->reactors[i].socket = create_router_socket(
+            socket_config,
+            router->config.router_port // or MAIN_SOCKET_PORT
+        );
+    }
 
     // generate the SocketBuckets
     int num_buckets = ceil((double)NUMBER_OF_USERS / (USERS_PER_SOCKET * SOCKETS_PER_BUCKET));
     router->num_buckets = num_buckets;
     printf("number of buckets %d\n", num_buckets);
 
-    // Calculate number of bytes needed (round up to nearest byte)
-    int num_bytes = (num_buckets + 7) / 8;
-    router->bucket_status = (uint8_t *)calloc(num_bytes, sizeof(uint8_t));
+    router->socket_pool = (SocketPool *)malloc(sizeof(SocketPool) * num_buckets);
+
+    if (router->socket_pool == NULL)
+    {
+        printf("Memory allocation for the socket pool failed\n");
+    }
 
-    if (!router->bucket_status)
+    router->event_loops = create_event_loop_pool(router->config.event_loops, router->io, router->config.flush_window_ms);
+    if (!router->event_loops)
     {
-        printf("Failed to allocate bucket status array\n");
+        printf("Failed to create event loops\n");
         return NULL;
     }
 
-    // Initialize all buckets as empty
-    for (int i = 0; i < num_buckets; i++)
+    // With fd handoff the user sockets never need their own listening port
+    SocketConfig user_socket_config = create_default_socket_config();
+    user_socket_config.enable_listener = !router->config.fd_handoff;
+
+    // Every client takes an input and an output block, warm enough for a full server
+    router->buffers = create_buffer_pool(socket_buffer_block_size(&user_socket_config), 2 * NUMBER_OF_USERS);
+    if (!router->buffers)
     {
-        set_bucket_empty(router, i);
+        printf("Failed to create buffer pool\n");
+        return NULL;
     }
 
-    router->socket_pool = (SocketPool *)malloc(sizeof(SocketPool) * num_buckets);
-
-    if (router->socket_pool == NULL)
+    // Everything allocated per request or message comes from slabs, warm after the first few
+    router->slabs = create_slab_classes("hub");
+    router->client_slab = create_slab_cache("router-client", sizeof(RouterClient), ROUTER_BACKLOG);
+    router->job_slab = create_slab_cache("db-job", sizeof(DbJob), AUTH_WORKER_THREADS * 4);
+    if (!router->slabs || !router->client_slab || !router->job_slab)
     {
-        printf("Memory allocation for the socket pool failed\n");
+        printf("Failed to create slab caches\n");
+        return NULL;
     }
 
     int port = USER_SOCKET_PORT_START;
     for (int i = 0; i < num_buckets; i++)
     {
         printf("\n\nGenerating bucket %d: \n", (i + 1));
-        router->socket_pool[i] = *create_socketpool(SOCKETS_PER_BUCKET, USERS_PER_SOCKET, port);
+        SocketPool *pool = create_socketpool(SOCKETS_PER_BUCKET, USERS_PER_SOCKET, port, user_socket_config, router->buffers, router->slabs);
+        if (!pool)
+        {
+            printf("Failed to create socket pool bucket %d\n", i + 1);
+            return NULL;
+        }
+        // The bucket array holds the pools by value, only the sockets stay behind the pointer
+        router->socket_pool[i] = *pool;
+        free(pool);
         port += SOCKETS_PER_BUCKET * USERS_PER_SOCKET;
         if (port > (NUMBER_OF_USERS + USER_SOCKET_PORT_START))
         {
@@ -116,210 +223,716 @@ Router *create_router(UserDB *user_db)
         printf("Finished generating bucket %d with the final port %d \n\n", (i + 1), port);
     }
 
+    // Index every socket by live load so assignment spreads users evenly
+    router->placement = create_placement(router->socket_pool, num_buckets);
+    if (!router->placement)
+    {
+        printf("Failed to create placement index\n");
+        return NULL;
+    }
+
+    // Expired reservations come back through the router to update placement and the cache,
+    // each socket knows its entry so the release needs no search
+    for (int i = 0; i < router->placement->num_entries; i++)
+    {
+        router->placement->entries[i].sock->on_slot_expired = expire_user_session;
+        router->placement->entries[i].sock->slot_expired_ctx = router;
+        router->placement->entries[i].sock->placement_entry = i;
+    }
+
     router->user_cache = create_user_cache();
     if (!router->user_cache)
     {
         printf("Error genererating user cache\n");
     }
+    else if (build_socket_directory(router) < 0)
+    {
+        printf("Failed to index sockets for user messaging\n");
+    }
+    else
+    {
+        // Room names hash with their own seed, derived from the cache's
+        router->directory.rooms = create_room_hub(router->event_loops, router->user_cache->seed ^ 0xA5A5A5A5A5A5A5A5ULL, router->slabs);
+        if (!router->directory.rooms)
+        {
+            printf("Failed to create room hub\n");
+        }
+    }
+
+    router->db_executor = create_db_executor(user_db, router->config.auth_workers);
+    if (!router->db_executor)
+    {
+        printf("Error generating DB executor\n");
+        return NULL;
+    }
 
     return router;
 }
 
+// Reserve a slot for the key, reporting the placement entry and slot so it can be undone
+static int reserve_user_slot(Router *router, const char *username, uint32_t session_key, int *entry_out, int *slot_out)
+{
+    // Least loaded socket across every bucket that still has room
+    int entry = placement_acquire(router->placement);
+    if(entry == -1){
+        printf("Server is at capacity (no open buckets)");
+        return -1;
+    }
+
+    Socket *sock = router->placement->entries[entry].sock;
+    int slot = reserve_socket_slot(sock, session_key, username);
+    if (slot < 0)
+    {
+        placement_release(router->placement, entry);
+        return -1;
+    }
+
+    *entry_out = entry;
+    *slot_out = slot;
+
+    printf("Added session key %u to socket at port %d (load %d/%d)\n",
+           session_key, sock->port, router->placement->entries[entry].load,
+           router->placement->entries[entry].capacity);
+    return sock->port;
+}
+
 int assign_user_socket(Router *router, uint32_t session_key)
 {
+    int entry, slot;
+    return reserve_user_slot(router, NULL, session_key, &entry, &slot);
+}
 
-    // Need to find an open bucket first
-    int open_index = -1;
-    for(int i = 0; i < router->num_buckets; i++){
-        if(!is_bucket_full(router, i)){
-            open_index = i;
-            break;
+static void flush_router_client(RouterReactor *reactor, RouterClient *client);
+
+// Queue behind pending output; a client whose replies no longer fit is dropped once the rest drains
+static void queue_reply(RouterClient *client, const void *data, size_t length)
+{
+    RouterReactor *reactor = (RouterReactor *)client->source.owner;
+    struct iovec iov = {(void *)data, length};
+    if (ring_append(&client->out, &iov, 1) < 0)
+    {
+        client->closing = 1;
+        return;
+    }
+
+    reactor->loop.egress.frames++;
+    event_loop_defer_flush(&reactor->loop, &client->flush);
+}
+
+// Write a reply in the client's protocol: a frame in binary mode, the text otherwise
+static void send_reply(RouterClient *client, uint8_t opcode, const char *text)
+{
+    if (client->parser.mode == PROTO_MODE_BINARY)
+    {
+        uint8_t frame[PROTO_HEADER_SIZE + 256];
+        size_t length = proto_encode_frame(frame, sizeof(frame), opcode, 0, text, (uint32_t)strlen(text));
+        queue_reply(client, frame, length);
+    }
+    else
+    {
+        queue_reply(client, text, strlen(text));
+    }
+}
+
+// Port and session key for a logged in user (binary: SESSION frame)
+static void send_session(RouterClient *client, uint16_t flags, int port, uint32_t session_key, const char *text)
+{
+    if (client->parser.mode == PROTO_MODE_BINARY)
+    {
+        uint8_t payload[6];
+        uint16_t net_port = htons((uint16_t)port);
+        uint32_t net_key = htonl(session_key);
+        memcpy(payload, &net_port, sizeof(net_port));
+        memcpy(payload + 2, &net_key, sizeof(net_key));
+
+        uint8_t frame[PROTO_HEADER_SIZE + sizeof(payload)];
+        size_t length = proto_encode_frame(frame, sizeof(frame), PROTO_OP_SESSION, flags, payload, sizeof(payload));
+        queue_reply(client, frame, length);
+    }
+    else
+    {
+        queue_reply(client, text, strlen(text));
+    }
+}
+
+static void router_recv_handler(EventSource *source, ssize_t result);
+static void router_send_handler(EventSource *source, ssize_t result);
+static void router_client_closed(EventSource *source, ssize_t result);
+static void router_flush_handler(FlushNode *node);
+
+static RouterClient *create_router_client(RouterReactor *reactor, int client_fd)
+{
+    Router *router = reactor->router;
+    RouterClient *client = (RouterClient *)slab_alloc(router->client_slab);
+    if (!client)
+        return NULL;
+    memset(client, 0, sizeof(RouterClient));
+
+    uint8_t *input = (uint8_t *)buffer_pool_get(router->buffers);
+    uint8_t *output = (uint8_t *)buffer_pool_get(router->buffers);
+    if (!input || !output)
+    {
+        buffer_pool_put(router->buffers, input);
+        buffer_pool_put(router->buffers, output);
+        slab_free(client);
+        return NULL;
+    }
+
+    frame_parser_init(&client->parser, input, router->buffers->block_size, PROTO_MODE_TEXT);
+    ring_init(&client->out, output, (uint32_t)router->buffers->block_size);
+    event_source_init(&client->source, client_fd, NULL, reactor);
+    client->source.on_recv = router_recv_handler;
+    client->source.on_send = router_send_handler;
+    client->source.on_close = router_client_closed;
+    event_loop_flush_init(&client->flush, router_flush_handler, client);
+    return client;
+}
+
+// Give the client's blocks back, the fd is left alone
+static void free_router_client(RouterReactor *reactor, RouterClient *client)
+{
+    buffer_pool_put(reactor->router->buffers, client->parser.data);
+    buffer_pool_put(reactor->router->buffers, client->out.data);
+    slab_free(client);
+}
+
+// Freed once the loop reports nothing in flight still uses its buffers
+static void close_router_client(RouterReactor *reactor, RouterClient *client)
+{
+    client->closed = 1;
+    event_loop_close(&reactor->loop, &client->source);
+}
+
+static void router_client_closed(EventSource *source, ssize_t result)
+{
+    (void)result;
+    free_router_client((RouterReactor *)source->owner, (RouterClient *)source);
+}
+
+// Pause requests at the high-water mark, resume once half of it drained
+static void update_client_backpressure(RouterReactor *reactor, RouterClient *client)
+{
+    uint32_t pending = ring_used(&client->out);
+    uint32_t high_water = (uint32_t)reactor->socket.config.write_high_water;
+
+    if (!client->paused && pending >= high_water)
+    {
+        client->paused = 1;
+    }
+    else if (client->paused && pending <= high_water / 2)
+    {
+        client->paused = 0;
+    }
+}
+
+// Receive the next requests if the client may send any, or close it once a final reply went out
+static void sync_router_client(RouterReactor *reactor, RouterClient *client)
+{
+    // Nothing is received until its job completes
+    if (client->busy || client->closed)
+        return;
+
+    if (client->closing)
+    {
+        if (ring_used(&client->out) == 0 && !client->sending)
+        {
+            close_router_client(reactor, client);
         }
+        return;
     }
 
-    if(open_index == -1){
-        printf("Server is at capacity (no open buckets)");
+    update_client_backpressure(reactor, client);
+    if (client->paused || client->receiving)
+        return;
+
+    size_t space;
+    uint8_t *buffer = frame_parser_space(&client->parser, &space);
+    if (space == 0 || event_loop_recv(&reactor->loop, &client->source, buffer, space) < 0)
+    {
+        printf("[Router %d] Dropping fd %d, request does not fit\n", reactor->index, client->source.fd);
+        close_router_client(reactor, client);
+        return;
+    }
+    client->receiving = 1;
+}
+
+// The peer is gone: throw away what was queued, close once no job holds the client
+static void drop_router_client(RouterReactor *reactor, RouterClient *client)
+{
+    ring_consume(&client->out, ring_used(&client->out));
+    client->closing = 1;
+    client->handoff_port = 0;
+    sync_router_client(reactor, client);
+}
+
+// One send of the queued replies at a time
+static void flush_router_client(RouterReactor *reactor, RouterClient *client)
+{
+    if (client->sending || client->closed)
+        return;
+
+    struct iovec iov[2];
+    int count = ring_peek_iov(&client->out, iov);
+    if (count == 0)
+        return;
+
+    if (event_loop_send(&reactor->loop, &client->source, iov, count) < 0)
+    {
+        drop_router_client(reactor, client);
+        return;
+    }
+    client->sending = 1;
+    reactor->loop.egress.writes++;
+}
+
+static void router_flush_handler(FlushNode *node)
+{
+    RouterClient *client = (RouterClient *)node->owner;
+    flush_router_client((RouterReactor *)client->source.owner, client);
+}
+
+// Hand the request to a DB worker, the client receives nothing until it completes
+static int submit_db_request(RouterReactor *reactor, int type, DbCompletionHandler on_complete, RouterClient *client, const char *username, const char *password)
+{
+    DbJob *job = (DbJob *)slab_alloc(reactor->router->job_slab);
+    if (!job)
+    {
+        send_reply(client, PROTO_OP_ERROR, "Server busy, try again\n");
         return -1;
     }
-    // After open bucket found then delegate socket assignment to the socket pool bucket
-    int port_number = find_open_socket(&router->socket_pool[open_index], session_key);
-    return port_number;
+    memset(job, 0, sizeof(DbJob));
+
+    job->type = type;
+    job->context = client;
+    job->on_complete = on_complete;
+    job->completions = &reactor->db_completions;
+    strncpy(job->username, username, sizeof(job->username) - 1);
+    strncpy(job->password, password, sizeof(job->password) - 1);
+
+    if (submit_db_job(reactor->router->db_executor, job) < 0)
+    {
+        memset(job->password, 0, sizeof(job->password));
+        slab_free(job);
+        send_reply(client, PROTO_OP_ERROR, "Server busy, try again\n");
+        return -1;
+    }
+
+    // Later frames stay buffered until the answer is queued
+    client->busy = 1;
+
+    return 0;
 }
 
-int handle_authentication(Router *router, int client_fd, const char *username, const char *password)
+static void process_client_frames(RouterReactor *reactor, RouterClient *client);
+static void complete_authentication(DbJob *job);
+static void complete_registration(DbJob *job);
+
+// Let a client send requests again after its job completed
+static void resume_client(RouterReactor *reactor, RouterClient *client)
+{
+    client->busy = 0;
+
+    // Pipelined requests that arrived with the one just answered
+    process_client_frames(reactor, client);
+    sync_router_client(reactor, client);
+}
+
+int handle_authentication(RouterReactor *reactor, RouterClient *client, const char *username, const char *password)
 {
-    if (!router || !username || !password)
+    if (!reactor || !client || !username || !password)
         return -1;
 
-    // First check if user is already logged in
-    if (has_user(router->user_cache, username)) {
+    Router *router = reactor->router;
+
+    // First check if user is already logged in (lock-free cache reads)
+    int logged_in = has_user(router->user_cache, username);
+    int existing_port = logged_in ? get_user_port(router->user_cache, username) : -1;
+    uint32_t session_key = logged_in ? get_user_session(router->user_cache, username) : 0;
+
+    if (logged_in) {
         char response[256];
-        int existing_port = get_user_port(router->user_cache, username);
-        uint32_t session_key = get_user_session(router->user_cache, username);
         snprintf(response, sizeof(response), 
             "User already logged in\nPort: %d\nSession key: %u\n",
             existing_port, session_key);
-        write(client_fd, response, strlen(response));
+        send_session(client, PROTO_FLAG_EXISTING, existing_port, session_key, response);
         
         return -1;
     }
 
-    // If not logged in, authenticate credentials
-    if (authenticate_user(router->user_db, username, password) == DB_SUCCESS)
+    // If not logged in, authenticate credentials on a worker
+    return submit_db_request(reactor, DB_JOB_AUTH, complete_authentication, client, username, password);
+}
+
+int handle_registration(RouterReactor *reactor, RouterClient *client, const char *username, const char *password)
+{
+    if (!reactor || !client || !username || !password)
+        return -1;
+
+    return submit_db_request(reactor, DB_JOB_REG, complete_registration, client, username, password);
+}
+
+// Move an authenticated client from this reactor to its socket's event loop
+static int handoff_client(RouterReactor *reactor, RouterClient *client, int port, uint32_t session_key)
+{
+    // Bytes pipelined after AUTH belong to the router conversation
+    if (client->closing || frame_parser_pending(&client->parser) > 0)
     {
-        if(handle_new_connection(router, username) == 1) {
-            int new_port = get_user_port(router->user_cache, username);
-            uint32_t session_key = get_user_session(router->user_cache, username);
-            
+        return -1;
+    }
+
+    Socket *sock = socket_directory_port(&reactor->router->directory, port);
+    if (!sock || socket_handoff_client(sock, client->source.fd, session_key) < 0)
+    {
+        printf("Failed to hand off fd %d to socket %d\n", client->source.fd, port);
+        return -1;
+    }
+
+    // The fd now belongs to the socket, nothing is outstanding on it here
+    client->closed = 1;
+    event_loop_release(&reactor->loop, &client->source);
+    return 1;
+}
+
+// The session reply went out, the client either moves to its socket or stays with the router
+static void finish_handoff(RouterReactor *reactor, RouterClient *client)
+{
+    int port = client->handoff_port;
+    client->handoff_port = 0;
+    if (handoff_client(reactor, client, port, client->handoff_key) == 1)
+    {
+        return;
+    }
+    resume_client(reactor, client);
+}
+
+// A job cancelled by the executor, or finished after the reactor stopped, gets no reply:
+// nothing would send it, so the client is closed instead of left busy
+static int close_if_stopped(RouterReactor *reactor, RouterClient *client, const DbJob *job)
+{
+    if (job->result != DB_CANCELLED && reactor->loop.status == EVENT_LOOP_RUNNING)
+        return 0;
+
+    close_router_client(reactor, client);
+    return 1;
+}
+
+// Completion callbacks, run by handle_db_completions on the client's reactor
+static void complete_authentication(DbJob *job)
+{
+    RouterClient *client = (RouterClient *)job->context;
+    RouterReactor *reactor = (RouterReactor *)client->source.owner;
+    Router *router = reactor->router;
+
+    if (close_if_stopped(reactor, client, job))
+        return;
+
+    metrics_inc(job->result == DB_SUCCESS ? METRIC_AUTH_SUCCESS : METRIC_AUTH_FAILURE);
+    if (job->result == DB_SUCCESS)
+    {
+        int new_port = -1;
+        uint32_t session_key = 0;
+
+        // Another AUTH for the same user may have finished first, on any reactor;
+        // add_user is atomic so exactly one of them wins
+        int assigned = handle_new_connection(router, job->username);
+        if (assigned == 1)
+        {
+            new_port = get_user_port(router->user_cache, job->username);
+            session_key = get_user_session(router->user_cache, job->username);
+        }
+
+        if (assigned == 0)
+        {
+            send_reply(client, PROTO_OP_ERROR, "User already logged in\n");
+            resume_client(reactor, client);
+            return;
+        }
+
+        if(assigned == 1) {
             char response[256];
             snprintf(response, sizeof(response), 
                 "Authentication successful\nAssigned to port: %d\nSession key: %u\n",
                 new_port, session_key);
-            write(client_fd, response, strlen(response));
+            send_session(client, 0, new_port, session_key, response);
             
             printf("Successfully authenticated and handled new user to a socket\n");
-            return 1;
+            // Still busy: once the reply is sent the fd goes straight to its socket
+            if (router->config.fd_handoff)
+            {
+                client->handoff_port = new_port;
+                client->handoff_key = session_key;
+                return;
+            }
+            resume_client(reactor, client);
+            return;
         }
-        char error[] = "Authentication successful but failed to assign port\n";
-        write(client_fd, error, strlen(error));
-        return -1;
+        send_reply(client, PROTO_OP_ERROR, "Authentication successful but failed to assign port\n");
+        resume_client(reactor, client);
     }
     else
     {
-        char response[] = "Authentication failed: Invalid username or password\n";
-        write(client_fd, response, strlen(response));
-        close(client_fd);
-        return -1;
+        send_reply(client, PROTO_OP_ERROR, "Authentication failed: Invalid username or password\n");
+        // Closed as soon as the reply is out
+        client->closing = 1;
+        resume_client(reactor, client);
     }
 }
 
-int handle_registration(Router *router, int client_fd, const char *username, const char *password)
+static void complete_registration(DbJob *job)
 {
-    if (!router || !username || !password)
-        return -1;
+    RouterClient *client = (RouterClient *)job->context;
+    RouterReactor *reactor = (RouterReactor *)client->source.owner;
+
+    if (close_if_stopped(reactor, client, job))
+        return;
 
-    if (create_user(router->user_db, username, password) == DB_SUCCESS)
+    metrics_inc(job->result == DB_SUCCESS ? METRIC_REGISTER_SUCCESS : METRIC_REGISTER_FAILURE);
+    if (job->result == DB_SUCCESS)
     {
-        char response[] = "Registration successful\n";
-        write(client_fd, response, strlen(response));
-        return 1;
+        send_reply(client, PROTO_OP_OK, "Registration successful\n");
     }
     else
     {
-        char response[] = "Registration failed\n";
-        write(client_fd, response, strlen(response));
-        return -1;
+        send_reply(client, PROTO_OP_ERROR, "Registration failed\n");
     }
+    resume_client(reactor, client);
+}
+
+void handle_db_completions(RouterReactor *reactor)
+{
+    drain_db_completions(&reactor->db_completions);
 }
 
-void *router_socket_thread(Router *router)
+// One request from a router client, binary frame or compat text line
+static void handle_client_frame(RouterReactor *reactor, RouterClient *client, const Frame *frame)
 {
-    struct epoll_event events[MAX_EVENTS];
+    char username[32];
+    char password[64];
 
-    while (router->socket.status == SOCKET_STATUS_ACTIVE)
+    if (frame->opcode == PROTO_OP_TEXT)
     {
-        int nfds = epoll_wait(router->socket.epoll_fd, events, MAX_EVENTS, EPOLL_TIMEOUT);
+        char line[128];
+        char command[5];
+        size_t length = frame->length < sizeof(line) - 1 ? frame->length : sizeof(line) - 1;
+        memcpy(line, frame->payload, length);
+        line[length] = '\0';
 
-        if (nfds < 0)
+        if (sscanf(line, "%4s %31s %63s", command, username, password) != 3)
         {
-            if (errno == EINTR)
-                continue;
-            router->socket.status = SOCKET_STATUS_ERROR;
-            break;
+            send_reply(client, PROTO_OP_ERROR, "Invalid command format. Use: AUTH username password or REG username password\n");
         }
-
-        for (int i = 0; i < nfds; i++)
+        else if (strcmp(command, "AUTH") == 0)
         {
-            if (events[i].data.fd == router->socket.socket_fd)
-            {
-                // Accept new connection
-                struct sockaddr_in client_addr;
-                socklen_t client_len = sizeof(client_addr);
-
-                int client_fd = accept(router->socket.socket_fd,
-                                       (struct sockaddr *)&client_addr,
-                                       &client_len);
-
-                if (client_fd < 0)
-                {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK)
-                    {
-                        break;
-                    }
-                    continue;
-                }
-
-                // Set socket to non-blocking
-                int flags = fcntl(client_fd, F_GETFL, 0);
-                fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
-
-                // Add new client to epoll
-                struct epoll_event ev;
-                ev.events = EPOLLIN;
-                ev.data.fd = client_fd;
-                if (epoll_ctl(router->socket.epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0)
-                {
-                    printf("Failed to add client to epoll\n");
-                    close(client_fd);
-                    continue;
-                }
-
-                printf("[Router] New connection from %s:%d (fd: %d)\n",
-                       inet_ntoa(client_addr.sin_addr),
-                       ntohs(client_addr.sin_port),
-                       client_fd);
-
-                router->socket.connections_handled++;
-            }
-            else
-            {
-                // Handle data from clients
-                int client_fd = events[i].data.fd;
-                char buffer[1024];
-                ssize_t bytes_read = read(client_fd, buffer, sizeof(buffer) - 1);
-
-                if (bytes_read > 0)
-                {
-                    buffer[bytes_read] = '\0';
-
-                    char command[5];
-                    char username[32];
-                    char password[64];
-
-                    if (sscanf(buffer, "%4s %31s %63s", command, username, password) == 3)
-                    {
-                        if (strcmp(command, "AUTH") == 0)
-                        {
-                            handle_authentication(router, client_fd, username, password);
-                        }
-                        else if (strcmp(command, "REG") == 0)
-                        {
-                            handle_registration(router, client_fd, username, password);
-                        }
-                        else
-                        {
-                            char response[] = "Unknown command\n";
-                            write(client_fd, response, strlen(response));
-                        }
-                    }
-                    else
-                    {
-                        char response[] = "Invalid command format. Use: AUTH username password or REG username password\n";
-                        write(client_fd, response, strlen(response));
-                    }
-                }
-                else if (bytes_read == 0)
-                {
-                    // Client disconnected
-                    printf("[Router] Client on fd %d disconnected\n", client_fd);
-                    epoll_ctl(router->socket.epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-                    close(client_fd);
-                }
-            }
+            handle_authentication(reactor, client, username, password);
+        }
+        else if (strcmp(command, "REG") == 0)
+        {
+            handle_registration(reactor, client, username, password);
+        }
+        else
+        {
+            send_reply(client, PROTO_OP_ERROR, "Unknown command\n");
         }
+        memset(password, 0, sizeof(password));
+        return;
+    }
+
+    if (frame->opcode != PROTO_OP_AUTH && frame->opcode != PROTO_OP_REG)
+    {
+        send_reply(client, PROTO_OP_ERROR, "Unknown command\n");
+        return;
+    }
+
+    if (proto_parse_credentials(frame, username, sizeof(username), password, sizeof(password)) < 0)
+    {
+        send_reply(client, PROTO_OP_ERROR, "Invalid credentials payload\n");
+        return;
+    }
+
+    if (frame->opcode == PROTO_OP_AUTH)
+    {
+        handle_authentication(reactor, client, username, password);
+    }
+    else
+    {
+        handle_registration(reactor, client, username, password);
+    }
+    memset(password, 0, sizeof(password));
+}
+
+// Run every complete request in the buffer, pausing at one that went to an auth worker
+// or when replies back up; the caller syncs the client afterwards
+static void process_client_frames(RouterReactor *reactor, RouterClient *client)
+{
+    Frame frame;
+    int result = 0;
+
+    while (!client->busy && !client->closing && !client->paused &&
+           (result = frame_parser_next(&client->parser, &frame)) == 1)
+    {
+        handle_client_frame(reactor, client, &frame);
+        update_client_backpressure(reactor, client);
+    }
+
+    if (result < 0)
+    {
+        send_reply(client, PROTO_OP_ERROR, "Malformed request\n");
+        printf("[Router %d] Dropping fd %d after a malformed request\n", reactor->index, client->source.fd);
+        client->closing = 1;
+    }
+}
+
+static void router_recv_handler(EventSource *source, ssize_t result)
+{
+    RouterClient *client = (RouterClient *)source;
+    RouterReactor *reactor = (RouterReactor *)source->owner;
+
+    client->receiving = 0;
+    if (client->closed)
+        return;
+    if (result <= 0)
+    {
+        // Client disconnected
+        printf("[Router %d] Client on fd %d disconnected\n", reactor->index, source->fd);
+        close_router_client(reactor, client);
+        return;
+    }
+
+    frame_parser_commit(&client->parser, (size_t)result);
+    process_client_frames(reactor, client);
+    sync_router_client(reactor, client);
+}
+
+static void router_send_handler(EventSource *source, ssize_t result)
+{
+    RouterClient *client = (RouterClient *)source;
+    RouterReactor *reactor = (RouterReactor *)source->owner;
+
+    client->sending = 0;
+    if (client->closed)
+        return;
+    if (result < 0)
+    {
+        drop_router_client(reactor, client);
+        return;
     }
 
-    return NULL;
+    ring_consume(&client->out, (uint32_t)result);
+    reactor->loop.egress.bytes += (uint64_t)result;
+    if (ring_used(&client->out) > 0)
+    {
+        flush_router_client(reactor, client);
+    }
+    else if (client->handoff_port)
+    {
+        finish_handoff(reactor, client);
+        return;
+    }
+
+    // Requests held back while replies drained
+    update_client_backpressure(reactor, client);
+    process_client_frames(reactor, client);
+    sync_router_client(reactor, client);
+}
+
+static void router_accept_handler(EventSource *source, int client_fd)
+{
+    RouterReactor *reactor = (RouterReactor *)source->owner;
+
+    RouterClient *client = create_router_client(reactor, client_fd);
+    if (!client)
+    {
+        printf("Failed to allocate router client\n");
+        close(client_fd);
+        return;
+    }
+
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    memset(&client_addr, 0, sizeof(client_addr));
+    getpeername(client_fd, (struct sockaddr *)&client_addr, &client_len);
+    printf("[Router %d] New connection from %s:%d (fd: %d)\n",
+           reactor->index,
+           inet_ntoa(client_addr.sin_addr),
+           ntohs(client_addr.sin_port),
+           client_fd);
+
+    reactor->socket.connections_handled++;
+    metrics_inc(METRIC_ROUTER_ACCEPTS);
+    sync_router_client(reactor, client);
+}
+
+static void router_completion_handler(EventSource *source, uint32_t events)
+{
+    (void)events;
+    handle_db_completions((RouterReactor *)source->owner);
+}
+
+void *router_socket_thread(RouterReactor *reactor)
+{
+    char name[METRICS_NAME_LENGTH];
+    snprintf(name, sizeof(name), "router-%d", reactor->index);
+    metrics_thread_register(name);
+    return event_loop_run(&reactor->loop);
+}
+
+// Close a reactor's descriptors (listener, completion eventfd) and its loop
+static void close_router_reactor(RouterReactor *reactor)
+{
+    if (reactor->db_completions.event_fd >= 0)
+    {
+        // Jobs answered or cancelled after the reactor stopped still close their clients
+        drain_db_completions(&reactor->db_completions);
+        destroy_db_completion_queue(&reactor->db_completions);
+    }
+    if (reactor->socket.socket_fd >= 0)
+    {
+        close(reactor->socket.socket_fd);
+        reactor->socket.socket_fd = -1;
+    }
+    event_loop_destroy(&reactor->loop);
+}
+
+// Bind the reactor's listener and wire it and its completion queue into the reactor's loop
+static int start_router_reactor(RouterReactor *reactor)
+{
+    if (event_loop_init(&reactor->loop, reactor->index, reactor->router->io, 0) < 0)
+    {
+        printf("Failed to set up the event loop of router reactor %d\n", reactor->index);
+        return -1;
+    }
+
+    if (start_router_socket(&reactor->socket) < 0)
+    { // Added error checking
+        printf("Failed to start router socket %d\n", reactor->index);
+        close_router_reactor(reactor);
+        return -1;
+    }
+
+    // DB workers post finished jobs to an eventfd the reactor thread watches
+    if (init_db_completion_queue(&reactor->db_completions) < 0)
+    {
+        close_router_reactor(reactor);
+        return -1;
+    }
+
+    event_source_init(&reactor->completion_source, reactor->db_completions.event_fd,
+                      router_completion_handler, reactor);
+    if (event_loop_add(&reactor->loop, &reactor->completion_source, EPOLLIN) < 0)
+    {
+        close_router_reactor(reactor);
+        return -1;
+    }
+
+    event_source_init(&reactor->listener_source, reactor->socket.socket_fd, NULL, reactor);
+    reactor->listener_source.on_accept = router_accept_handler;
+    if (event_loop_accept(&reactor->loop, &reactor->listener_source) < 0)
+    {
+        close_router_reactor(reactor);
+        return -1;
+    }
+
+    return 1;
 }
 
 int start_router(Router *router)
@@ -328,39 +941,62 @@ int start_router(Router *router)
     if (!router)
         return -1;
 
-    printf("Start the main socket");
-    SocketConfig main_socket_cfg = create_default_socket_config();
-
-    // Create and start router socket
-    RouterSocket r_socket = create_router_socket(main_socket_cfg, MAIN_SOCKET_PORT);
-    if (start_router_socket(&r_socket) < 0)
-    { // Added error checking
-        printf("Failed to start main socket\n");
+    if (start_db_executor(router->db_executor) < 0)
+    {
+        printf("Failed to start DB workers\n");
         return -1;
     }
 
-    router->socket = r_socket;
-    // Create thread for router socket handling
-    if (pthread_create(&router->main_socket_thread, NULL,
-                       (void *(*)(void *))router_socket_thread, router) != 0)
+    printf("Start the main sockets (%d reactors)\n", router->num_reactors);
+    for (int i = 0; i < router->num_reactors; i++)
     {
-        printf("Failed to create router socket thread\n");
-        // Should clean up the socket here
-        close(router->socket.socket_fd);
-        close(router->socket.epoll_fd);
-        return -1;
+        RouterReactor *reactor = &router->reactors[i];
+        if (start_router_reactor(reactor) < 0)
+        {
+            return -1;
+        }
+
+        // Create thread for router socket handling
+        reactor->loop.status = EVENT_LOOP_RUNNING;
+        if (pthread_create(&reactor->loop.thread, NULL,
+                           (void *(*)(void *))router_socket_thread, reactor) != 0)
+        {
+            printf("Failed to create router socket thread %d\n", i);
+            reactor->loop.status = EVENT_LOOP_ERROR;
+            reactor->socket.status = SOCKET_STATUS_ERROR;
+            close_router_reactor(reactor);
+            return -1;
+        }
     }
 
     /* This needs more implementation (will be done later)*/
     for (int i = 0; i < router->num_buckets; i++)
     {
         printf("\nStarting bucket %d:\n", (i + 1));
-        if (start_socketpool(&router->socket_pool[i]) < 1)
+        if (start_socketpool(&router->socket_pool[i], router->event_loops) < 1)
         {
             return -1; // error
         }
     }
 
+    // Room mailboxes go on the loops before their threads start
+    if (router->directory.rooms && start_room_hub(router->directory.rooms) < 0)
+    {
+        return -1;
+    }
+
+    if (start_event_loop_pool(router->event_loops) < 0)
+    {
+        printf("Failed to start event loops\n");
+        return -1;
+    }
+
+    // Observability only, the server runs without it
+    if (router->config.metrics_port > 0 || router->config.metrics_path[0])
+    {
+        router->admin = start_admin_server(router, router->config.metrics_port, router->config.metrics_path);
+    }
+
     return 1;
 }
 
@@ -371,34 +1007,71 @@ void shut_down_router(Router *router)
 
     printf("\nInitiating router shutdown...\n");
 
-    // First shut down the main router socket
-    router->socket.status = SOCKET_STATUS_UNUSED; // Signal thread to stop
+    // Scrapes read sockets and placement, stop them before anything is torn down
+    stop_admin_server(router->admin);
+    router->admin = NULL;
 
-    // Wait for router thread to complete
-    if (router->main_socket_thread)
+    // First signal every reactor to stop, then wait for them
+    for (int i = 0; i < router->num_reactors; i++)
     {
-        pthread_join(router->main_socket_thread, NULL);
-        printf("Router main socket thread terminated\n");
+        if (router->reactors[i].loop.status == EVENT_LOOP_RUNNING)
+        {
+            router->reactors[i].loop.status = EVENT_LOOP_STOPPED;
+        }
+        if (router->reactors[i].socket.status == SOCKET_STATUS_ACTIVE)
+        {
+            router->reactors[i].socket.status = SOCKET_STATUS_UNUSED;
+        }
     }
 
-    // Close router socket file descriptors
-    if (router->socket.epoll_fd >= 0)
+    for (int i = 0; i < router->num_reactors; i++)
     {
-        close(router->socket.epoll_fd);
-        router->socket.epoll_fd = -1;
+        if (router->reactors[i].loop.thread)
+        {
+            pthread_join(router->reactors[i].loop.thread, NULL);
+            router->reactors[i].loop.thread = 0;
+        }
+        event_loop_report(&router->reactors[i].loop, "Router reactor");
     }
-    if (router->socket.socket_fd >= 0)
+    printf("Router reactor threads terminated\n");
+
+    // Stop the DB workers before their completion queues go away
+    if (router->db_executor)
     {
-        close(router->socket.socket_fd);
-        router->socket.socket_fd = -1;
+        shut_down_db_executor(router->db_executor);
+        router->db_executor = NULL;
     }
 
+    // Close router socket file descriptors
+    for (int i = 0; i < router->num_reactors; i++)
+    {
+        close_router_reactor(&router->reactors[i]);
+    }
+    free(router->reactors);
+    router->reactors = NULL;
+    router->num_reactors = 0;
+
+    // Stop the user socket loops before their sockets are torn down; their backends go
+    // first too, so no receive still in flight can land in a block the sockets give back
+    stop_event_loop_pool(router->event_loops);
+    destroy_event_loop_pool(router->event_loops);
+    router->event_loops = NULL;
+
+    // Frames still queued on client outputs hold their own references
+    destroy_room_hub(router->directory.rooms);
+    router->directory.rooms = NULL;
+
     // Shutdown all socket pools in each bucket
     for (int i = 0; i < router->num_buckets; i++)
     {
         printf("Shutting down socket pool bucket %d\n", i + 1);
         delete_socketpool(&router->socket_pool[i]);
     }
+    free(router->socket_pool);
+    router->socket_pool = NULL;
+
+    destroy_buffer_pool(router->buffers);
+    router->buffers = NULL;
 
     if (router->user_cache)
     {
@@ -406,11 +1079,22 @@ void shut_down_router(Router *router)
         router->user_cache = NULL;
     }
 
-    if (router->bucket_status)
-    {
-        free(router->bucket_status);
-        router->bucket_status = NULL;
-    }
+    free(router->directory.by_port);
+    router->directory.by_port = NULL;
+
+    destroy_placement(router->placement);
+    router->placement = NULL;
+
+    metrics_report();
+    latency_report();
+
+    // Last: sockets, rooms and reactors above gave their objects back
+    destroy_slab_cache(router->client_slab);
+    router->client_slab = NULL;
+    destroy_slab_cache(router->job_slab);
+    router->job_slab = NULL;
+    destroy_slab_classes(router->slabs);
+    router->slabs = NULL;
 
     printf("Router shutdown complete\n");
 }
@@ -420,12 +1104,19 @@ int handle_new_connection(Router *router, const char *username)
     // create the session key for the user
     uint32_t session_key = generate_session_key();
     printf("session key generated: %u\n", session_key);
-    int port_number = assign_user_socket(router, session_key);
+    int entry, slot;
+    int port_number = reserve_user_slot(router, username, session_key, &entry, &slot);
     if(port_number == -1){
         printf("could not assign user a socket....");
         return -1;
     }
 
-    add_user(router->user_cache, username, port_number, session_key);
+    // Lost the race to another login for the same user, give the slot back
+    if (add_user(router->user_cache, username, port_number, session_key) == -1)
+    {
+        release_socket_slot(router->placement->entries[entry].sock, slot);
+        placement_release(router->placement, entry);
+        return 0;
+    }
     return 1;
 }
\ No newline at end of file
@@ -17,8 +17,10 @@ int main() {
     // Ensure data directory exists
     ensure_data_directory();
 
-    // Initialize database
-    UserDB* user_db = init_user_db(DEFAULT_DB_PATH);
+    // Initialize database, a connection per auth worker
+    UserDBConfig db_config = default_user_db_config();
+    db_config.connections = AUTH_WORKER_THREADS;
+    UserDB* user_db = open_user_db(DEFAULT_DB_PATH, &db_config);
     if (!user_db) {
         printf("Failed to initialize database, exiting...\n");
         return 1;
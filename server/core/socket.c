@@ -1,9 +1,16 @@
 
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include "server/socket.h"
+#include "server/room.h"
+#include "server/metrics.h"
+#include "server/latency.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 
 
 /* Socket configuration defaults */
@@ -16,6 +23,15 @@
 #define SOCKET_STATUS_ACTIVE 1
 #define SOCKET_STATUS_ERROR  2
 
+/* Socket stats have one writer, the loop thread: a plain add, stored untorn for readers */
+#define STAT_ADD(field, amount) __atomic_store_n(&(field), (field) + (amount), __ATOMIC_RELAXED)
+
+
+static void slot_timer_handler(TimerNode* timer);
+static void client_flush_handler(FlushNode* node);
+static void client_recv_handler(EventSource* source, ssize_t result);
+static void client_send_handler(EventSource* source, ssize_t result);
+static void client_closed_handler(EventSource* source, ssize_t result);
 
 /* Function declarations */
 
@@ -30,11 +46,27 @@ SocketConfig create_default_socket_config(void){
         DEFAULT_BACKLOG,
         1,
         1,
+        0,
+        1,
+        DEFAULT_WRITE_HIGH_WATER,
     };
 
     return scf;
 }
 
+size_t socket_buffer_block_size(const SocketConfig* config) {
+    size_t needed = PROTO_BUFFER_SIZE;
+    if ((size_t)config->recv_buffer_size > needed) needed = (size_t)config->recv_buffer_size;
+    if ((size_t)config->send_buffer_size > needed) needed = (size_t)config->send_buffer_size;
+
+    // The output ring masks offsets, so keep it a power of 2
+    size_t size = 1;
+    while (size < needed) {
+        size <<= 1;
+    }
+    return size;
+}
+
 Socket create_socket(const SocketInitInfo socket_init_info){
     /*
     * Client Connection default
@@ -48,60 +80,85 @@ Socket create_socket(const SocketInitInfo socket_init_info){
     }
 
     for(int i = 0; i < socket_init_info.max_connections; i++){
+        event_source_init(&clients[i].source, -1, NULL, NULL); // Not registered with a loop
         clients[i].fd = -1;                 // No file descriptor
+        clients[i].state = SLOT_FREE;
         clients[i].session_key = 0;         // No session key
         clients[i].last_active = 0;         // No activity
+        clients[i].owner[0] = '\0';
+        clients[i].parser.data = NULL;      // Pool blocks while connected
+        memset(&clients[i].out, 0, sizeof(OutputQueue));
+        clients[i].num_rooms = 0;
+        clients[i].receiving = 0;
+        clients[i].sending = 0;
+        clients[i].paused = 0;
+        timer_init(&clients[i].timer, slot_timer_handler, &clients[i]);
+        event_loop_flush_init(&clients[i].flush, client_flush_handler, &clients[i]);
     }
     /*
     * Connection manager intialization
     */
 
+    // Session index at most half full keeps probe sequences short
+    int index_size = 1;
+    while (index_size < socket_init_info.max_connections * 2) {
+        index_size <<= 1;
+    }
+
+    int* free_slots = (int*) malloc(sizeof(int) * socket_init_info.max_connections);
+    int* session_index = (int*) malloc(sizeof(int) * index_size);
+    if (!free_slots || !session_index) {
+        printf("Unsuccessful allocation of memory for slot indexes\n");
+        free(clients);
+        free(free_slots);
+        free(session_index);
+        Socket error_socket = {0};  // Zero initialize all fields
+        error_socket.status = SOCKET_STATUS_ERROR;
+        return error_socket /* error socket */;
+    }
+
+    // Lowest slot on top of the stack
+    for (int i = 0; i < socket_init_info.max_connections; i++) {
+        free_slots[i] = socket_init_info.max_connections - 1 - i;
+    }
+    for (int i = 0; i < index_size; i++) {
+        session_index[i] = -1;
+    }
+
     ConnectionManager cmgr = {
-        -1,                              // epoll_fd (-1 until started)
         clients,                      // Array for client FDs
         socket_init_info.max_connections, // Max connections allowed
         0,                              // Currently no established connections
+        free_slots,
+        socket_init_info.max_connections, // Every slot starts free
+        session_index,
+        index_size - 1,
+        PTHREAD_MUTEX_INITIALIZER,
     };
 
-    // Allocate arrays based on port count
-unsigned long* bytes_sent = (unsigned long*) malloc(sizeof(unsigned long) * socket_init_info.max_connections);
-unsigned long* bytes_received = (unsigned long*) malloc(sizeof(unsigned long) * socket_init_info.max_connections);
-time_t* last_active = (time_t*) malloc(sizeof(time_t) * socket_init_info.max_connections);
-
-if (!bytes_sent || !bytes_received || !last_active) {
-    // Handle error - free any successful allocations
-    free(clients);
-    free(bytes_sent);
-    free(bytes_received);
-    free(last_active);
-    Socket error_socket = {0};  // Zero initialize all fields
-        error_socket.status = SOCKET_STATUS_ERROR;
-        return error_socket /* error socket */;
-}
-
-// Initialize all statistics to 0/inactive
-for(int i = 0; i < socket_init_info.max_connections; i++) {
-    bytes_sent[i] = 0;
-    bytes_received[i] = 0;
-    last_active[i] = 0;  // 0 timestamp indicates never active
-}
-
-SocketStats stats = {
-    bytes_sent,
-    bytes_received,
-    0,                    // No active connections initially
-    last_active
-};
+    // All counters start at 0, last_active 0 means never active
+    SocketStats stats = {0};
 
 Socket socket = {
     socket_init_info.config,   // config                    
     cmgr,                      // conns
     stats,                     // stats
-    0,                         // thread_id
+    { -1, PTHREAD_MUTEX_INITIALIZER, NULL, NULL }, // commands (eventfd created on start)
+    socket_init_info.buffers,  // buffers
+    socket_init_info.slabs,    // slabs
+    NULL,                      // loop (attached on start)
+    { -1, NULL, NULL, NULL, NULL, NULL, NULL, {0} }, // listener_source
+    { -1, NULL, NULL, NULL, NULL, NULL, NULL, {0} }, // command_source
+    { { NULL, NULL, { NULL } }, -1, 0, 0, 0 }, // mailbox (queue and eventfd set up on start)
+    { -1, NULL, NULL, NULL, NULL, NULL, NULL, {0} }, // mailbox_source
+    NULL,                      // directory (set by the router)
     socket_init_info.port_number,
     -1,                        // socket_fd
     SOCKET_STATUS_UNUSED,       // status
-    SOCKET_ERROR_NONE
+    SOCKET_ERROR_NONE,
+    NULL,                      // on_slot_expired
+    NULL,                      // slot_expired_ctx
+    -1                         // placement_entry (set by the router)
 };
 
 return socket;
@@ -114,7 +171,6 @@ RouterSocket create_router_socket(const SocketConfig config, int port) {
     // Set initial values
     router_socket.config = config;
     router_socket.socket_fd = -1;      // Not started yet
-    router_socket.epoll_fd = -1;       // Not created yet
     router_socket.thread_id = 0;       // No thread yet
     router_socket.port = port;
     router_socket.status = SOCKET_STATUS_UNUSED;
@@ -123,121 +179,866 @@ RouterSocket create_router_socket(const SocketConfig config, int port) {
     return router_socket;
 }
 
-void* socket_thread_function(void* arg) {
-    Socket* sock = (Socket*)arg;
-    struct epoll_event events[MAX_EVENTS];
+/*
+ * A connection accepted on a socket's own port that has not sent its session key yet
+ * Lives in the loop until the 4 key bytes arrive
+ */
+typedef struct {
+    EventSource source;     /* owner = this handshake */
+    TimerNode timer;        /* Dropped if the key does not arrive in HANDSHAKE_TIMEOUT */
+    Socket* sock;
+    uint32_t key;
+    size_t received;
+    uint64_t accepted_at;   /* Loop wakeup (ns) that accepted it, for LATENCY_SESSION */
+} PendingHandshake;
+
+static int send_to_client(Socket* sock, ClientConnection* conn, const struct iovec* iov, int iovcnt);
+
+static inline uint32_t session_hash(uint32_t session_key) {
+    // Keys are random already, the multiply just spreads low-entropy test keys
+    return session_key * 2654435761u;
+}
+
+// Find the index position holding session_key, or -1 (conns.lock held)
+static int session_index_find(ConnectionManager* conns, uint32_t session_key) {
+    uint32_t pos = session_hash(session_key) & conns->session_mask;
+    while (conns->session_index[pos] != -1) {
+        if (conns->clients[conns->session_index[pos]].session_key == session_key) {
+            return (int)pos;
+        }
+        pos = (pos + 1) & conns->session_mask;
+    }
+    return -1;
+}
+
+static void session_index_insert(ConnectionManager* conns, uint32_t session_key, int slot) {
+    uint32_t pos = session_hash(session_key) & conns->session_mask;
+    while (conns->session_index[pos] != -1) {
+        pos = (pos + 1) & conns->session_mask;
+    }
+    conns->session_index[pos] = slot;
+}
+
+// Linear probing delete: shift later entries back so lookups never hit a hole early
+static void session_index_erase(ConnectionManager* conns, int pos) {
+    uint32_t mask = conns->session_mask;
+    uint32_t hole = pos;
+    uint32_t next = (hole + 1) & mask;
+
+    while (conns->session_index[next] != -1) {
+        int slot = conns->session_index[next];
+        uint32_t home = session_hash(conns->clients[slot].session_key) & mask;
+        // Move the entry if its home is not inside (hole, next]
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            conns->session_index[hole] = slot;
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    conns->session_index[hole] = -1;
+}
+
+static int post_socket_command(Socket* sock, SocketCommand* cmd);
+
+int reserve_socket_slot(Socket* sock, uint32_t session_key, const char* owner) {
+    if (!sock || session_key == 0) return -1;
+
+    ConnectionManager* conns = &sock->conns;
+    int slot = -1;
+
+    pthread_mutex_lock(&conns->lock);
+    if (conns->free_count > 0 && session_index_find(conns, session_key) == -1) {
+        slot = conns->free_slots[--conns->free_count];
+        ClientConnection* conn = &conns->clients[slot];
+        conn->session_key = session_key;
+        conn->state = SLOT_RESERVED;
+        conn->last_active = (time_t)event_loop_clock_ms();
+        conn->owner[0] = '\0';
+        if (owner) {
+            strncpy(conn->owner, owner, SLOT_OWNER_LENGTH - 1);
+            conn->owner[SLOT_OWNER_LENGTH - 1] = '\0';
+        }
+        session_index_insert(conns, session_key, slot);
+    }
+    pthread_mutex_unlock(&conns->lock);
+
+    // Timers belong to the loop thread, ask it to start the reservation deadline
+    if (slot >= 0 && sock->status == SOCKET_STATUS_ACTIVE) {
+        SocketCommand* cmd = (SocketCommand*)slab_alloc_size(sock->slabs, sizeof(SocketCommand));
+        if (cmd) {
+            cmd->type = SOCKET_CMD_RESERVE;
+            cmd->fd = -1;
+            cmd->session_key = session_key;
+            cmd->slot = slot;
+            post_socket_command(sock, cmd);
+        }
+    }
+
+    return slot;
+}
+
+// Reserved slot back to the free list (conns.lock held)
+static void free_reserved_slot(ConnectionManager* conns, int slot) {
+    ClientConnection* conn = &conns->clients[slot];
+    int pos = session_index_find(conns, conn->session_key);
+    if (pos >= 0) {
+        session_index_erase(conns, pos);
+    }
+    conn->session_key = 0;
+    conn->state = SLOT_FREE;
+    conns->free_slots[conns->free_count++] = slot;
+}
+
+int release_socket_slot(Socket* sock, int slot) {
+    if (!sock || slot < 0 || slot >= sock->conns.max_connections) return -1;
+
+    ConnectionManager* conns = &sock->conns;
+    int result = -1;
+
+    // A pending timer finds the slot free or re-reserved and leaves it alone
+    pthread_mutex_lock(&conns->lock);
+    if (conns->clients[slot].state == SLOT_RESERVED) {
+        free_reserved_slot(conns, slot);
+        result = 1;
+    }
+    pthread_mutex_unlock(&conns->lock);
+
+    return result;
+}
+
+// Input and output blocks for a connecting client, from the shared pool
+static int attach_client_buffers(Socket* sock, ClientConnection* conn) {
+    size_t block_size = sock->buffers->block_size;
+    uint8_t* input = (uint8_t*)buffer_pool_get(sock->buffers);
+    uint8_t* output = (uint8_t*)buffer_pool_get(sock->buffers);
+    if (!input || !output) {
+        buffer_pool_put(sock->buffers, input);
+        buffer_pool_put(sock->buffers, output);
+        return -1;
+    }
+
+    frame_parser_init(&conn->parser, input, block_size, PROTO_MODE_RAW);
+    output_init(&conn->out, output, (uint32_t)block_size);
+    return 1;
+}
+
+static void release_client_buffers(Socket* sock, ClientConnection* conn) {
+    metrics_add(METRIC_OUTPUT_QUEUE, -(int64_t)output_used(&conn->out));
+    output_reset(&conn->out);
+    buffer_pool_put(sock->buffers, conn->parser.data);
+    buffer_pool_put(sock->buffers, conn->out.ring.data);
+    conn->parser.data = NULL;
+    conn->out.ring.data = NULL;
+}
+
+// Receive into the free end of the input buffer, unless paused or already receiving
+static int arm_client_recv(Socket* sock, ClientConnection* conn) {
+    if (conn->receiving || conn->paused) return 1;
+
+    size_t space;
+    uint8_t* buffer = frame_parser_space(&conn->parser, &space);
+    if (space == 0) return -1;  // Buffer full without a complete message
+    if (event_loop_recv(sock->loop, &conn->source, buffer, space) < 0) return -1;
+    conn->receiving = 1;
+    return 1;
+}
+
+// Bind a client fd to the slot reserved for its session key and start receiving
+// arrived_at: when the connection reached this socket (ns), for LATENCY_SESSION
+static int claim_session_slot(Socket* sock, int client_fd, uint32_t session_key, uint64_t arrived_at) {
+    // Look up the reservation and mark it connected in one step
+    int slot = -1;
+    pthread_mutex_lock(&sock->conns.lock);
+    int pos = session_index_find(&sock->conns, session_key);
+    if (pos >= 0 && sock->conns.clients[sock->conns.session_index[pos]].state == SLOT_RESERVED) {
+        slot = sock->conns.session_index[pos];
+        sock->conns.clients[slot].state = SLOT_CONNECTED;
+    }
+    pthread_mutex_unlock(&sock->conns.lock);
+
+    if (slot == -1) {
+        metrics_inc(METRIC_SESSION_REJECTS);
+        char response[] = "Invalid session key\n";
+        write(client_fd, response, strlen(response));
+        return -1;
+    }
+
+    // The connection is a stream on the socket's loop, completions carry the connection itself
+    ClientConnection* conn = &sock->conns.clients[slot];
+    event_source_init(&conn->source, client_fd, NULL, sock);
+    conn->source.on_recv = client_recv_handler;
+    conn->source.on_send = client_send_handler;
+    conn->source.on_close = client_closed_handler;
+    conn->receiving = 0;
+    conn->sending = 0;
+    conn->paused = 0;
+    if (attach_client_buffers(sock, conn) < 0 || arm_client_recv(sock, conn) < 0) {
+        release_client_buffers(sock, conn);
+        conn->source.fd = -1;
+        pthread_mutex_lock(&sock->conns.lock);
+        conn->state = SLOT_RESERVED;
+        pthread_mutex_unlock(&sock->conns.lock);
+        return -1;
+    }
+
+    // Update client slot
+    conn->fd = client_fd;
+    conn->last_active = (time_t)sock->loop->now;
+    sock->conns.current_connections++;
+    STAT_ADD(sock->stats.connects, 1);
+    STAT_ADD(sock->stats.active_connections, 1);
+    metrics_inc(METRIC_SOCKET_CONNECTS);
+    metrics_inc(METRIC_CONNECTIONS);
+    latency_record(LATENCY_SESSION, event_loop_clock_ns() - arrived_at);
+    event_loop_schedule(sock->loop, &conn->timer, CONNECTION_TIMEOUT * 1000ULL);
+
+    char response[] = "Connection accepted\n";
+    struct iovec iov = { response, strlen(response) };
+    send_to_client(sock, conn, &iov, 1);
+    return 1;
+}
+
+// The fd closes now, the slot is reserved again once the loop confirms nothing still uses its buffers
+static void close_client(Socket* sock, ClientConnection* conn) {
+    if (conn->fd < 0) return;
+
+    if (conn->num_rooms > 0) {
+        room_leave_all(room_shard_for(sock->directory->rooms, sock->loop), conn);
+    }
+    event_loop_close(sock->loop, &conn->source);
+    conn->fd = -1;
+    sock->conns.current_connections--;
+    STAT_ADD(sock->stats.active_connections, -1);
+    metrics_add(METRIC_CONNECTIONS, -1);
+}
+
+// The client can reconnect with the same session key until the reservation expires
+static void client_closed_handler(EventSource* source, ssize_t result) {
+    ClientConnection* conn = (ClientConnection*)source;
+    Socket* sock = (Socket*)source->owner;
+    (void)result;
+
+    source->fd = -1;
+    conn->receiving = 0;
+    conn->sending = 0;
+    release_client_buffers(sock, conn);
+
+    pthread_mutex_lock(&sock->conns.lock);
+    conn->state = SLOT_RESERVED;
+    conn->last_active = (time_t)sock->loop->now;
+    pthread_mutex_unlock(&sock->conns.lock);
+
+    event_loop_schedule(sock->loop, &conn->timer, SESSION_RESERVE_TIMEOUT * 1000ULL);
+}
+
+/*
+ * Deadline of a slot: idle eviction while connected, expiry while reserved
+ * Activity only stamps last_active, the timer re-arms itself for the remainder
+ */
+static void slot_timer_handler(TimerNode* timer) {
+    ClientConnection* conn = (ClientConnection*)timer->owner;
+    Socket* sock = (Socket*)conn->source.owner;
+    uint64_t now = sock->loop->now;
+    int slot = (int)(conn - sock->conns.clients);
+
+    pthread_mutex_lock(&sock->conns.lock);
+    int state = conn->state;
+    uint64_t since = (uint64_t)conn->last_active;
+    uint64_t timeout = (state == SLOT_CONNECTED ? CONNECTION_TIMEOUT : SESSION_RESERVE_TIMEOUT) * 1000ULL;
+    int expired = state != SLOT_FREE && since + timeout <= now;
+
+    uint32_t session_key = conn->session_key;
+    char owner[SLOT_OWNER_LENGTH];
+    if (expired && state == SLOT_RESERVED) {
+        memcpy(owner, conn->owner, SLOT_OWNER_LENGTH);
+        free_reserved_slot(&sock->conns, slot);
+    }
+    pthread_mutex_unlock(&sock->conns.lock);
+
+    if (state == SLOT_FREE) {
+        return;
+    }
+    if (!expired) {
+        timer_wheel_schedule(&sock->loop->timers, timer, since + timeout);
+        return;
+    }
+
+    if (state == SLOT_CONNECTED) {
+        // Already closing, the close completion re-arms the timer for the reservation
+        if (conn->fd < 0) return;
+        printf("Evicting idle client from port %d\n", sock->port);
+        STAT_ADD(sock->stats.evictions, 1);
+        metrics_inc(METRIC_EVICT_IDLE);
+        close_client(sock, conn);
+        return;
+    }
+
+    printf("Session reservation expired on port %d\n", sock->port);
+    STAT_ADD(sock->stats.evictions, 1);
+    metrics_inc(METRIC_EVICT_RESERVATION);
+    if (sock->on_slot_expired) {
+        sock->on_slot_expired(sock->slot_expired_ctx, sock, session_key, owner);
+    }
+}
+
+/*
+ * Stop reading at the high-water mark and resume at half, so a client that
+ * does not read cannot make us buffer
+ */
+static void update_client_backpressure(Socket* sock, ClientConnection* conn) {
+    uint32_t pending = output_used(&conn->out);
+    uint32_t high_water = (uint32_t)sock->config.write_high_water;
+
+    if (!conn->paused && pending >= high_water) {
+        conn->paused = 1;
+    } else if (conn->paused && pending <= high_water / 2) {
+        conn->paused = 0;
+    }
+}
+
+// Queue a frame, the loop sends everything queued for the client this iteration at once
+static int send_to_client(Socket* sock, ClientConnection* conn, const struct iovec* iov, int iovcnt) {
+    uint32_t queued = output_used(&conn->out);
+    if (output_append(&conn->out, iov, iovcnt) < 0) return -1;
+
+    sock->loop->egress.frames++;
+    STAT_ADD(sock->stats.frames_sent, 1);
+    metrics_inc(METRIC_FRAMES_SENT);
+    metrics_add(METRIC_OUTPUT_QUEUE, output_used(&conn->out) - queued);
+    event_loop_defer_flush(sock->loop, &conn->flush);
+    update_client_backpressure(sock, conn);
+    return 1;
+}
+
+static int send_client_text(Socket* sock, ClientConnection* conn, uint8_t opcode, const char* text) {
+    uint8_t header[PROTO_HEADER_SIZE];
+    uint32_t length = (uint32_t)strlen(text);
+    proto_encode_header(header, opcode, 0, length);
+    struct iovec iov[2] = {
+        { header, sizeof(header) },
+        { (void*)text, length },
+    };
+    return send_to_client(sock, conn, iov, 2);
+}
+
+static int send_client_error(Socket* sock, ClientConnection* conn, const char* text) {
+    return send_client_text(sock, conn, PROTO_OP_ERROR, text);
+}
+
+int socket_queue_shared(ClientConnection* conn, SharedBuffer* frame) {
+    Socket* sock = (Socket*)conn->source.owner;
+    if (conn->fd < 0) return -1;
+
+    // Shared frames take no ring space, but get a budget of the same size
+    if (conn->out.shared_bytes + frame->length > conn->out.ring.capacity) return -1;
+    if (output_append_shared(&conn->out, frame) < 0) {
+        struct iovec iov = { frame->data, frame->length };
+        if (output_append(&conn->out, &iov, 1) < 0) return -1;
+    }
+
+    sock->loop->egress.frames++;
+    STAT_ADD(sock->stats.frames_sent, 1);
+    metrics_inc(METRIC_FRAMES_SENT);
+    metrics_add(METRIC_OUTPUT_QUEUE, frame->length);
+    event_loop_defer_flush(sock->loop, &conn->flush);
+    update_client_backpressure(sock, conn);
+    return 1;
+}
+
+// Connected client holding session_key, or NULL (sock's loop thread)
+static ClientConnection* find_session_client(Socket* sock, uint32_t session_key) {
+    pthread_mutex_lock(&sock->conns.lock);
+    int pos = session_index_find(&sock->conns, session_key);
+    int slot = pos >= 0 ? sock->conns.session_index[pos] : -1;
+    pthread_mutex_unlock(&sock->conns.lock);
+
+    // fd is only set on this thread while the slot is connected
+    ClientConnection* conn = slot >= 0 ? &sock->conns.clients[slot] : NULL;
+    return conn && conn->fd >= 0 ? conn : NULL;
+}
+
+/*
+ * Queue a user message on the recipient's connection (sock's loop thread)
+ * Fails if the session is not connected or its output is full
+ * received_at: wakeup (ns) of the sender's loop that read the SEND
+ */
+static int deliver_message(Socket* sock, uint32_t session_key, const char* sender,
+                           const uint8_t* body, uint32_t length, uint64_t received_at) {
+    ClientConnection* conn = find_session_client(sock, session_key);
+    if (!conn) {
+        sock->mailbox.dropped++;
+        metrics_inc(METRIC_MESSAGES_DROPPED);
+        return -1;
+    }
+
+    uint8_t header[PROTO_HEADER_SIZE];
+    uint8_t sender_length = (uint8_t)strnlen(sender, MAX_USERNAME - 1);
+    proto_encode_header(header, PROTO_OP_MESSAGE, 0, 1 + sender_length + length);
+    struct iovec iov[4] = {
+        { header, sizeof(header) },
+        { &sender_length, 1 },
+        { (void*)sender, sender_length },
+        { (void*)body, length },
+    };
+    if (send_to_client(sock, conn, iov, 4) < 0) {
+        sock->mailbox.dropped++;
+        metrics_inc(METRIC_MESSAGES_DROPPED);
+        return -1;
+    }
+    sock->mailbox.delivered++;
+    metrics_inc(METRIC_MESSAGES_DELIVERED);
+    latency_record(LATENCY_MESSAGE, event_loop_clock_ns() - received_at);
+    return 1;
+}
+
+int mailbox_open(SocketMailbox* mailbox) {
+    mpsc_init(&mailbox->queue);
+    mailbox->signaled = 0;
+    mailbox->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return mailbox->event_fd < 0 ? -1 : 1;
+}
+
+// Whoever flips signaled pays for the eventfd write, later senders ride along
+void mailbox_wake(SocketMailbox* mailbox) {
+    if (__atomic_exchange_n(&mailbox->signaled, 1, __ATOMIC_SEQ_CST) == 0) {
+        uint64_t one = 1;
+        if (write(mailbox->event_fd, &one, sizeof(one)) != sizeof(one)) {
+            printf("Failed to signal mailbox on eventfd %d\n", mailbox->event_fd);
+        }
+    }
+}
+
+void mailbox_post(SocketMailbox* mailbox, MpscNode* node) {
+    metrics_inc(METRIC_MAILBOX_QUEUE);
+    mpsc_push(&mailbox->queue, node);
+    mailbox_wake(mailbox);
+}
+
+// Cleared before draining: a sender that finds it clear afterwards wakes the loop again
+void mailbox_begin_drain(SocketMailbox* mailbox) {
+    uint64_t count;
+    while (read(mailbox->event_fd, &count, sizeof(count)) == sizeof(count)) {
+    }
+    __atomic_exchange_n(&mailbox->signaled, 0, __ATOMIC_SEQ_CST);
+}
+
+Socket* socket_directory_port(const SocketDirectory* directory, int port) {
+    if (!directory || !directory->by_port) return NULL;
+
+    int index = port - directory->first_port;
+    if (index < 0 || index >= directory->num_ports) return NULL;
+    return directory->by_port[index];
+}
+
+Socket* socket_directory_find(const SocketDirectory* directory, const char* username, uint32_t* session_key) {
+    int port;
+    if (!directory || get_user_route(directory->users, username, &port, session_key) < 0) return NULL;
+
+    return socket_directory_port(directory, port);
+}
+
+// SEND from a connected client: resolve the recipient's socket and pass the body on
+static int route_client_message(Socket* sock, ClientConnection* conn, const Frame* frame) {
+    char recipient[MAX_USERNAME];
+    const uint8_t* body;
+    uint32_t length;
+    if (proto_parse_message(frame, recipient, sizeof(recipient), &body, &length) < 0) {
+        return send_client_error(sock, conn, "Malformed message");
+    }
+
+    // Delivered as u8 length | sender | body, which has to fit in one frame
+    size_t sender_length = strnlen(conn->owner, SLOT_OWNER_LENGTH - 1);
+    if (1 + sender_length + length > PROTO_MAX_PAYLOAD) {
+        return send_client_error(sock, conn, "Message too long");
+    }
+
+    uint32_t session_key;
+    Socket* target = socket_directory_find(sock->directory, recipient, &session_key);
+    if (!target || target->status != SOCKET_STATUS_ACTIVE) {
+        return send_client_error(sock, conn, "User not online");
+    }
+
+    // Same thread: straight into the recipient's output ring
+    if (target->loop == sock->loop) {
+        if (deliver_message(target, session_key, conn->owner, body, length, sock->loop->woke_at) < 0) {
+            return send_client_error(sock, conn, "Message not delivered");
+        }
+        return 1;
+    }
+
+    SocketMessage* msg = (SocketMessage*)slab_alloc_size(sock->slabs, sizeof(SocketMessage) + length);
+    if (!msg) {
+        return send_client_error(sock, conn, "Message not sent");
+    }
+    msg->session_key = session_key;
+    msg->origin = sock;
+    msg->origin_key = conn->session_key;
+    msg->bounced = 0;
+    msg->length = length;
+    msg->received_at = sock->loop->woke_at;
+    memcpy(msg->sender, conn->owner, sender_length);
+    msg->sender[sender_length] = '\0';
+    memcpy(msg->body, body, length);
+    mailbox_post(&target->mailbox, &msg->node);
+    return 1;
+}
+
+// JOIN, LEAVE and PUBLISH, all handled on the client's own loop
+static int handle_room_frame(Socket* sock, ClientConnection* conn, const Frame* frame) {
+    RoomShard* shard = sock->directory ? room_shard_for(sock->directory->rooms, sock->loop) : NULL;
+    if (!shard) {
+        return send_client_error(sock, conn, "Rooms unavailable");
+    }
 
-    while (sock->status == SOCKET_STATUS_ACTIVE) {
-        int nfds = epoll_wait(sock->conns.epoll_fd, events, MAX_EVENTS, EPOLL_TIMEOUT);
-        
-        if (nfds < 0) {
-            if (errno == EINTR) continue;  
-            sock->status = SOCKET_STATUS_ERROR;
-            break;
+    char name[ROOM_NAME_LENGTH];
+    if (frame->opcode == PROTO_OP_PUBLISH) {
+        const uint8_t* body;
+        uint32_t length;
+        if (proto_parse_message(frame, name, sizeof(name), &body, &length) < 0) {
+            return send_client_error(sock, conn, "Malformed message");
         }
+        // Delivered as u8 length | room | u8 length | sender | body in one frame
+        size_t sender_length = strnlen(conn->owner, SLOT_OWNER_LENGTH - 1);
+        if (2 + strlen(name) + sender_length + length > PROTO_MAX_PAYLOAD) {
+            return send_client_error(sock, conn, "Message too long");
+        }
+        if (room_publish(shard, name, conn->owner, body, length) < 0) {
+            return send_client_error(sock, conn, "Message not sent");
+        }
+        return 1;
+    }
+
+    if (proto_parse_name(frame, name, sizeof(name)) < 0) {
+        return send_client_error(sock, conn, "Malformed room");
+    }
+
+    if (frame->opcode == PROTO_OP_JOIN) {
+        int result = room_join(shard, conn, name);
+        if (result < 0) return send_client_error(sock, conn, "Too many rooms");
+        if (result == 0) return send_client_error(sock, conn, "Already in room");
+        return send_client_text(sock, conn, PROTO_OP_OK, "Joined");
+    }
+
+    if (room_leave(shard, conn, name) == 0) {
+        return send_client_error(sock, conn, "Not in room");
+    }
+    return send_client_text(sock, conn, PROTO_OP_OK, "Left");
+}
+
+// One message from a connected client, -1 if the client has to go
+static int handle_client_frame(Socket* sock, ClientConnection* conn, const Frame* frame) {
+    if (frame->opcode == PROTO_OP_RAW) {
+        // Compat clients: echo the bytes back for now
+        struct iovec iov = { (void*)frame->payload, frame->length };
+        return send_to_client(sock, conn, &iov, 1);
+    }
+
+    if (frame->opcode == PROTO_OP_SEND) {
+        return route_client_message(sock, conn, frame);
+    }
+
+    if (frame->opcode == PROTO_OP_JOIN || frame->opcode == PROTO_OP_LEAVE ||
+        frame->opcode == PROTO_OP_PUBLISH) {
+        return handle_room_frame(sock, conn, frame);
+    }
+
+    if (frame->opcode != PROTO_OP_DATA) {
+        return send_client_error(sock, conn, "Unknown opcode");
+    }
 
-        for (int i = 0; i < nfds; i++) {
-            if (events[i].data.fd == sock->socket_fd) {
-                // Handle new connection
-                struct sockaddr_in client_addr;
-                socklen_t client_len = sizeof(client_addr);
-                
-                int client_fd = accept(sock->socket_fd, 
-                                     (struct sockaddr*)&client_addr, 
-                                     &client_len);
-                
-                if (client_fd < 0) {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                        break;
-                    }
-                    continue;
-                }
-
-                // First message should contain session key
-                uint32_t received_key;
-                ssize_t bytes_read = read(client_fd, &received_key, sizeof(uint32_t));
-                if (bytes_read == sizeof(uint32_t)) {
-                    // Find matching session key in our clients array
-                    int valid = 0;
-                    int slot = -1;
-                    for (int j = 0; j < sock->conns.max_connections; j++) {
-                        if (sock->conns.clients[j].session_key == received_key && 
-                            sock->conns.clients[j].fd == -1) {
-                            valid = 1;
-                            slot = j;
-                            break;
-                        }
-                    }
-
-                    if (valid) {
-                        // Add to epoll
-                        struct epoll_event ev;
-                        ev.events = EPOLLIN;
-                        ev.data.fd = client_fd;
-                        if (epoll_ctl(sock->conns.epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
-                            close(client_fd);
-                            continue;
-                        }
-
-                        // Update client slot
-                        sock->conns.clients[slot].fd = client_fd;
-                        sock->conns.clients[slot].last_active = time(NULL);
-                        sock->conns.current_connections++;
-
-                        char response[] = "Connection accepted\n";
-                        write(client_fd, response, strlen(response));
-                        printf("Client connected with valid session key on port %d\n", sock->port);
-                    } else {
-                        char response[] = "Invalid session key\n";
-                        write(client_fd, response, strlen(response));
-                        close(client_fd);
-                    }
-                }
+    // Echo the frame back, payload straight from the input buffer
+    uint8_t header[PROTO_HEADER_SIZE];
+    proto_encode_header(header, PROTO_OP_DATA, frame->flags, frame->length);
+    struct iovec iov[2] = {
+        { header, sizeof(header) },
+        { (void*)frame->payload, frame->length },
+    };
+    return send_to_client(sock, conn, iov, 2);
+}
+
+// Buffered frames, stopping while paused so replies never outgrow the output ring
+static int process_client_frames(Socket* sock, ClientConnection* conn) {
+    Frame frame;
+    int result = 0;
+
+    while (!conn->paused && (result = frame_parser_next(&conn->parser, &frame)) == 1) {
+        STAT_ADD(sock->stats.frames_received, 1);
+        metrics_inc(METRIC_FRAMES_RECEIVED);
+        if (handle_client_frame(sock, conn, &frame) < 0) return -1;
+    }
+    if (result < 0) {
+        printf("Dropping client on port %d after a malformed frame\n", sock->port);
+        return -1;
+    }
+    return 1;
+}
+
+// Hand the queued output to the loop, one send outstanding at a time, -1 if the client has to go
+static int flush_client(Socket* sock, ClientConnection* conn) {
+    if (conn->sending) return 1;
+
+    struct iovec iov[IO_MAX_IOV];
+    int count = output_peek_iov(&conn->out, iov, IO_MAX_IOV);
+    if (count == 0) return 1;
+
+    if (event_loop_send(sock->loop, &conn->source, iov, count) < 0) return -1;
+    conn->sending = 1;
+    sock->loop->egress.writes++;
+    return 1;
+}
+
+// Deferred flush at the end of the loop iteration
+static void client_flush_handler(FlushNode* node) {
+    ClientConnection* conn = (ClientConnection*)node->owner;
+    Socket* sock = (Socket*)conn->source.owner;
+
+    // Disconnected after queuing
+    if (conn->fd < 0) return;
+
+    if (flush_client(sock, conn) < 0) {
+        close_client(sock, conn);
+    }
+}
+
+// Output went out: send the rest, and resume reading once enough of it drained
+static void client_send_handler(EventSource* source, ssize_t result) {
+    ClientConnection* conn = (ClientConnection*)source;
+    Socket* sock = (Socket*)source->owner;
+
+    conn->sending = 0;
+    if (conn->fd < 0) return;
+    if (result < 0) {
+        close_client(sock, conn);
+        return;
+    }
+
+    output_consume(&conn->out, (uint32_t)result);
+    sock->loop->egress.bytes += (uint64_t)result;
+    update_socket_stats(sock, (unsigned long)result, 0);
+    metrics_add(METRIC_OUTPUT_QUEUE, -(int64_t)result);
+
+    int was_paused = conn->paused;
+    update_client_backpressure(sock, conn);
+
+    // Frames left over when reading paused
+    if (was_paused && !conn->paused &&
+        (process_client_frames(sock, conn) < 0 || arm_client_recv(sock, conn) < 0)) {
+        close_client(sock, conn);
+        return;
+    }
+    if (flush_client(sock, conn) < 0) {
+        close_client(sock, conn);
+    }
+}
+
+// Handle messages from existing clients, every complete frame in the buffer per receive
+static void client_recv_handler(EventSource* source, ssize_t result) {
+    ClientConnection* conn = (ClientConnection*)source;
+    Socket* sock = (Socket*)source->owner;
+
+    conn->receiving = 0;
+    if (conn->fd < 0) return;
+    if (result <= 0) {
+        // Client disconnected or error
+        close_client(sock, conn);
+        return;
+    }
+
+    frame_parser_commit(&conn->parser, (size_t)result);
+    // Update last active time (loop clock, no syscall)
+    conn->last_active = (time_t)sock->loop->now;
+    update_socket_stats(sock, 0, (unsigned long)result);
+    update_socket_activity(sock);
+
+    if (process_client_frames(sock, conn) < 0 || arm_client_recv(sock, conn) < 0) {
+        close_client(sock, conn);
+    }
+}
+
+// First message should contain session key
+static void handshake_event_handler(EventSource* source, uint32_t events) {
+    PendingHandshake* handshake = (PendingHandshake*)source->owner;
+    Socket* sock = handshake->sock;
+    (void)events;
+
+    ssize_t bytes_read = read(source->fd, (char*)&handshake->key + handshake->received,
+                              sizeof(uint32_t) - handshake->received);
+    if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+
+    if (bytes_read > 0) {
+        handshake->received += bytes_read;
+        if (handshake->received < sizeof(uint32_t)) {
+            return;
+        }
+    }
+
+    event_loop_remove(sock->loop, source);
+    timer_wheel_cancel(&sock->loop->timers, &handshake->timer);
+    if (bytes_read > 0 && claim_session_slot(sock, source->fd, handshake->key, handshake->accepted_at) > 0) {
+        printf("Client connected with valid session key on port %d\n", sock->port);
+    } else {
+        close(source->fd);
+    }
+    slab_free(handshake);
+}
+
+// Connected but never sent a full session key
+static void handshake_timer_handler(TimerNode* timer) {
+    PendingHandshake* handshake = (PendingHandshake*)timer->owner;
+
+    metrics_inc(METRIC_EVICT_HANDSHAKE);
+    event_loop_remove(handshake->sock->loop, &handshake->source);
+    close(handshake->source.fd);
+    slab_free(handshake);
+}
+
+// New connection on the socket's own port, it has HANDSHAKE_TIMEOUT to send its key
+static void listener_accept_handler(EventSource* source, int client_fd) {
+    Socket* sock = (Socket*)source->owner;
+
+    PendingHandshake* handshake = (PendingHandshake*)slab_alloc_size(sock->slabs, sizeof(PendingHandshake));
+    if (!handshake) {
+        close(client_fd);
+        return;
+    }
+    event_source_init(&handshake->source, client_fd, handshake_event_handler, handshake);
+    handshake->sock = sock;
+    handshake->key = 0;
+    handshake->received = 0;
+    handshake->accepted_at = sock->loop->woke_at;
+    timer_init(&handshake->timer, handshake_timer_handler, handshake);
+
+    if (event_loop_add(sock->loop, &handshake->source, EPOLLIN) < 0) {
+        close(client_fd);
+        slab_free(handshake);
+        return;
+    }
+    event_loop_schedule(sock->loop, &handshake->timer, HANDSHAKE_TIMEOUT * 1000ULL);
+}
+
+// Take every pending command off the queue (clears the eventfd)
+static SocketCommand* drain_socket_commands(SocketCommandQueue* queue) {
+    uint64_t count;
+    while (read(queue->event_fd, &count, sizeof(count)) == sizeof(count)) {
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    SocketCommand* cmds = queue->head;
+    queue->head = NULL;
+    queue->tail = NULL;
+    pthread_mutex_unlock(&queue->lock);
+
+    return cmds;
+}
+
+static void command_event_handler(EventSource* source, uint32_t events) {
+    Socket* sock = (Socket*)source->owner;
+    (void)events;
+
+    SocketCommand* cmd = drain_socket_commands(&sock->commands);
+    while (cmd) {
+        SocketCommand* next = cmd->next;
+        metrics_add(METRIC_COMMAND_QUEUE, -1);
+        if (cmd->type == SOCKET_CMD_HANDOFF) {
+            if (claim_session_slot(sock, cmd->fd, cmd->session_key, cmd->posted_at) < 0) {
+                close(cmd->fd);
             } else {
-                // Handle messages from existing clients
-                int client_fd = events[i].data.fd;
-                char buffer[MAX_MESSAGE_SIZE];
-                
-                ssize_t bytes_read = read(client_fd, buffer, sizeof(buffer) - 1);
-                if (bytes_read > 0) {
-                    buffer[bytes_read] = '\0';
-                    // Update last active time
-                    for (int j = 0; j < sock->conns.max_connections; j++) {
-                        if (sock->conns.clients[j].fd == client_fd) {
-                            sock->conns.clients[j].last_active = time(NULL);
-                            break;
-                        }
-                    }
-                    
-                    // Echo message back for now
-                    write(client_fd, buffer, bytes_read);
-                } else if (bytes_read == 0 || (bytes_read < 0 && errno != EAGAIN)) {
-                    // Client disconnected or error
-                    for (int j = 0; j < sock->conns.max_connections; j++) {
-                        if (sock->conns.clients[j].fd == client_fd) {
-                            sock->conns.clients[j].fd = -1;
-                            sock->conns.current_connections--;
-                            break;
-                        }
-                    }
-                    epoll_ctl(sock->conns.epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-                    close(client_fd);
-                }
+                printf("Client handed off with valid session key to socket %d\n", sock->port);
+            }
+        } else if (cmd->type == SOCKET_CMD_RESERVE) {
+            // Skip if the client already connected or the slot was given back meanwhile
+            ClientConnection* conn = &sock->conns.clients[cmd->slot];
+            pthread_mutex_lock(&sock->conns.lock);
+            int reserved = conn->state == SLOT_RESERVED && conn->session_key == cmd->session_key;
+            uint64_t since = (uint64_t)conn->last_active;
+            pthread_mutex_unlock(&sock->conns.lock);
+            if (reserved) {
+                timer_wheel_schedule(&sock->loop->timers, &conn->timer,
+                                     since + SESSION_RESERVE_TIMEOUT * 1000ULL);
+            }
+        }
+        slab_free(cmd);
+        cmd = next;
+    }
+}
+
+// Deliver what other sockets posted, at most MAILBOX_DRAIN_BATCH per wakeup
+static void mailbox_event_handler(EventSource* source, uint32_t events) {
+    Socket* sock = (Socket*)source->owner;
+    SocketMailbox* mailbox = &sock->mailbox;
+    (void)events;
+
+    mailbox_begin_drain(mailbox);
+
+    int handled = 0;
+    MpscNode* node;
+    while (handled < MAILBOX_DRAIN_BATCH && (node = mpsc_pop(&mailbox->queue))) {
+        SocketMessage* msg = (SocketMessage*)node;
+        handled++;
+        metrics_add(METRIC_MAILBOX_QUEUE, -1);
+        if (msg->bounced) {
+            // Our client's message could not be delivered, it may still have room for the error
+            ClientConnection* conn = find_session_client(sock, msg->origin_key);
+            if (conn) {
+                send_client_error(sock, conn, "Message not delivered");
             }
+        } else if (deliver_message(sock, msg->session_key, msg->sender, msg->body, msg->length, msg->received_at) < 0) {
+            // Back to the sender's socket, a bounce is never bounced again
+            msg->bounced = 1;
+            mailbox_post(&msg->origin->mailbox, &msg->node);
+            continue;
         }
+        slab_free(msg);
     }
 
-    return NULL;
+    // Leave the rest for the next iteration so the loop's other sockets get their turn
+    if (handled == MAILBOX_DRAIN_BATCH) {
+        mailbox_wake(mailbox);
+    }
 }
 
-int start_socket(Socket* sock) {
-    if (!sock) return -1;
+static int post_socket_command(Socket* sock, SocketCommand* cmd) {
+    cmd->next = NULL;
+    metrics_inc(METRIC_COMMAND_QUEUE);
+
+    pthread_mutex_lock(&sock->commands.lock);
+    if (sock->commands.tail) {
+        sock->commands.tail->next = cmd;
+    } else {
+        sock->commands.head = cmd;
+    }
+    sock->commands.tail = cmd;
+    pthread_mutex_unlock(&sock->commands.lock);
+
+    uint64_t one = 1;
+    if (write(sock->commands.event_fd, &one, sizeof(one)) != sizeof(one)) {
+        printf("Failed to signal command to socket %d\n", sock->port);
+    }
+    return 1;
+}
 
+int socket_handoff_client(Socket* sock, int client_fd, uint32_t session_key) {
+    if (!sock || sock->status != SOCKET_STATUS_ACTIVE || sock->commands.event_fd < 0) return -1;
+
+    SocketCommand* cmd = (SocketCommand*)slab_alloc_size(sock->slabs, sizeof(SocketCommand));
+    if (!cmd) return -1;
+
+    cmd->type = SOCKET_CMD_HANDOFF;
+    cmd->fd = client_fd;
+    cmd->session_key = session_key;
+    cmd->slot = -1;
+    cmd->posted_at = event_loop_clock_ns();
+    return post_socket_command(sock, cmd);
+}
+
+// Create, bind and register the socket's own listener on its port
+static int start_socket_listener(Socket* sock) {
     // Create the main socket fd
-    sock->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    sock->socket_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sock->socket_fd < 0) {
         printf("Failed to create socket fd\n");
-        sock->status = SOCKET_STATUS_ERROR;
         return -1;
     }
 
@@ -246,77 +1047,101 @@ int start_socket(Socket* sock) {
     if (setsockopt(sock->socket_fd, SOL_SOCKET, SO_REUSEADDR, 
                    &opt, sizeof(opt)) < 0) {
         printf("Failed to set socket options\n");
-        close(sock->socket_fd);
-        sock->status = SOCKET_STATUS_ERROR;
         return -1;
     }
 
-    // Create epoll instance
-    sock->conns.epoll_fd = epoll_create1(0);
-    if (sock->conns.epoll_fd < 0) {
-        printf("Failed to create epoll instance\n");
-        close(sock->socket_fd);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(sock->port);
+    // Bind socket to this port
+    if (bind(sock->socket_fd, (struct sockaddr*)&addr, 
+             sizeof(addr)) < 0) {
+        printf("Failed to bind port %d\n", sock->port);
+        sock->error = SOCKET_ERROR_BIND;
+        return -1;
+    }
+
+    // Start listening on this port
+    if (listen(sock->socket_fd, sock->config.backlog) < 0) {
+        printf("Failed to listen on port %d\n", sock->port);
+        sock->error = SOCKET_ERROR_LISTEN;
+        return -1;
+    }
+
+    // Accept through the event loop (multishot accept under io_uring)
+    event_source_init(&sock->listener_source, sock->socket_fd, NULL, sock);
+    sock->listener_source.on_accept = listener_accept_handler;
+    if (event_loop_accept(sock->loop, &sock->listener_source) < 0) {
+        printf("Failed to add socket at port %d to its event loop\n", sock->port);
+        sock->error = SOCKET_ERROR_EPOLL;
+        return -1;
+    }
+
+    return 1;
+}
+
+int start_socket(Socket* sock, EventLoop* loop) {
+    if (!sock) return -1;
+
+    if (!loop) {
+        printf("No event loop for socket %d\n", sock->port);
         sock->status = SOCKET_STATUS_ERROR;
         return -1;
     }
+    sock->loop = loop;
 
-    
-        struct sockaddr_in addr;
-        memset(&addr, 0, sizeof(addr));
-        addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = INADDR_ANY;
-        addr.sin_port = htons(sock->port);
-        // Bind socket to this port
-        if (bind(sock->socket_fd, (struct sockaddr*)&addr, 
-                 sizeof(addr)) < 0) {
-            printf("Failed to bind port %d\n", sock->port);
-            sock->status = SOCKET_STATUS_ERROR;
-            sock->error = SOCKET_ERROR_BIND;
-            return -1;
-        }
+    // Slot timers find their socket through the client's source
+    for (int i = 0; i < sock->conns.max_connections; i++) {
+        sock->conns.clients[i].source.owner = sock;
+    }
 
-        // Start listening on this port
-        if (listen(sock->socket_fd, sock->config.backlog) < 0) {
-            printf("Failed to listen on port %d\n", sock->port);
-            sock->status = SOCKET_STATUS_ERROR;
-            sock->error = SOCKET_ERROR_LISTEN;
-            return -1;
-        }
+    // Command queue wakeup (fd handoffs from the router)
+    sock->commands.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    event_source_init(&sock->command_source, sock->commands.event_fd, command_event_handler, sock);
 
-        // Add to epoll
-        struct epoll_event ev;
-        ev.events = EPOLLIN;
-        ev.data.fd = sock->socket_fd;
-        if (epoll_ctl(sock->conns.epoll_fd, EPOLL_CTL_ADD, 
-                      sock->socket_fd, &ev) < 0) {
-            printf("Failed to add socket at port %d to epoll\n", sock->port);
-            sock->status = SOCKET_STATUS_ERROR;
-            sock->error = SOCKET_ERROR_EPOLL;
-            return -1;
-        }
+    // Mailbox for messages from clients of other sockets, the queue's stub lives in the socket
+    mailbox_open(&sock->mailbox);
+    event_source_init(&sock->mailbox_source, sock->mailbox.event_fd, mailbox_event_handler, sock);
+
+    if (sock->commands.event_fd < 0 ||
+        event_loop_add(loop, &sock->command_source, EPOLLIN) < 0) {
+        printf("Failed to set up command queue for socket %d\n", sock->port);
+        sock->error = SOCKET_ERROR_EPOLL;
+    } else if (sock->mailbox.event_fd < 0 ||
+               event_loop_add(loop, &sock->mailbox_source, EPOLLIN) < 0) {
+        printf("Failed to set up mailbox for socket %d\n", sock->port);
+        sock->error = SOCKET_ERROR_EPOLL;
+    } else if (sock->config.enable_listener && start_socket_listener(sock) < 0 && sock->error == 0) {
+        sock->error = SOCKET_ERROR_BIND;
+    }
 
-        printf("Successfully started socket at port %d\n", sock->port);
     // Check if any ports were successfully started
-    
     if (sock->error != 0) {
         printf("Faulty socket\n");
-        close(sock->conns.epoll_fd);
-        close(sock->socket_fd);
+        if (sock->commands.event_fd >= 0) {
+            close(sock->commands.event_fd);
+            sock->commands.event_fd = -1;
+        }
+        if (sock->mailbox.event_fd >= 0) {
+            close(sock->mailbox.event_fd);
+            sock->mailbox.event_fd = -1;
+        }
+        if (sock->socket_fd >= 0) {
+            close(sock->socket_fd);
+            sock->socket_fd = -1;
+        }
         sock->status = SOCKET_STATUS_ERROR;
         return -1;
     }
-    sock->status = SOCKET_STATUS_ACTIVE;
 
-    // Create the socket thread
-    if (pthread_create(&sock->thread_id, NULL, 
-                      socket_thread_function, sock) != 0) {
-        printf("Failed to create socket thread\n");
-        close(sock->conns.epoll_fd);
-        close(sock->socket_fd);
-        sock->status = SOCKET_STATUS_ERROR;
-        return -1;
+    if (sock->config.enable_listener) {
+        printf("Successfully started socket at port %d on loop %d\n", sock->port, loop->index);
+    } else {
+        printf("Successfully started socket %d on loop %d (handoff only, no listener)\n", sock->port, loop->index);
     }
-
+    sock->status = SOCKET_STATUS_ACTIVE;
 
     return 1;
 }
@@ -340,17 +1165,18 @@ int start_router_socket(RouterSocket* router_socket) {
         return -1;
     }
 
-    // Set non-blocking mode for the socket
-    if (fcntl(router_socket->socket_fd, F_SETFL, 
-              fcntl(router_socket->socket_fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+    // Let several listeners share the port, the kernel spreads accepts across them
+    if (router_socket->config.reuse_port &&
+        setsockopt(router_socket->socket_fd, SOL_SOCKET, SO_REUSEPORT,
+                   &opt, sizeof(opt)) < 0) {
         close(router_socket->socket_fd);
         router_socket->status = SOCKET_STATUS_ERROR;
         return -1;
     }
 
-    // Create epoll instance
-    router_socket->epoll_fd = epoll_create1(0);
-    if (router_socket->epoll_fd < 0) {
+    // Set non-blocking mode for the socket
+    if (fcntl(router_socket->socket_fd, F_SETFL, 
+              fcntl(router_socket->socket_fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
         close(router_socket->socket_fd);
         router_socket->status = SOCKET_STATUS_ERROR;
         return -1;
@@ -366,7 +1192,6 @@ int start_router_socket(RouterSocket* router_socket) {
     // Bind socket to port
     if (bind(router_socket->socket_fd, (struct sockaddr*)&addr, 
              sizeof(addr)) < 0) {
-        close(router_socket->epoll_fd);
         close(router_socket->socket_fd);
         router_socket->status = SOCKET_STATUS_ERROR;
         return -1;
@@ -374,24 +1199,11 @@ int start_router_socket(RouterSocket* router_socket) {
 
     // Start listening
     if (listen(router_socket->socket_fd, router_socket->config.backlog) < 0) {
-        close(router_socket->epoll_fd);
         close(router_socket->socket_fd);
         router_socket->status = SOCKET_STATUS_ERROR;
         return -1;
     }
 
-    // Add the listening socket to epoll
-    struct epoll_event ev;
-    ev.events = EPOLLIN | EPOLLET;  // Edge-triggered mode
-    ev.data.fd = router_socket->socket_fd;
-    if (epoll_ctl(router_socket->epoll_fd, EPOLL_CTL_ADD, 
-                  router_socket->socket_fd, &ev) < 0) {
-        close(router_socket->epoll_fd);
-        close(router_socket->socket_fd);
-        router_socket->status = SOCKET_STATUS_ERROR;
-        return -1;
-    }
-    
     router_socket->status = SOCKET_STATUS_ACTIVE;
     return 1;
 }
@@ -403,18 +1215,50 @@ int destroy_socket(Socket* sock) {
 
     printf("Destroying socket on port %d\n", sock->port);
 
-    // Close epoll file descriptor
-    if (sock->conns.epoll_fd >= 0) {
-        close(sock->conns.epoll_fd);
-        sock->conns.epoll_fd = -1;
-    }
-
     // Close main socket file descriptor
     if (sock->socket_fd >= 0) {
         close(sock->socket_fd);
         sock->socket_fd = -1;
     }
 
+    // Drop handoffs the socket thread never picked up
+    if (sock->commands.event_fd >= 0) {
+        SocketCommand* cmd = drain_socket_commands(&sock->commands);
+        while (cmd) {
+            SocketCommand* next = cmd->next;
+            metrics_add(METRIC_COMMAND_QUEUE, -1);
+            if (cmd->type == SOCKET_CMD_HANDOFF) {
+                close(cmd->fd);
+            }
+            slab_free(cmd);
+            cmd = next;
+        }
+        close(sock->commands.event_fd);
+        sock->commands.event_fd = -1;
+    }
+
+    // Messages posted after the loop's last drain
+    if (sock->mailbox.event_fd >= 0) {
+        MpscNode* node;
+        while ((node = mpsc_pop(&sock->mailbox.queue))) {
+            metrics_add(METRIC_MAILBOX_QUEUE, -1);
+            slab_free(node);
+        }
+        if (sock->mailbox.delivered || sock->mailbox.dropped) {
+            printf("Socket %d delivered %lu user messages, dropped %lu\n",
+                   sock->port, sock->mailbox.delivered, sock->mailbox.dropped);
+        }
+        close(sock->mailbox.event_fd);
+        sock->mailbox.event_fd = -1;
+    }
+
+    if (sock->stats.connects) {
+        printf("Socket %d: %llu connects, %llu evictions, %llu frames in, %llu frames out, %llu bytes in, %llu bytes out\n",
+               sock->port, (unsigned long long)sock->stats.connects, (unsigned long long)sock->stats.evictions,
+               (unsigned long long)sock->stats.frames_received, (unsigned long long)sock->stats.frames_sent,
+               (unsigned long long)sock->stats.bytes_received, (unsigned long long)sock->stats.bytes_sent);
+    }
+
     // Close all client connections and free resources
     if (sock->conns.clients) {
         // Close any open client connections
@@ -422,11 +1266,19 @@ int destroy_socket(Socket* sock) {
             if (sock->conns.clients[i].fd >= 0) {
                 close(sock->conns.clients[i].fd);
             }
+            // Also clients whose close the loop had not confirmed yet
+            if (sock->conns.clients[i].parser.data) {
+                release_client_buffers(sock, &sock->conns.clients[i]);
+            }
         }
         // Free the clients array
         free(sock->conns.clients);
         sock->conns.clients = NULL;
     }
+    free(sock->conns.free_slots);
+    sock->conns.free_slots = NULL;
+    free(sock->conns.session_index);
+    sock->conns.session_index = NULL;
 
     // Reset status flags
     sock->status = SOCKET_STATUS_UNUSED;
@@ -437,8 +1289,36 @@ int destroy_socket(Socket* sock) {
     return 1;
 }
 
+void update_socket_activity(Socket* sock) {
+    if (!sock->loop) return;
+    __atomic_store_n(&sock->stats.last_active, (int64_t)sock->loop->now, __ATOMIC_RELAXED);
+}
+
+void update_socket_stats(Socket* sock, unsigned long bytes_sent, unsigned long bytes_received) {
+    STAT_ADD(sock->stats.bytes_sent, bytes_sent);
+    STAT_ADD(sock->stats.bytes_received, bytes_received);
+    metrics_add(METRIC_BYTES_SENT, (int64_t)bytes_sent);
+    metrics_add(METRIC_BYTES_RECEIVED, (int64_t)bytes_received);
+}
+
+void get_socket_stats(const Socket* sock, SocketStats* stats) {
+    stats->bytes_sent = __atomic_load_n(&sock->stats.bytes_sent, __ATOMIC_RELAXED);
+    stats->bytes_received = __atomic_load_n(&sock->stats.bytes_received, __ATOMIC_RELAXED);
+    stats->frames_sent = __atomic_load_n(&sock->stats.frames_sent, __ATOMIC_RELAXED);
+    stats->frames_received = __atomic_load_n(&sock->stats.frames_received, __ATOMIC_RELAXED);
+    stats->connects = __atomic_load_n(&sock->stats.connects, __ATOMIC_RELAXED);
+    stats->evictions = __atomic_load_n(&sock->stats.evictions, __ATOMIC_RELAXED);
+    stats->active_connections = __atomic_load_n(&sock->stats.active_connections, __ATOMIC_RELAXED);
+    stats->last_active = __atomic_load_n(&sock->stats.last_active, __ATOMIC_RELAXED);
+}
+
 int is_socket_full(Socket* sock){
-    if(sock->conns.current_connections < sock->conns.max_connections){
+    // Reserved slots count as taken, not just connected ones
+    pthread_mutex_lock(&sock->conns.lock);
+    int has_room = sock->conns.free_count > 0;
+    pthread_mutex_unlock(&sock->conns.lock);
+
+    if(has_room){
         return 1;
     }
 
@@ -2,7 +2,7 @@
 #include "server/socket.h"
 
 //create the socket pool with a size and start port
-SocketPool* create_socketpool(int num_sockets, int users_per_socket, int start_port){
+SocketPool* create_socketpool(int num_sockets, int users_per_socket, int start_port, SocketConfig scf, BufferPool* buffers, SlabClasses* slabs){
     printf("Number of sockets for the pool: %d\n", num_sockets);
     SocketPool* pool = (SocketPool*)malloc(sizeof(SocketPool));
     if (!pool) return NULL;
@@ -14,9 +14,6 @@ SocketPool* create_socketpool(int num_sockets, int users_per_socket, int start_p
         return NULL;
     }
 
-    // Create default config
-    SocketConfig scf = create_default_socket_config();
-
     // Initialize pool fields
     pool->max_users = max_users;
     pool->current_users = 0;
@@ -38,7 +35,9 @@ SocketPool* create_socketpool(int num_sockets, int users_per_socket, int start_p
         SocketInitInfo init_info = {
             .config = scf,
             .port_number = port,
-            .max_connections = users_per_socket 
+            .max_connections = users_per_socket,
+            .buffers = buffers,
+            .slabs = slabs
         };
         Socket socket = create_socket(init_info);
         printf("\n\n");
@@ -60,12 +59,12 @@ SocketPool* create_socketpool(int num_sockets, int users_per_socket, int start_p
 }
 
 
-int start_socketpool(SocketPool* socket_pool) {
-    //start each socket 
+int start_socketpool(SocketPool* socket_pool, EventLoopPool* loops) {
+    //start each socket on the least loaded event loop
     int num_sockets = socket_pool->total_sockets;
     for(int i = 0; i < num_sockets; i++){
         printf("\nStarting socket %d\n", (i+1));
-        start_socket(&socket_pool->sockets[i]);
+        start_socket(&socket_pool->sockets[i], event_loop_pool_attach(loops));
     }
     
 
@@ -81,14 +80,14 @@ int delete_socketpool(SocketPool* socket_pool) {
 
     if (socket_pool->sockets) {
         for (int i = 0; i < socket_pool->total_sockets; i++) {
-            if (destroy_socket(&socket_pool->sockets[i]) != 0) {
+            if (destroy_socket(&socket_pool->sockets[i]) < 0) {
                 return -1;
             }
         }
         free(socket_pool->sockets);
+        socket_pool->sockets = NULL;
     }
 
-    free(socket_pool);
     return 0;
 }
 
@@ -100,18 +99,14 @@ int find_open_socket(SocketPool* socket_pool, uint32_t session_key) {
         
         //check if socket is full 
         if(is_socket_full(current_socket) != -1) {
-            port_number = current_socket->port;
-            printf("Found an open socket at port %d\n", port_number);
-            
             // Add session key to socket's client tracking
-            for (int j = 0; j < current_socket->conns.max_connections; j++) {
-                if (current_socket->conns.clients[j].fd == -1) {
-                    current_socket->conns.clients[j].session_key = session_key;
-                    printf("Added session key %u to socket at port %d\n", 
-                           session_key, port_number);
-                    break;
-                }
+            int slot = reserve_socket_slot(current_socket, session_key, NULL);
+            if (slot < 0) {
+                continue;
             }
+            port_number = current_socket->port;
+            printf("Added session key %u to socket at port %d (slot %d)\n", 
+                   session_key, port_number, slot);
             return port_number;
         }
     }
@@ -1,7 +1,10 @@
 #include "db/user_db.h"
 #include "db/db_config.h"
+#include "server/latency.h"
+#include "server/metrics.h"
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
 #include <bcrypt/bcrypt.h> 
 
@@ -33,81 +36,342 @@ static int verify_password(const char* password, const char* hash) {
     return (bcrypt_checkpw(password, hash) == 0);
 }
 
-UserDB* init_user_db(const char* db_path) {
-    UserDB* db = malloc(sizeof(UserDB));
-    if (!db) return NULL;
+// Each thread keeps the connection it claimed, tagged with the handle it came from
+static unsigned long next_db_id = 0;
+static __thread unsigned long thread_db_id = 0;
+static __thread UserDBConnection* thread_conn = NULL;
+
+UserDBConfig default_user_db_config(void) {
+    UserDBConfig config = {
+        DB_POOL_CONNECTIONS,
+        DB_JOURNAL_MODE,
+        DB_SYNCHRONOUS,
+        DB_CACHE_KB,
+        DB_TIMEOUT_MS,
+        DB_LOGIN_BATCH,
+        DB_LOGIN_FLUSH_MS,
+    };
+    return config;
+}
 
-    // Open database connection
-    int rc = sqlite3_open(db_path, &db->db);
+static int create_tables(sqlite3* handle) {
+    char* err_msg = NULL;
+    int rc = sqlite3_exec(handle, CREATE_USERS_TABLE_SQL, NULL, NULL, &err_msg);
+    
     if (rc != SQLITE_OK) {
-        printf("Cannot open database: %s\n", sqlite3_errmsg(db->db));
-        free(db);
-        return NULL;
+        printf("SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return DB_ERROR;
     }
 
-    // Initialize database tables
-    if (init_db_tables(db) != DB_SUCCESS) {
-        sqlite3_close(db->db);
-        free(db);
-        return NULL;
+    rc = sqlite3_exec(handle, CREATE_USERNAME_INDEX_SQL, NULL, NULL, &err_msg);
+    if (rc != SQLITE_OK) {
+        printf("SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return DB_ERROR;
+    }
+
+    return DB_SUCCESS;
+}
+
+static void close_connection(UserDBConnection* conn) {
+    if (conn->auth_stmt) sqlite3_finalize(conn->auth_stmt);
+    if (conn->create_stmt) sqlite3_finalize(conn->create_stmt);
+    if (conn->update_user_stmt) sqlite3_finalize(conn->update_user_stmt);
+    if (conn->get_user_stmt) sqlite3_finalize(conn->get_user_stmt);
+    if (conn->db) sqlite3_close(conn->db);
+    pthread_mutex_destroy(&conn->lock);
+}
+
+// The first connection creates the tables, the others only prepare against them
+static int open_connection(UserDBConnection* conn, const char* db_path, const UserDBConfig* config, int first) {
+    memset(conn, 0, sizeof(UserDBConnection));
+    pthread_mutex_init(&conn->lock, NULL);
+
+    // Every use of a connection is serialized by its lock, SQLite's own mutexes are redundant
+    int rc = sqlite3_open_v2(db_path, &conn->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL);
+    if (rc != SQLITE_OK) {
+        printf("Cannot open database: %s\n", sqlite3_errmsg(conn->db));
+        close_connection(conn);
+        return DB_ERROR;
+    }
+    sqlite3_busy_timeout(conn->db, config->busy_timeout_ms);
+
+    char pragmas[256];
+    char* err_msg = NULL;
+    snprintf(pragmas, sizeof(pragmas),
+             "PRAGMA journal_mode=%s; PRAGMA synchronous=%s; PRAGMA cache_size=-%d; PRAGMA temp_store=MEMORY;",
+             config->journal_mode, config->synchronous, config->cache_kb);
+    if (sqlite3_exec(conn->db, pragmas, NULL, NULL, &err_msg) != SQLITE_OK) {
+        printf("Cannot configure database: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        close_connection(conn);
+        return DB_ERROR;
+    }
+
+    if (first && create_tables(conn->db) != DB_SUCCESS) {
+        close_connection(conn);
+        return DB_ERROR;
     }
+
     // Prepare statements
     const char* auth_sql = "SELECT password_hash FROM users WHERE username = ?";
-    const char* get_user_sql = "SELECT * FROM users WHERE username = ?";
-    const char* update_user_sql = "UPDATE users SET last_login = ?, login_count = ? WHERE username = ?";
-    
-    if (sqlite3_prepare_v2(db->db, auth_sql, -1, &db->auth_stmt, NULL) != SQLITE_OK ||
-        sqlite3_prepare_v2(db->db, get_user_sql, -1, &db->get_user_stmt, NULL) != SQLITE_OK ||
-        sqlite3_prepare_v2(db->db, update_user_sql, -1, &db->update_user_stmt, NULL) != SQLITE_OK) {
-        
-        sqlite3_close(db->db);
-        free(db);
-        return NULL;
+    const char* create_sql = "INSERT INTO users (username, password_hash, created_at) VALUES (?, ?, ?)";
+    const char* get_user_sql = "SELECT user_id, username, password_hash, created_at, last_login, login_count FROM users WHERE username = ?";
+    const char* update_user_sql = "UPDATE users SET last_login = ?, login_count = login_count + 1 WHERE username = ?";
+
+    if (sqlite3_prepare_v2(conn->db, auth_sql, -1, &conn->auth_stmt, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn->db, create_sql, -1, &conn->create_stmt, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn->db, get_user_sql, -1, &conn->get_user_stmt, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn->db, update_user_sql, -1, &conn->update_user_stmt, NULL) != SQLITE_OK) {
+        printf("Cannot prepare statements: %s\n", sqlite3_errmsg(conn->db));
+        close_connection(conn);
+        return DB_ERROR;
     }
 
-    return db;
+    return DB_SUCCESS;
 }
 
+static struct timespec deadline_after(int ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
 
-int init_db_tables(UserDB* db) {
+// One transaction for the whole batch, so the WAL is appended and committed once
+static void write_login_batch(LoginWriter* writer, const PendingLogin* batch, int count) {
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    UserDBConnection* conn = writer->conn;
+    int written = 0;
+
+    pthread_mutex_lock(&conn->lock);
+    // IMMEDIATE takes the write lock up front, waiting out other writers with the busy timeout
     char* err_msg = NULL;
-    int rc = sqlite3_exec(db->db, CREATE_USERS_TABLE_SQL, NULL, NULL, &err_msg);
-    
-    if (rc != SQLITE_OK) {
-        printf("SQL error: %s\n", err_msg);
+    int in_transaction = sqlite3_exec(conn->db, "BEGIN IMMEDIATE", NULL, NULL, &err_msg) == SQLITE_OK;
+    if (!in_transaction) {
+        printf("Login batch written without a transaction: %s\n", err_msg);
         sqlite3_free(err_msg);
-        return DB_ERROR;
     }
 
-    rc = sqlite3_exec(db->db, CREATE_USERNAME_INDEX_SQL, NULL, NULL, &err_msg);
-    if (rc != SQLITE_OK) {
-        printf("SQL error: %s\n", err_msg);
+    for (int i = 0; i < count; i++) {
+        sqlite3_reset(conn->update_user_stmt);
+        sqlite3_bind_int64(conn->update_user_stmt, 1, batch[i].at);
+        sqlite3_bind_text(conn->update_user_stmt, 2, batch[i].username, -1, SQLITE_STATIC);
+        if (sqlite3_step(conn->update_user_stmt) == SQLITE_DONE) {
+            written++;
+        }
+    }
+    sqlite3_reset(conn->update_user_stmt);
+    sqlite3_clear_bindings(conn->update_user_stmt);
+
+    if (in_transaction && sqlite3_exec(conn->db, "COMMIT", NULL, NULL, &err_msg) != SQLITE_OK) {
+        printf("Failed to commit %d login updates: %s\n", count, err_msg);
         sqlite3_free(err_msg);
+        sqlite3_exec(conn->db, "ROLLBACK", NULL, NULL, NULL);
+        written = 0;
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    latency_record(LATENCY_LAST_LOGIN, (uint64_t)(finished.tv_sec - started.tv_sec) * 1000000000ULL +
+                                       (uint64_t)(finished.tv_nsec - started.tv_nsec));
+    metrics_add(METRIC_LOGIN_WRITES, written);
+    metrics_add(METRIC_LOGIN_QUEUE, -count);
+}
+
+static void* login_writer_thread(void* arg) {
+    UserDB* db = (UserDB*)arg;
+    LoginWriter* writer = db->logins;
+    metrics_thread_register("db-writer");
+
+    pthread_mutex_lock(&writer->lock);
+    while (1) {
+        // A batch goes out when it is full, when the interval is up, or at shutdown
+        struct timespec deadline = deadline_after(db->config.login_flush_ms);
+        while (writer->running && writer->count < db->config.login_batch) {
+            if (pthread_cond_timedwait(&writer->wake, &writer->lock, &deadline) == ETIMEDOUT) break;
+        }
+
+        int count = writer->count;
+        if (count == 0) {
+            if (!writer->running) break;
+            continue;
+        }
+
+        PendingLogin* batch = writer->pending;
+        writer->pending = writer->flushing;
+        writer->flushing = batch;
+        writer->count = 0;
+        pthread_cond_broadcast(&writer->space);
+        pthread_mutex_unlock(&writer->lock);
+
+        write_login_batch(writer, batch, count);
+
+        pthread_mutex_lock(&writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+static void free_login_writer(LoginWriter* writer) {
+    if (writer->conn == &writer->own) close_connection(&writer->own);
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->wake);
+    pthread_cond_destroy(&writer->space);
+    free(writer->pending);
+    free(writer->flushing);
+    free(writer);
+}
+
+static int start_login_writer(UserDB* db, const char* db_path, int in_memory) {
+    LoginWriter* writer = calloc(1, sizeof(LoginWriter));
+    if (!writer) return DB_ERROR;
+
+    // Room for a few batches, so logins only wait when the disk falls well behind
+    writer->capacity = db->config.login_batch * 4;
+    writer->pending = malloc(sizeof(PendingLogin) * writer->capacity);
+    writer->flushing = malloc(sizeof(PendingLogin) * writer->capacity);
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->wake, NULL);
+    pthread_cond_init(&writer->space, NULL);
+    writer->running = 1;
+
+    // Its own connection keeps batch writes off the workers' connections
+    writer->conn = in_memory ? &db->conns[0] : &writer->own;
+    if (!writer->pending || !writer->flushing ||
+        (!in_memory && open_connection(&writer->own, db_path, &db->config, 0) != DB_SUCCESS)) {
+        writer->conn = NULL;
+        free_login_writer(writer);
         return DB_ERROR;
     }
 
+    db->logins = writer;
+    if (pthread_create(&writer->thread, NULL, login_writer_thread, db) != 0) {
+        printf("Failed to start the login writer\n");
+        db->logins = NULL;
+        free_login_writer(writer);
+        return DB_ERROR;
+    }
     return DB_SUCCESS;
 }
 
+// Everything queued is written before the thread exits
+static void stop_login_writer(UserDB* db) {
+    LoginWriter* writer = db->logins;
+    if (!writer) return;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->running = 0;
+    pthread_cond_broadcast(&writer->wake);
+    pthread_cond_broadcast(&writer->space);
+    pthread_mutex_unlock(&writer->lock);
+
+    pthread_join(writer->thread, NULL);
+    db->logins = NULL;
+    free_login_writer(writer);
+}
+
+UserDB* open_user_db(const char* db_path, const UserDBConfig* config) {
+    if (!db_path) return NULL;
+
+    UserDB* db = malloc(sizeof(UserDB));
+    if (!db) return NULL;
+
+    db->config = config ? *config : default_user_db_config();
+    if (db->config.connections <= 0) {
+        db->config.connections = DB_POOL_CONNECTIONS;
+    }
+    // Every connection to an in-memory or temporary database gets a database of its own
+    int in_memory = db_path[0] == '\0' || strcmp(db_path, ":memory:") == 0;
+    if (in_memory) {
+        db->config.connections = 1;
+    }
+
+    db->conns = calloc(db->config.connections, sizeof(UserDBConnection));
+    if (!db->conns) {
+        free(db);
+        return NULL;
+    }
+
+    for (int i = 0; i < db->config.connections; i++) {
+        if (open_connection(&db->conns[i], db_path, &db->config, i == 0) != DB_SUCCESS) {
+            for (int j = 0; j < i; j++) {
+                close_connection(&db->conns[j]);
+            }
+            free(db->conns);
+            free(db);
+            return NULL;
+        }
+    }
+
+    db->num_conns = db->config.connections;
+    db->next_conn = 0;
+    db->id = __atomic_add_fetch(&next_db_id, 1, __ATOMIC_RELAXED);
+    db->logins = NULL;
+
+    // Without the writer, logins fall back to writing their update inline
+    if (db->config.login_batch > 0 && start_login_writer(db, db_path, in_memory) != DB_SUCCESS) {
+        printf("Login updates will be written inline\n");
+    }
+    printf("Opened %s with %d connections (journal %s, synchronous %s)\n",
+           db_path, db->num_conns, db->config.journal_mode, db->config.synchronous);
+    return db;
+}
+
+UserDB* init_user_db(const char* db_path) {
+    return open_user_db(db_path, NULL);
+}
+
+UserDBConnection* user_db_connection(UserDB* db) {
+    if (!db) return NULL;
+    if (thread_conn && thread_db_id == db->id) return thread_conn;
+
+    // First use on this thread: the next connection in line, shared round robin once all are taken
+    int index = __atomic_fetch_add(&db->next_conn, 1, __ATOMIC_RELAXED);
+    thread_conn = &db->conns[index % db->num_conns];
+    thread_db_id = db->id;
+    return thread_conn;
+}
+
+int init_db_tables(UserDB* db) {
+    if (!db) return DB_ERROR;
+
+    UserDBConnection* conn = user_db_connection(db);
+    pthread_mutex_lock(&conn->lock);
+    int rc = create_tables(conn->db);
+    pthread_mutex_unlock(&conn->lock);
+    return rc;
+}
+
 int create_user(UserDB* db, const char* username, const char* password) {
     if (!db || !username || !password) return DB_ERROR;
     
+    // Hash before taking the lock, bcrypt is the expensive part
     char password_hash[MAX_PASSWORD_LENGTH];
     hash_password(password, password_hash);
 
-    const char* sql = "INSERT INTO users (username, password_hash, created_at) VALUES (?, ?, ?)";
-    sqlite3_stmt* stmt;
-    
-    int rc = sqlite3_prepare_v2(db->db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) return DB_ERROR;
+    UserDBConnection* conn = user_db_connection(db);
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_reset(conn->create_stmt);
 
     time_t now = time(NULL);
-    sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, password_hash, -1, SQLITE_STATIC);
-    sqlite3_bind_int64(stmt, 3, now);
+    sqlite3_bind_text(conn->create_stmt, 1, username, -1, SQLITE_STATIC);
+    sqlite3_bind_text(conn->create_stmt, 2, password_hash, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(conn->create_stmt, 3, now);
 
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    int rc = sqlite3_step(conn->create_stmt);
+    sqlite3_reset(conn->create_stmt);
+    sqlite3_clear_bindings(conn->create_stmt);
+    pthread_mutex_unlock(&conn->lock);
 
     if (rc == SQLITE_CONSTRAINT) {
         return DB_USER_EXISTS;
@@ -119,30 +383,44 @@ int create_user(UserDB* db, const char* username, const char* password) {
 int authenticate_user(UserDB* db, const char* username, const char* password) {
     if (!db || !username || !password) return DB_ERROR;
 
-    
-    if (!db->auth_stmt) {
-        return DB_ERROR;
-    }
+    UserDBConnection* conn = user_db_connection(db);
+
+    // Only the lookup needs the connection, verification runs unlocked
+    char stored_hash[BCRYPT_HASHSIZE];
+    int found = 0;
 
-    sqlite3_reset(db->auth_stmt);
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_reset(conn->auth_stmt);
     
-    int bind_result = sqlite3_bind_text(db->auth_stmt, 1, username, -1, SQLITE_STATIC);
+    int bind_result = sqlite3_bind_text(conn->auth_stmt, 1, username, -1, SQLITE_STATIC);
     if (bind_result != SQLITE_OK) {
+        pthread_mutex_unlock(&conn->lock);
         return DB_ERROR;
     }
 
-    int rc = sqlite3_step(db->auth_stmt);
+    int rc = sqlite3_step(conn->auth_stmt);
     
     if (rc == SQLITE_ROW) {
-        const char* stored_hash = (const char*)sqlite3_column_text(db->auth_stmt, 0);
-        if (!stored_hash) {
-            return DB_ERROR;
+        const char* hash = (const char*)sqlite3_column_text(conn->auth_stmt, 0);
+        if (hash) {
+            strncpy(stored_hash, hash, BCRYPT_HASHSIZE - 1);
+            stored_hash[BCRYPT_HASHSIZE - 1] = '\0';
+            found = 1;
         }
-        
+    }
+    sqlite3_reset(conn->auth_stmt);
+    pthread_mutex_unlock(&conn->lock);
+
+    if (rc == SQLITE_ROW && !found) {
+        return DB_ERROR;
+    }
+
+    if (found) {
         int verify_result = verify_password(password, stored_hash);
         
         if (verify_result) {
-            update_last_login(db, username);
+            // Bookkeeping goes to the login writer, the login does not wait for the disk
+            record_login(db, username);
             return DB_SUCCESS;
         }
     }
@@ -151,79 +429,136 @@ int authenticate_user(UserDB* db, const char* username, const char* password) {
 }
 
 int update_last_login(UserDB* db, const char* username) {
-    if (!db || !username) {
-        printf("[DEBUG] Error: Database or username is null.\n");
-        return DB_ERROR;
-    }
-    
-    if (!db->update_user_stmt) {
-        printf("[DEBUG] Error: Prepared statement for updating user is null.\n");
-        return DB_ERROR;
-    }
-    
-    // Add this to see what SQL statement we're using
-    
-    sqlite3_reset(db->update_user_stmt);
+    if (!db || !username) return DB_ERROR;
     
     time_t now = time(NULL);
-    if (now == -1) {
-        printf("[DEBUG] Error: Failed to get current time.\n");
-        return DB_ERROR;
-    }
+    if (now == -1) return DB_ERROR;
     
-    int bind_time = sqlite3_bind_int64(db->update_user_stmt, 1, now);
+    UserDBConnection* conn = user_db_connection(db);
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_reset(conn->update_user_stmt);
+    
+    int bind_time = sqlite3_bind_int64(conn->update_user_stmt, 1, now);
     if (bind_time != SQLITE_OK) {
+        pthread_mutex_unlock(&conn->lock);
         return DB_ERROR;
     }
     
-    int bind_user = sqlite3_bind_text(db->update_user_stmt, 2, username, -1, SQLITE_STATIC);
+    int bind_user = sqlite3_bind_text(conn->update_user_stmt, 2, username, -1, SQLITE_STATIC);
     if (bind_user != SQLITE_OK) {
-        printf("[DEBUG] Error: Failed to bind username. SQLite error code: %d\n", bind_user);
+        pthread_mutex_unlock(&conn->lock);
         return DB_ERROR;
     }
     
-    int rc = sqlite3_step(db->update_user_stmt);
+    int rc = sqlite3_step(conn->update_user_stmt);
     
     // Get number of rows changed
-    int rows_changed = sqlite3_changes(db->db);
+    int rows_changed = sqlite3_changes(conn->db);
     
     // Reset statement after execution
-    sqlite3_reset(db->update_user_stmt);
+    sqlite3_reset(conn->update_user_stmt);
+    sqlite3_clear_bindings(conn->update_user_stmt);
+    pthread_mutex_unlock(&conn->lock);
     
     if (rc == SQLITE_DONE && rows_changed > 0) {
-        printf("[DEBUG] Update successful. User '%s' last login time updated.\n", username);
         return DB_SUCCESS;
     }
     
-    printf("[DEBUG] Update failed. SQLite return code: %d\n", rc);
+    // No row changed is an unknown user, only a failed step is worth reporting
+    if (rc != SQLITE_DONE) {
+        printf("Failed to update last login: %s\n", sqlite3_errstr(rc));
+    }
     return DB_ERROR;
 }
 
+int record_login(UserDB* db, const char* username) {
+    if (!db || !username) return DB_ERROR;
+
+    LoginWriter* writer = db->logins;
+    if (!writer) {
+        return update_last_login(db, username);
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    while (writer->running && writer->count == writer->capacity) {
+        pthread_cond_wait(&writer->space, &writer->lock);
+    }
+    if (!writer->running) {
+        pthread_mutex_unlock(&writer->lock);
+        return update_last_login(db, username);
+    }
+
+    PendingLogin* entry = &writer->pending[writer->count++];
+    strncpy(entry->username, username, MAX_USERNAME_LENGTH - 1);
+    entry->username[MAX_USERNAME_LENGTH - 1] = '\0';
+    entry->at = time(NULL);
+    if (writer->count == db->config.login_batch) {
+        pthread_cond_signal(&writer->wake);
+    }
+    metrics_inc(METRIC_LOGIN_QUEUE);
+    pthread_mutex_unlock(&writer->lock);
+
+    return DB_SUCCESS;
+}
+
+int get_user_data(UserDB* db, const char* username, UserData* data) {
+    if (!db || !username || !data) return DB_ERROR;
+
+    UserDBConnection* conn = user_db_connection(db);
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_reset(conn->get_user_stmt);
+    sqlite3_bind_text(conn->get_user_stmt, 1, username, -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(conn->get_user_stmt);
+    if (rc == SQLITE_ROW) {
+        const char* name = (const char*)sqlite3_column_text(conn->get_user_stmt, 1);
+        const char* hash = (const char*)sqlite3_column_text(conn->get_user_stmt, 2);
+
+        memset(data, 0, sizeof(UserData));
+        data->user_id = sqlite3_column_int(conn->get_user_stmt, 0);
+        if (name) strncpy(data->username, name, sizeof(data->username) - 1);
+        if (hash) strncpy(data->password_hash, hash, sizeof(data->password_hash) - 1);
+        data->created_at = (time_t)sqlite3_column_int64(conn->get_user_stmt, 3);
+        data->last_login = (time_t)sqlite3_column_int64(conn->get_user_stmt, 4); // 0 if never
+        data->login_count = sqlite3_column_int(conn->get_user_stmt, 5);
+    }
+    sqlite3_reset(conn->get_user_stmt);
+    pthread_mutex_unlock(&conn->lock);
+
+    if (rc == SQLITE_ROW) return DB_SUCCESS;
+    return (rc == SQLITE_DONE) ? DB_NOT_FOUND : DB_ERROR;
+}
 
 void close_user_db(UserDB* db) {
     if (!db) return;
 
-    if (db->auth_stmt) sqlite3_finalize(db->auth_stmt);
-    if (db->update_user_stmt) sqlite3_finalize(db->update_user_stmt);
-    if (db->get_user_stmt) sqlite3_finalize(db->get_user_stmt);
-    
-    if (db->db) sqlite3_close(db->db);
+    // Queued login updates first, then the last connection to close checkpoints the WAL
+    stop_login_writer(db);
+    for (int i = 0; i < db->num_conns; i++) {
+        close_connection(&db->conns[i]);
+    }
+    free(db->conns);
     free(db);
 }
 
 int backup_db(UserDB* db, const char* backup_path) {
+    if (!db || !backup_path) return DB_ERROR;
+
     sqlite3* backup_db;
     int rc = sqlite3_open(backup_path, &backup_db);
     if (rc != SQLITE_OK) return DB_ERROR;
 
-    sqlite3_backup* backup = sqlite3_backup_init(backup_db, "main", db->db, "main");
+    UserDBConnection* conn = user_db_connection(db);
+    pthread_mutex_lock(&conn->lock);
+    sqlite3_backup* backup = sqlite3_backup_init(backup_db, "main", conn->db, "main");
     if (backup) {
         sqlite3_backup_step(backup, -1);
         sqlite3_backup_finish(backup);
     }
+    pthread_mutex_unlock(&conn->lock);
 
     rc = sqlite3_errcode(backup_db);
     sqlite3_close(backup_db);
 
     return (rc == SQLITE_OK) ? DB_SUCCESS : DB_ERROR;
-}
\ No newline at end of file
+}
@@ -0,0 +1,83 @@
+#include "util/buffer_pool.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+static void* allocate_block(size_t block_size) {
+    // aligned_alloc wants a multiple of the alignment
+    size_t size = (block_size + BUFFER_POOL_ALIGN - 1) & ~(size_t)(BUFFER_POOL_ALIGN - 1);
+    return aligned_alloc(BUFFER_POOL_ALIGN, size);
+}
+
+BufferPool* create_buffer_pool(size_t block_size, int prealloc) {
+    if (block_size < sizeof(BufferBlock)) return NULL;
+
+    BufferPool* pool = (BufferPool*)malloc(sizeof(BufferPool));
+    if (!pool) return NULL;
+
+    pool->block_size = block_size;
+    pool->free_list = NULL;
+    pool->free_count = 0;
+    pool->total = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+
+    for (int i = 0; i < prealloc; i++) {
+        BufferBlock* block = (BufferBlock*)allocate_block(block_size);
+        if (!block) break;
+        block->next = pool->free_list;
+        pool->free_list = block;
+        pool->free_count++;
+        pool->total++;
+    }
+
+    return pool;
+}
+
+void destroy_buffer_pool(BufferPool* pool) {
+    if (!pool) return;
+
+    if (pool->free_count != pool->total) {
+        printf("Buffer pool destroyed with %d blocks still in use\n", pool->total - pool->free_count);
+    }
+
+    BufferBlock* block = pool->free_list;
+    while (block) {
+        BufferBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+void* buffer_pool_get(BufferPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    BufferBlock* block = pool->free_list;
+    if (block) {
+        pool->free_list = block->next;
+        pool->free_count--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (block) return block;
+
+    // Pool is dry, grow it
+    block = (BufferBlock*)allocate_block(pool->block_size);
+    if (block) {
+        pthread_mutex_lock(&pool->lock);
+        pool->total++;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return block;
+}
+
+void buffer_pool_put(BufferPool* pool, void* block) {
+    if (!block) return;
+
+    BufferBlock* node = (BufferBlock*)block;
+    pthread_mutex_lock(&pool->lock);
+    node->next = pool->free_list;
+    pool->free_list = node;
+    pool->free_count++;
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,59 @@
+#include "util/histogram.h"
+#include <string.h>
+
+uint64_t histogram_bucket_value(int bucket) {
+    if (bucket < HISTOGRAM_SUB_BUCKETS) return (uint64_t)bucket;
+
+    // Bucket group g covers [2^(g+3), 2^(g+4)) in 16 steps of 2^(g-1)
+    int shift = (bucket >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t low = (uint64_t)(HISTOGRAM_SUB_BUCKETS + (bucket & (HISTOGRAM_SUB_BUCKETS - 1))) << shift;
+    return low + ((1ULL << shift) - 1);
+}
+
+void histogram_reset(Histogram* histogram) {
+    memset(histogram, 0, sizeof(Histogram));
+}
+
+void histogram_merge(Histogram* into, const Histogram* from) {
+    into->count += __atomic_load_n(&from->count, __ATOMIC_RELAXED);
+    into->sum += __atomic_load_n(&from->sum, __ATOMIC_RELAXED);
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        into->buckets[i] += __atomic_load_n(&from->buckets[i], __ATOMIC_RELAXED);
+    }
+}
+
+void histogram_delta(Histogram* into, const Histogram* now, const Histogram* before) {
+    into->count = now->count - before->count;
+    into->sum = now->sum - before->sum;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        into->buckets[i] = now->buckets[i] - before->buckets[i];
+    }
+}
+
+uint64_t histogram_percentile(const Histogram* histogram, double percentile) {
+    // Buckets are summed rather than trusting count, a concurrent read may see them out of step
+    uint64_t total = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        total += histogram->buckets[i];
+    }
+    if (total == 0) return 0;
+
+    if (percentile < 0) percentile = 0;
+    if (percentile > 100) percentile = 100;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * total + 0.5);
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) return histogram_bucket_value(i);
+    }
+    return histogram_max(histogram);
+}
+
+uint64_t histogram_max(const Histogram* histogram) {
+    for (int i = HISTOGRAM_BUCKETS - 1; i >= 0; i--) {
+        if (histogram->buckets[i]) return histogram_bucket_value(i);
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "util/mpsc_queue.h"
+#include <stddef.h>
+
+void mpsc_init(MpscQueue* queue) {
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+void mpsc_push(MpscQueue* queue, MpscNode* node) {
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    // Claim the head, then link the previous node to us; until the link is stored
+    // the consumer sees the queue end at prev
+    MpscNode* prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+MpscNode* mpsc_pop(MpscQueue* queue) {
+    MpscNode* tail = queue->tail;
+    MpscNode* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    // Step over the stub, it only keeps the list non-empty
+    if (tail == &queue->stub) {
+        if (!next) return NULL;
+        queue->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+
+    // tail is the last linked node; a producer has already claimed the head after it
+    MpscNode* head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (tail != head) return NULL;
+
+    // Put the stub back behind the last node so the node itself can be handed out
+    mpsc_push(queue, &queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
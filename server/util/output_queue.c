@@ -0,0 +1,134 @@
+#include "util/output_queue.h"
+#include <stdlib.h>
+
+SharedBuffer* shared_buffer_create(SlabClasses* slabs, uint32_t length) {
+    SharedBuffer* buffer = (SharedBuffer*)slab_alloc_size(slabs, sizeof(SharedBuffer) + length);
+    if (!buffer) return NULL;
+
+    buffer->refs = 1;
+    buffer->length = length;
+    return buffer;
+}
+
+void shared_buffer_ref(SharedBuffer* buffer) {
+    __atomic_fetch_add(&buffer->refs, 1, __ATOMIC_RELAXED);
+}
+
+// Acquire on the last release so the free happens after every other holder is done
+void shared_buffer_unref(SharedBuffer* buffer) {
+    if (__atomic_fetch_sub(&buffer->refs, 1, __ATOMIC_ACQ_REL) == 1) {
+        slab_free(buffer);
+    }
+}
+
+void output_init(OutputQueue* queue, uint8_t* data, uint32_t capacity) {
+    ring_init(&queue->ring, data, capacity);
+    queue->ref_head = 0;
+    queue->ref_tail = 0;
+    queue->ref_sent = 0;
+    queue->shared_bytes = 0;
+}
+
+int output_append(OutputQueue* queue, const struct iovec* iov, int iovcnt) {
+    return ring_append(&queue->ring, iov, iovcnt);
+}
+
+int output_append_shared(OutputQueue* queue, SharedBuffer* buffer) {
+    if (queue->ref_tail - queue->ref_head == OUTPUT_MAX_SHARED) return -1;
+
+    OutputRef* ref = &queue->refs[queue->ref_tail & (OUTPUT_MAX_SHARED - 1)];
+    shared_buffer_ref(buffer);
+    ref->buffer = buffer;
+    ref->position = queue->ring.tail;
+    queue->ref_tail++;
+    queue->shared_bytes += buffer->length;
+    return 1;
+}
+
+// Ring bytes that go before the next shared buffer (or all of them)
+static uint32_t ring_span(const OutputQueue* queue, uint32_t position, uint32_t ref) {
+    uint32_t limit = ref != queue->ref_tail ?
+        queue->refs[ref & (OUTPUT_MAX_SHARED - 1)].position : queue->ring.tail;
+    return limit - position;
+}
+
+int output_peek_iov(const OutputQueue* queue, struct iovec* iov, int max) {
+    const RingBuffer* ring = &queue->ring;
+    uint32_t position = ring->head;
+    uint32_t ref = queue->ref_head;
+    uint32_t sent = queue->ref_sent;
+    int count = 0;
+
+    while (count < max) {
+        uint32_t span = ring_span(queue, position, ref);
+        if (span > 0) {
+            // Up to two pieces if the span wraps
+            uint32_t offset = position & (ring->capacity - 1);
+            uint32_t first = ring->capacity - offset;
+            if (first > span) {
+                first = span;
+            }
+            iov[count].iov_base = ring->data + offset;
+            iov[count].iov_len = first;
+            count++;
+            position += first;
+            continue;
+        }
+
+        if (ref == queue->ref_tail) break;
+        const SharedBuffer* buffer = queue->refs[ref & (OUTPUT_MAX_SHARED - 1)].buffer;
+        iov[count].iov_base = (void*)(buffer->data + sent);
+        iov[count].iov_len = buffer->length - sent;
+        count++;
+        sent = 0;
+        ref++;
+    }
+    return count;
+}
+
+void output_consume(OutputQueue* queue, uint32_t length) {
+    RingBuffer* ring = &queue->ring;
+
+    while (length > 0) {
+        uint32_t span = ring_span(queue, ring->head, queue->ref_head);
+        if (span > 0) {
+            uint32_t take = span < length ? span : length;
+            ring->head += take;
+            length -= take;
+            continue;
+        }
+
+        if (queue->ref_head == queue->ref_tail) break;
+        OutputRef* ref = &queue->refs[queue->ref_head & (OUTPUT_MAX_SHARED - 1)];
+        uint32_t remaining = ref->buffer->length - queue->ref_sent;
+        uint32_t take = remaining < length ? remaining : length;
+        queue->ref_sent += take;
+        queue->shared_bytes -= take;
+        length -= take;
+        if (queue->ref_sent == ref->buffer->length) {
+            shared_buffer_unref(ref->buffer);
+            queue->ref_head++;
+            queue->ref_sent = 0;
+        }
+    }
+
+    // Restart the ring at offset 0 once drained, queued buffers then follow position 0
+    if (ring->head == ring->tail && ring->head != 0) {
+        for (uint32_t i = queue->ref_head; i != queue->ref_tail; i++) {
+            queue->refs[i & (OUTPUT_MAX_SHARED - 1)].position = 0;
+        }
+        ring->head = 0;
+        ring->tail = 0;
+    }
+}
+
+void output_reset(OutputQueue* queue) {
+    while (queue->ref_head != queue->ref_tail) {
+        shared_buffer_unref(queue->refs[queue->ref_head & (OUTPUT_MAX_SHARED - 1)].buffer);
+        queue->ref_head++;
+    }
+    queue->ref_sent = 0;
+    queue->shared_bytes = 0;
+    queue->ring.head = 0;
+    queue->ring.tail = 0;
+}
@@ -0,0 +1,68 @@
+#include "util/ring_buffer.h"
+#include <string.h>
+
+void ring_init(RingBuffer* ring, uint8_t* data, uint32_t capacity) {
+    ring->data = data;
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+uint32_t ring_write(RingBuffer* ring, const void* bytes, uint32_t length) {
+    uint32_t available = ring_free(ring);
+    if (length > available) {
+        length = available;
+    }
+
+    uint32_t offset = ring->tail & (ring->capacity - 1);
+    uint32_t first = ring->capacity - offset;
+    if (first > length) {
+        first = length;
+    }
+
+    memcpy(ring->data + offset, bytes, first);
+    memcpy(ring->data, (const uint8_t*)bytes + first, length - first);
+    ring->tail += length;
+    return length;
+}
+
+int ring_append(RingBuffer* ring, const struct iovec* iov, int iovcnt) {
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    if (total > ring_free(ring)) return -1;
+
+    for (int i = 0; i < iovcnt; i++) {
+        ring_write(ring, iov[i].iov_base, (uint32_t)iov[i].iov_len);
+    }
+    return 1;
+}
+
+int ring_peek_iov(const RingBuffer* ring, struct iovec iov[2]) {
+    uint32_t used = ring_used(ring);
+    if (used == 0) return 0;
+
+    uint32_t offset = ring->head & (ring->capacity - 1);
+    uint32_t first = ring->capacity - offset;
+    if (first > used) {
+        first = used;
+    }
+
+    iov[0].iov_base = ring->data + offset;
+    iov[0].iov_len = first;
+    if (first == used) return 1;
+
+    iov[1].iov_base = ring->data;
+    iov[1].iov_len = used - first;
+    return 2;
+}
+
+void ring_consume(RingBuffer* ring, uint32_t length) {
+    ring->head += length;
+    if (ring->head == ring->tail) {
+        // Restart at offset 0 so the next output is one contiguous span
+        ring->head = 0;
+        ring->tail = 0;
+    }
+}
@@ -0,0 +1,222 @@
+#include "util/slab.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Thread's magazine, the same index in every cache
+static __thread int magazine_slot = -1;
+static int next_magazine_slot = 0;
+
+static int acquire_magazine_slot(void) {
+    if (magazine_slot == -1) {
+        int slot = __atomic_fetch_add(&next_magazine_slot, 1, __ATOMIC_RELAXED);
+        magazine_slot = slot < SLAB_MAX_THREADS ? slot : -2;
+    }
+    return magazine_slot;
+}
+
+static inline Slab* slab_of(void* object) {
+    return (Slab*)((uintptr_t)object & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+// New slab, every object straight into the depot (lock held)
+static int grow_cache(SlabCache* cache) {
+    Slab* slab = (Slab*)aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+    if (!slab) return -1;
+
+    slab->cache = cache;
+    slab->next = cache->slabs;
+    cache->slabs = slab;
+    cache->num_slabs++;
+
+    uint8_t* object = (uint8_t*)slab + SLAB_HEADER;
+    for (int i = 0; i < cache->per_slab; i++) {
+        SlabObject* free_object = (SlabObject*)object;
+        free_object->next = cache->depot;
+        cache->depot = free_object;
+        object += cache->object_size;
+    }
+    cache->depot_count += cache->per_slab;
+    return 1;
+}
+
+// Lock held
+static void* depot_pop(SlabCache* cache) {
+    if (!cache->depot && grow_cache(cache) < 0) return NULL;
+
+    SlabObject* object = cache->depot;
+    cache->depot = object->next;
+    cache->depot_count--;
+    return object;
+}
+
+// Lock held
+static void depot_push(SlabCache* cache, void* object) {
+    SlabObject* free_object = (SlabObject*)object;
+    free_object->next = cache->depot;
+    cache->depot = free_object;
+    cache->depot_count++;
+}
+
+SlabCache* create_slab_cache(const char* name, size_t object_size, int prealloc) {
+    if (object_size == 0 || object_size > SLAB_MAX_OBJECT) return NULL;
+
+    SlabCache* cache = (SlabCache*)calloc(1, sizeof(SlabCache));
+    if (!cache) return NULL;
+
+    strncpy(cache->name, name ? name : "slab", SLAB_NAME_LENGTH - 1);
+    // Cache line aligned once an object spans one, so neighbours never share a line
+    size_t align = object_size >= 64 ? 64 : 16;
+    cache->object_size = (object_size + align - 1) & ~(align - 1);
+    cache->per_slab = (int)((SLAB_SIZE - SLAB_HEADER) / cache->object_size);
+    pthread_mutex_init(&cache->lock, NULL);
+
+    while (cache->depot_count < prealloc) {
+        if (grow_cache(cache) < 0) break;
+    }
+    return cache;
+}
+
+void slab_cache_stats(SlabCache* cache, SlabStats* stats) {
+    memset(stats, 0, sizeof(SlabStats));
+    stats->object_size = cache->object_size;
+
+    for (int i = 0; i < SLAB_MAX_THREADS; i++) {
+        stats->allocs += cache->magazines[i].allocs;
+        stats->frees += cache->magazines[i].frees;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    stats->slabs = cache->num_slabs;
+    stats->objects = (unsigned long)cache->num_slabs * cache->per_slab;
+    stats->allocs += cache->shared_allocs;
+    stats->frees += cache->shared_frees;
+    stats->refills = cache->refills;
+    pthread_mutex_unlock(&cache->lock);
+
+    stats->in_use = stats->allocs > stats->frees ? stats->allocs - stats->frees : 0;
+}
+
+void destroy_slab_cache(SlabCache* cache) {
+    if (!cache) return;
+
+    SlabStats stats;
+    slab_cache_stats(cache, &stats);
+    if (stats.allocs > 0) {
+        printf("Slab %s: %zu byte objects, %d slabs, %lu allocs, %lu frees, %lu depot refills\n",
+               cache->name, stats.object_size, stats.slabs, stats.allocs, stats.frees, stats.refills);
+    }
+    if (stats.in_use > 0) {
+        printf("Slab %s destroyed with %lu objects still in use\n", cache->name, stats.in_use);
+    }
+
+    Slab* slab = cache->slabs;
+    while (slab) {
+        Slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+void* slab_alloc(SlabCache* cache) {
+    int slot = acquire_magazine_slot();
+    if (slot < 0) {
+        pthread_mutex_lock(&cache->lock);
+        void* object = depot_pop(cache);
+        if (object) {
+            cache->shared_allocs++;
+        }
+        pthread_mutex_unlock(&cache->lock);
+        return object;
+    }
+
+    SlabMagazine* magazine = &cache->magazines[slot];
+    if (magazine->count == 0) {
+        // Half a magazine per trip, the other half is room for frees; at most one new slab
+        pthread_mutex_lock(&cache->lock);
+        int grown = 0;
+        while (magazine->count < SLAB_MAGAZINE / 2) {
+            if (!cache->depot) {
+                if (grown || grow_cache(cache) < 0) break;
+                grown = 1;
+            }
+            magazine->objects[magazine->count++] = depot_pop(cache);
+        }
+        cache->refills++;
+        pthread_mutex_unlock(&cache->lock);
+
+        if (magazine->count == 0) return NULL;
+    }
+
+    magazine->allocs++;
+    return magazine->objects[--magazine->count];
+}
+
+void slab_free(void* object) {
+    if (!object) return;
+
+    SlabCache* cache = slab_of(object)->cache;
+    int slot = acquire_magazine_slot();
+    if (slot < 0) {
+        pthread_mutex_lock(&cache->lock);
+        depot_push(cache, object);
+        cache->shared_frees++;
+        pthread_mutex_unlock(&cache->lock);
+        return;
+    }
+
+    // Objects freed on another thread than they came from flow back through the depot
+    SlabMagazine* magazine = &cache->magazines[slot];
+    if (magazine->count == SLAB_MAGAZINE) {
+        pthread_mutex_lock(&cache->lock);
+        while (magazine->count > SLAB_MAGAZINE / 2) {
+            depot_push(cache, magazine->objects[--magazine->count]);
+        }
+        cache->refills++;
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    magazine->objects[magazine->count++] = object;
+    magazine->frees++;
+}
+
+SlabClasses* create_slab_classes(const char* name) {
+    SlabClasses* classes = (SlabClasses*)calloc(1, sizeof(SlabClasses));
+    if (!classes) return NULL;
+
+    size_t size = SLAB_MIN_CLASS;
+    for (int i = 0; i < SLAB_CLASSES; i++, size <<= 1) {
+        char class_name[SLAB_NAME_LENGTH];
+        snprintf(class_name, sizeof(class_name), "%s-%zu", name ? name : "slab", size);
+        classes->classes[i] = create_slab_cache(class_name, size, 0);
+        if (!classes->classes[i]) {
+            destroy_slab_classes(classes);
+            return NULL;
+        }
+    }
+    return classes;
+}
+
+void destroy_slab_classes(SlabClasses* classes) {
+    if (!classes) return;
+
+    for (int i = 0; i < SLAB_CLASSES; i++) {
+        destroy_slab_cache(classes->classes[i]);
+    }
+    free(classes);
+}
+
+void* slab_alloc_size(SlabClasses* classes, size_t size) {
+    if (size > SLAB_MAX_OBJECT) return NULL;
+
+    // Index of the power of 2 at or above size, counted from SLAB_MIN_CLASS
+    int index = 0;
+    if (size > SLAB_MIN_CLASS) {
+        index = (64 - __builtin_clzll((unsigned long long)(size - 1))) - 6;
+    }
+    return slab_alloc(classes->classes[index]);
+}
@@ -0,0 +1,137 @@
+#include "util/timer_wheel.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define MAX_DELTA ((1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+static void list_init(TimerNode* head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static void list_append(TimerNode* head, TimerNode* timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+static void list_unlink(TimerNode* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+// Pick the level from how far away the timer is, the slot from its absolute tick
+static void wheel_insert(TimerWheel* wheel, TimerNode* timer) {
+    if (timer->expires < wheel->current) {
+        timer->expires = wheel->current;
+    }
+
+    uint64_t delta = timer->expires - wheel->current;
+    if (delta > MAX_DELTA) {
+        // Fires early at the horizon, owners re-check their own deadline
+        timer->expires = wheel->current + MAX_DELTA;
+        delta = MAX_DELTA;
+    }
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+
+    int slot = (int)((timer->expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+    list_append(&wheel->slots[level][slot], timer);
+}
+
+// Move a higher level slot down now that its range is within reach
+static int cascade(TimerWheel* wheel, int level) {
+    int slot = (int)((wheel->current >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+    TimerNode* head = &wheel->slots[level][slot];
+
+    while (head->next != head) {
+        TimerNode* timer = head->next;
+        list_unlink(timer);
+        wheel_insert(wheel, timer);
+    }
+    return slot;
+}
+
+void timer_wheel_init(TimerWheel* wheel, uint64_t now_ms) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&wheel->slots[level][slot]);
+        }
+    }
+    wheel->current = now_ms / TIMER_WHEEL_TICK_MS;
+    wheel->pending = 0;
+}
+
+void timer_init(TimerNode* timer, TimerCallback callback, void* owner) {
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->owner = owner;
+}
+
+void timer_wheel_schedule(TimerWheel* wheel, TimerNode* timer, uint64_t expires_ms) {
+    if (timer_pending(timer)) {
+        list_unlink(timer);
+    } else {
+        wheel->pending++;
+    }
+
+    timer->expires = (expires_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    wheel_insert(wheel, timer);
+}
+
+void timer_wheel_cancel(TimerWheel* wheel, TimerNode* timer) {
+    if (!timer_pending(timer)) return;
+
+    list_unlink(timer);
+    wheel->pending--;
+}
+
+int timer_wheel_advance(TimerWheel* wheel, uint64_t now_ms) {
+    uint64_t now = now_ms / TIMER_WHEEL_TICK_MS;
+    int fired = 0;
+
+    while (wheel->current <= now) {
+        int slot = (int)(wheel->current & SLOT_MASK);
+
+        // Level 0 wrapped: pull the next range down, and so on up the levels
+        for (int level = 1; slot == 0 && level < TIMER_WHEEL_LEVELS; level++) {
+            if (cascade(wheel, level) != 0) break;
+        }
+
+        // Detach the slot first, callbacks may schedule or cancel other timers
+        TimerNode due;
+        list_init(&due);
+        TimerNode* head = &wheel->slots[0][slot];
+        if (head->next != head) {
+            due.next = head->next;
+            due.prev = head->prev;
+            due.next->prev = &due;
+            due.prev->next = &due;
+            list_init(head);
+        }
+
+        wheel->current++;
+
+        while (due.next != &due) {
+            TimerNode* timer = due.next;
+            list_unlink(timer);
+            wheel->pending--;
+            fired++;
+            timer->callback(timer);
+        }
+
+        if (wheel->pending == 0 && wheel->current <= now) {
+            wheel->current = now + 1;  // Nothing to run, skip the idle ticks
+        }
+    }
+
+    return fired;
+}
@@ -1,156 +1,643 @@
 #include "util/user_cache.h"
+#include <stdio.h>
+
+#define ENTRY_REMOVED 1  // Flag for entries deleted from the table being drained
+
+// Thread's read slot, shared by every cache (index into UserCache.readers)
+static __thread int reader_slot = -1;
+static int next_reader_slot = 0;
+
+// Copy a username into a zero padded key so comparisons are one fixed-size memcmp
+static void make_key(const char* username, char key[MAX_USERNAME]) {
+    memset(key, 0, MAX_USERNAME);
+    strncpy(key, username, MAX_USERNAME - 1);
+}
+
+static uint64_t random_seed(void) {
+    uint64_t seed = 0;
+    FILE* urandom = fopen("/dev/urandom", "r");
+    if (urandom) {
+        if (fread(&seed, sizeof(seed), 1, urandom) != 1) {
+            seed = 0;
+        }
+        fclose(urandom);
+    }
+    if (!seed) {
+        seed = (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)&seed;
+    }
+    return seed;
+}
+
+/*
+ * Epoch protection for lock-free readers
+ * A reader publishes the epoch it entered with; a retired table is freed once
+ * no reader is still inside an epoch at or before the one it was retired in
+ */
+
+static int acquire_reader_slot(void) {
+    if (reader_slot == -1) {
+        int slot = __atomic_fetch_add(&next_reader_slot, 1, __ATOMIC_RELAXED);
+        reader_slot = slot < USER_CACHE_MAX_READERS ? slot : -2;
+    }
+    return reader_slot;
+}
+
+static void read_enter(UserCache* cache, int slot) {
+    uint64_t epoch = __atomic_load_n(&cache->epoch, __ATOMIC_ACQUIRE);
+    // Full barrier: the epoch must be visible before any table pointer is loaded
+    __atomic_store_n(&cache->readers[slot].active, epoch, __ATOMIC_SEQ_CST);
+}
+
+static void read_exit(UserCache* cache, int slot) {
+    __atomic_store_n(&cache->readers[slot].active, 0, __ATOMIC_RELEASE);
+}
+
+static uint64_t oldest_active_epoch(UserCache* cache) {
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < USER_CACHE_MAX_READERS; i++) {
+        uint64_t active = __atomic_load_n(&cache->readers[i].active, __ATOMIC_ACQUIRE);
+        if (active && active < oldest) {
+            oldest = active;
+        }
+    }
+    return oldest;
+}
+
+// Free every retired table no reader can still be looking at (retire_lock held)
+static void reclaim_tables(UserCache* cache) {
+    uint64_t oldest = oldest_active_epoch(cache);
+    RetiredTable** link = &cache->retired;
+
+    while (*link) {
+        RetiredTable* retired = *link;
+        if (retired->epoch < oldest) {
+            *link = retired->next;
+            free(retired->table);
+            free(retired);
+        } else {
+            link = &retired->next;
+        }
+    }
+}
+
+// Called after the table has been unlinked from its stripe
+static void retire_table(UserCache* cache, UserTable* table) {
+    RetiredTable* retired = malloc(sizeof(RetiredTable));
+
+    pthread_mutex_lock(&cache->retire_lock);
+    uint64_t epoch = __atomic_fetch_add(&cache->epoch, 1, __ATOMIC_SEQ_CST);
+    if (retired) {
+        retired->table = table;
+        retired->epoch = epoch;
+        retired->next = cache->retired;
+        cache->retired = retired;
+    } else {
+        // No bookkeeping memory: leak rather than risk a reader use-after-free
+        printf("UserCache: failed to retire table of %u slots\n", table->mask + 1);
+    }
+    reclaim_tables(cache);
+    pthread_mutex_unlock(&cache->retire_lock);
+}
+
+/*
+ * Per-stripe Robin Hood table
+ */
+
+static UserTable* table_create(uint32_t capacity) {
+    UserTable* table = calloc(1, sizeof(UserTable) + (size_t)capacity * sizeof(UserEntry));
+    if (!table) return NULL;
+    table->mask = capacity - 1;
+    table->size = 0;
+    return table;
+}
+
+static inline uint32_t probe_distance(const UserTable* table, uint32_t hash, uint32_t pos) {
+    return (pos - (hash & table->mask)) & table->mask;
+}
+
+static int table_find(const UserTable* table, const char* key, uint32_t hash) {
+    uint32_t pos = hash & table->mask;
+
+    // Bounded so a reader racing a writer always terminates (the seqlock rejects the result)
+    for (uint32_t dist = 0; dist <= table->mask; dist++) {
+        const UserEntry* entry = &table->slots[pos];
+        if (entry->hash == 0) return -1;
+        // Robin Hood invariant: we would have been placed before a richer entry
+        if (probe_distance(table, entry->hash, pos) < dist) return -1;
+        if (entry->hash == hash && memcmp(entry->username, key, MAX_USERNAME) == 0) {
+            return (int)pos;
+        }
+        pos = (pos + 1) & table->mask;
+    }
+    return -1;
+}
+
+// Caller guarantees the key is absent and the table has a free slot
+static void table_insert(UserTable* table, UserEntry entry) {
+    uint32_t pos = entry.hash & table->mask;
+    uint32_t dist = 0;
+
+    while (1) {
+        UserEntry* slot = &table->slots[pos];
+        if (slot->hash == 0) {
+            *slot = entry;
+            table->size++;
+            return;
+        }
+
+        uint32_t slot_dist = probe_distance(table, slot->hash, pos);
+        if (slot_dist < dist) {
+            // Take from the rich, carry the displaced entry onward
+            UserEntry displaced = *slot;
+            *slot = entry;
+            entry = displaced;
+            dist = slot_dist;
+        }
+        pos = (pos + 1) & table->mask;
+        dist++;
+    }
+}
+
+// Backward shift deletion keeps probe sequences tombstone free
+static void table_erase(UserTable* table, uint32_t pos) {
+    uint32_t next = (pos + 1) & table->mask;
+
+    while (table->slots[next].hash != 0 &&
+           probe_distance(table, table->slots[next].hash, next) != 0) {
+        table->slots[pos] = table->slots[next];
+        pos = next;
+        next = (next + 1) & table->mask;
+    }
+
+    memset(&table->slots[pos], 0, sizeof(UserEntry));
+    table->size--;
+}
+
+/*
+ * Stripe level: incremental growth, lookups across the live and draining tables
+ */
+
+// Entries of the old table below migrate_pos have already moved
+static int old_entry_live(const UserTable* old, uint32_t migrate_pos, uint32_t pos) {
+    const UserEntry* entry = &old->slots[pos];
+    return pos >= migrate_pos && entry->hash != 0 && entry->flags != ENTRY_REMOVED;
+}
+
+static const UserEntry* stripe_find(const UserTable* table, const UserTable* old,
+                                    uint32_t migrate_pos, const char* key, uint32_t hash) {
+    int pos = table_find(table, key, hash);
+    if (pos >= 0) return &table->slots[pos];
+
+    if (old) {
+        pos = table_find(old, key, hash);
+        if (pos >= 0 && old_entry_live(old, migrate_pos, (uint32_t)pos)) {
+            return &old->slots[pos];
+        }
+    }
+    return NULL;
+}
+
+static void write_begin(UserCacheStripe* stripe) {
+    pthread_mutex_lock(&stripe->lock);
+    __atomic_store_n(&stripe->seq, stripe->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(UserCacheStripe* stripe) {
+    __atomic_store_n(&stripe->seq, stripe->seq + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+// Move a few old slots into the new table (inside write_begin/end); returns the drained table
+static UserTable* migrate_step(UserCacheStripe* stripe, uint32_t steps) {
+    UserTable* old = stripe->old;
+    if (!old) return NULL;
+
+    uint32_t old_capacity = old->mask + 1;
+    while (steps-- > 0 && stripe->migrate_pos < old_capacity) {
+        if (old_entry_live(old, stripe->migrate_pos, stripe->migrate_pos)) {
+            table_insert(stripe->table, old->slots[stripe->migrate_pos]);
+        }
+        stripe->migrate_pos++;
+    }
+
+    if (stripe->migrate_pos < old_capacity) return NULL;
+
+    __atomic_store_n(&stripe->old, NULL, __ATOMIC_RELEASE);
+    stripe->migrate_pos = 0;
+    return old;
+}
+
+// Returns the table that finished draining (to retire) or NULL; -1 via *failed on OOM
+static UserTable* start_resize(UserCacheStripe* stripe, int* failed) {
+    // A previous resize must finish before the current table starts draining
+    UserTable* drained = NULL;
+    if (stripe->old) {
+        drained = migrate_step(stripe, stripe->old->mask + 1);
+    }
+
+    UserTable* bigger = table_create((stripe->table->mask + 1) * 2);
+    if (!bigger) {
+        *failed = 1;
+        return drained;
+    }
+
+    stripe->migrate_pos = 0;
+    __atomic_store_n(&stripe->old, stripe->table, __ATOMIC_RELEASE);
+    __atomic_store_n(&stripe->table, bigger, __ATOMIC_RELEASE);
+    return drained;
+}
+
+// Writer side lookup; returns the table holding the entry (pos in *pos_out) or NULL
+static UserTable* stripe_locate(UserCacheStripe* stripe, const char* key, uint32_t hash, int* pos_out) {
+    int pos = table_find(stripe->table, key, hash);
+    if (pos >= 0) {
+        *pos_out = pos;
+        return stripe->table;
+    }
+
+    if (stripe->old) {
+        pos = table_find(stripe->old, key, hash);
+        if (pos >= 0 && old_entry_live(stripe->old, stripe->migrate_pos, (uint32_t)pos)) {
+            *pos_out = pos;
+            return stripe->old;
+        }
+    }
+    return NULL;
+}
+
+static void port_count_add(UserCache* cache, int port, int delta) {
+    __atomic_fetch_add(&cache->port_counts[port], delta, __ATOMIC_RELAXED);
+}
+
+// Remove the entry at pos of either stripe table (inside write_begin/end)
+static void stripe_erase(UserCache* cache, UserCacheStripe* stripe, UserTable* table, uint32_t pos) {
+    int port = table->slots[pos].port;
+
+    if (table == stripe->table) {
+        table_erase(table, pos);
+    } else {
+        // The old table is frozen while draining, flag instead of shifting
+        table->slots[pos].flags = ENTRY_REMOVED;
+        table->size--;
+    }
+
+    stripe->count--;
+    port_count_add(cache, port, -1);
+    __atomic_fetch_sub(&cache->size, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Expiry queue: one record per last_active change, appended in time order
+ * so expired entries are always at the head
+ */
+
+static int expiry_grow(ExpiryQueue* queue) {
+    uint32_t capacity = queue->capacity ? queue->capacity * 2 : USER_CACHE_EXPIRY_INIT;
+    ExpiryRecord* records = malloc((size_t)capacity * sizeof(ExpiryRecord));
+    if (!records) return -1;
+
+    for (uint32_t i = 0; i < queue->count; i++) {
+        records[i] = queue->records[(queue->head + i) & (queue->capacity - 1)];
+    }
+    free(queue->records);
+    queue->records = records;
+    queue->head = 0;
+    queue->capacity = capacity;
+    return 0;
+}
+
+// Queue the entry's current last_active, superseding any earlier record for it
+static void expiry_push(UserCacheStripe* stripe, UserEntry* entry) {
+    ExpiryQueue* queue = &stripe->expiry;
+    if (queue->count == queue->capacity && expiry_grow(queue) < 0) {
+        printf("UserCache: expiry queue full, %s will not expire\n", entry->username);
+        return;
+    }
+
+    entry->ticket = ++stripe->next_ticket;
+    ExpiryRecord* record = &queue->records[(queue->head + queue->count) & (queue->capacity - 1)];
+    record->hash = entry->hash;
+    record->ticket = entry->ticket;
+    record->stamp = entry->last_active;
+    memcpy(record->username, entry->username, MAX_USERNAME);
+    queue->count++;
+}
+
+static int expiry_live(UserCacheStripe* stripe, const ExpiryRecord* record, UserTable** table, int* pos) {
+    *table = stripe_locate(stripe, record->username, record->hash, pos);
+    return *table && (*table)->slots[*pos].ticket == record->ticket;
+}
+
+// Drop stale records once they outnumber live entries, amortized O(1) per push
+static void expiry_compact(UserCacheStripe* stripe) {
+    ExpiryQueue* queue = &stripe->expiry;
+    if (queue->count <= (uint32_t)stripe->count * 2 + USER_CACHE_EXPIRY_INIT) return;
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < queue->count; i++) {
+        ExpiryRecord* record = &queue->records[(queue->head + i) & (queue->capacity - 1)];
+        UserTable* table;
+        int pos;
+        if (expiry_live(stripe, record, &table, &pos)) {
+            queue->records[(queue->head + kept) & (queue->capacity - 1)] = *record;
+            kept++;
+        }
+    }
+    queue->count = kept;
+}
+
+static UserCacheStripe* stripe_for(UserCache* cache, const char* key, uint32_t* hash_out) {
+    uint64_t hash = hash_username(key, cache->seed);
+    uint32_t stored = (uint32_t)(hash >> 32);
+    *hash_out = stored ? stored : 1;  // 0 is reserved for empty slots
+    return &cache->stripes[hash & (USER_CACHE_STRIPES - 1)];
+}
+
+/*
+ * Copy out an entry without taking the stripe lock
+ * Retries while a writer is active; falls back to the lock for threads without a read slot
+ * @return 1 if found (copied into out), 0 otherwise
+ */
+static int read_entry(UserCache* cache, const char* username, UserEntry* out) {
+    if (!cache || !username) return 0;
+
+    char key[MAX_USERNAME];
+    make_key(username, key);
+    uint32_t hash;
+    UserCacheStripe* stripe = stripe_for(cache, key, &hash);
+
+    int slot = acquire_reader_slot();
+    if (slot < 0) {
+        pthread_mutex_lock(&stripe->lock);
+        const UserEntry* entry = stripe_find(stripe->table, stripe->old, stripe->migrate_pos, key, hash);
+        if (entry) *out = *entry;
+        pthread_mutex_unlock(&stripe->lock);
+        return entry != NULL;
+    }
+
+    read_enter(cache, slot);
+    int found;
+    while (1) {
+        uint32_t seq = __atomic_load_n(&stripe->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;  // Writer in progress
+        }
+
+        const UserTable* table = __atomic_load_n(&stripe->table, __ATOMIC_ACQUIRE);
+        const UserTable* old = __atomic_load_n(&stripe->old, __ATOMIC_ACQUIRE);
+        uint32_t migrate_pos = __atomic_load_n(&stripe->migrate_pos, __ATOMIC_RELAXED);
+        const UserEntry* entry = stripe_find(table, old, migrate_pos, key, hash);
+        found = entry != NULL;
+        if (found) *out = *entry;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&stripe->seq, __ATOMIC_RELAXED) == seq) {
+            break;
+        }
+    }
+    read_exit(cache, slot);
+
+    return found;
+}
 
 UserCache* create_user_cache(void) {
-    UserCache* cache = malloc(sizeof(UserCache));
+    UserCache* cache = aligned_alloc(USER_CACHE_LINE, sizeof(UserCache));
     if (!cache) return NULL;
+    memset(cache, 0, sizeof(UserCache));
 
-    memset(cache->buckets, 0, sizeof(cache->buckets));
+    for (int i = 0; i < USER_CACHE_STRIPES; i++) {
+        UserCacheStripe* stripe = &cache->stripes[i];
+        stripe->table = table_create(HASH_SIZE / USER_CACHE_STRIPES);
+        if (!stripe->table) {
+            for (int j = 0; j < i; j++) {
+                free(cache->stripes[j].table);
+            }
+            free(cache);
+            return NULL;
+        }
+        pthread_mutex_init(&stripe->lock, NULL);
+    }
+
+    cache->port_counts = calloc(USER_CACHE_MAX_PORT + 1, sizeof(int));
+    if (!cache->port_counts) {
+        for (int i = 0; i < USER_CACHE_STRIPES; i++) {
+            free(cache->stripes[i].table);
+            pthread_mutex_destroy(&cache->stripes[i].lock);
+        }
+        free(cache);
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->retire_lock, NULL);
+    cache->seed = random_seed();
+    cache->epoch = 1;  // 0 marks an idle reader
+    cache->retired = NULL;
     cache->size = 0;
     return cache;
 }
 
 int add_user(UserCache* cache, const char* username, int port, uint32_t session_key) {
-    if (!cache || !username) return -1;
-    
+    if (!cache || !username || port < 0 || port > USER_CACHE_MAX_PORT) return -1;
+
+    char key[MAX_USERNAME];
+    make_key(username, key);
+    uint32_t hash;
+    UserCacheStripe* stripe = stripe_for(cache, key, &hash);
+
+    UserEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.hash = hash;
+    entry.port = port;
+    entry.session_key = session_key;
+    entry.last_active = time(NULL);
+    memcpy(entry.username, key, MAX_USERNAME);
+
+    int result = 0;
+    UserTable* retired[2] = { NULL, NULL };
+
+    write_begin(stripe);
     // Check if user already exists
-    if (has_user(cache, username)) return -1;
-    
-    unsigned int index = hash_username(username);
-    
-    // Create new node
-    UserNode* node = malloc(sizeof(UserNode));
-    if (!node) return -1;
-    
-    strncpy(node->username, username, MAX_USERNAME - 1);
-    node->username[MAX_USERNAME - 1] = '\0';
-    node->port = port;
-    node->session_key = session_key;
-    node->last_active = time(NULL);
-    
-    // Insert at head of bucket (O(1))
-    node->next = cache->buckets[index];
-    cache->buckets[index] = node;
-    cache->size++;
-    
-    return 0;
-}
+    int pos;
+    if (stripe_locate(stripe, key, hash, &pos)) {
+        result = -1;
+    } else {
+        retired[0] = migrate_step(stripe, USER_CACHE_MIGRATE_STEP);
 
-int remove_user(UserCache* cache, const char* username) {
-    if (!cache || !username) return -1;
-    
-    unsigned int index = hash_username(username);
-    UserNode* current = cache->buckets[index];
-    UserNode* prev = NULL;
-    
-    while (current) {
-        if (strcmp(current->username, username) == 0) {
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                cache->buckets[index] = current->next;
-            }
-            free(current);
-            cache->size--;
-            return 0;
+        uint32_t capacity = stripe->table->mask + 1;
+        int failed = 0;
+        if ((uint64_t)(stripe->table->size + 1) * 8 > (uint64_t)capacity * USER_CACHE_MAX_LOAD) {
+            retired[1] = start_resize(stripe, &failed);
         }
-        prev = current;
-        current = current->next;
+
+        if (failed) {
+            result = -1;
+        } else {
+            // Ticket is assigned before the copy goes into the table
+            expiry_push(stripe, &entry);
+            table_insert(stripe->table, entry);
+            stripe->count++;
+            port_count_add(cache, port, 1);
+            __atomic_fetch_add(&cache->size, 1, __ATOMIC_RELAXED);
+            expiry_compact(stripe);
+        }
+    }
+    write_end(stripe);
+
+    for (int i = 0; i < 2; i++) {
+        if (retired[i]) retire_table(cache, retired[i]);
     }
-    
-    return -1;  // User not found
+    return result;
 }
 
-int get_user_port(UserCache* cache, const char* username) {
+// Remove username, or only its entry for session_key when match_session is set
+static int remove_entry(UserCache* cache, const char* username, int match_session, uint32_t session_key) {
     if (!cache || !username) return -1;
-    
-    unsigned int index = hash_username(username);
-    UserNode* current = cache->buckets[index];
-    
-    while (current) {
-        if (strcmp(current->username, username) == 0) {
-            return current->port;
-        }
-        current = current->next;
+
+    char key[MAX_USERNAME];
+    make_key(username, key);
+    uint32_t hash;
+    UserCacheStripe* stripe = stripe_for(cache, key, &hash);
+
+    int result = -1;  // User not found
+    UserTable* retired = NULL;
+
+    write_begin(stripe);
+    // Its expiry record goes stale and is dropped when reached
+    int pos;
+    UserTable* table = stripe_locate(stripe, key, hash, &pos);
+    if (table && (!match_session || table->slots[pos].session_key == session_key)) {
+        stripe_erase(cache, stripe, table, (uint32_t)pos);
+        retired = migrate_step(stripe, USER_CACHE_MIGRATE_STEP);
+        result = 0;
     }
-    
-    return -1;  // User not found
+    write_end(stripe);
+
+    if (retired) retire_table(cache, retired);
+    return result;
+}
+
+int remove_user(UserCache* cache, const char* username) {
+    return remove_entry(cache, username, 0, 0);
+}
+
+int remove_user_session(UserCache* cache, const char* username, uint32_t session_key) {
+    return remove_entry(cache, username, 1, session_key);
+}
+
+int get_user_port(UserCache* cache, const char* username) {
+    UserEntry entry;
+    return read_entry(cache, username, &entry) ? entry.port : -1;  // -1 if user not found
 }
 
 uint32_t get_user_session(UserCache* cache, const char* username) {
-    if (!cache || !username) return 0;
-    
-    unsigned int index = hash_username(username);
-    UserNode* current = cache->buckets[index];
-    
-    while (current) {
-        if (strcmp(current->username, username) == 0) {
-            return current->session_key;
+    UserEntry entry;
+    return read_entry(cache, username, &entry) ? entry.session_key : 0;  // 0 if user not found
+}
+
+int get_user_route(UserCache* cache, const char* username, int* port, uint32_t* session_key) {
+    UserEntry entry;
+    if (!read_entry(cache, username, &entry)) return -1;
+
+    // Both from the same snapshot, a concurrent re-login cannot pair the old port with the new key
+    *port = entry.port;
+    *session_key = entry.session_key;
+    return 1;
+}
+
+int update_user_activity(UserCache* cache, const char* username) {
+    if (!cache || !username) return -1;
+
+    char key[MAX_USERNAME];
+    make_key(username, key);
+    uint32_t hash;
+    UserCacheStripe* stripe = stripe_for(cache, key, &hash);
+
+    time_t now = time(NULL);
+    int result = -1;
+
+    write_begin(stripe);
+    int pos;
+    UserTable* table = stripe_locate(stripe, key, hash, &pos);
+    if (table) {
+        UserEntry* entry = &table->slots[pos];
+        // Same second keeps the existing record
+        if (entry->last_active != now) {
+            entry->last_active = now;
+            expiry_push(stripe, entry);
+            expiry_compact(stripe);
         }
-        current = current->next;
+        result = 0;
     }
-    
-    return 0;  // User not found
+    write_end(stripe);
+
+    return result;
 }
 
 int has_user(UserCache* cache, const char* username) {
-    return get_user_port(cache, username) != -1;
+    UserEntry entry;
+    return read_entry(cache, username, &entry);
+}
+
+int user_cache_size(UserCache* cache) {
+    return cache ? __atomic_load_n(&cache->size, __ATOMIC_RELAXED) : 0;
+}
+
+int user_cache_port_count(UserCache* cache, int port) {
+    if (!cache || port < 0 || port > USER_CACHE_MAX_PORT) return 0;
+    return __atomic_load_n(&cache->port_counts[port], __ATOMIC_RELAXED);
 }
 
 int is_port_in_use(UserCache* cache, int port) {
-    if (!cache) return 0;
-    
-    for (int i = 0; i < HASH_SIZE; i++) {
-        UserNode* current = cache->buckets[i];
-        while (current) {
-            if (current->port == port) return 1;
-            current = current->next;
-        }
-    }
-    
-    return 0;
+    return user_cache_port_count(cache, port) > 0;
 }
 
 void cleanup_inactive_users(UserCache* cache, time_t timeout) {
     if (!cache) return;
-    
+
     time_t current_time = time(NULL);
-    
-    for (int i = 0; i < HASH_SIZE; i++) {
-        UserNode* current = cache->buckets[i];
-        UserNode* prev = NULL;
-        
-        while (current) {
-            if (current_time - current->last_active > timeout) {
-                UserNode* to_delete = current;
-                if (prev) {
-                    prev->next = current->next;
-                    current = current->next;
-                } else {
-                    cache->buckets[i] = current->next;
-                    current = cache->buckets[i];
-                }
-                free(to_delete);
-                cache->size--;
-            } else {
-                prev = current;
-                current = current->next;
+
+    for (int s = 0; s < USER_CACHE_STRIPES; s++) {
+        UserCacheStripe* stripe = &cache->stripes[s];
+        ExpiryQueue* queue = &stripe->expiry;
+
+        write_begin(stripe);
+        // Oldest first: stop at the first record that has not timed out
+        while (queue->count > 0) {
+            ExpiryRecord* record = &queue->records[queue->head];
+            if (current_time - record->stamp <= timeout) break;
+
+            UserTable* table;
+            int pos;
+            if (expiry_live(stripe, record, &table, &pos)) {
+                stripe_erase(cache, stripe, table, (uint32_t)pos);
             }
+            queue->head = (queue->head + 1) & (queue->capacity - 1);
+            queue->count--;
         }
+        write_end(stripe);
     }
 }
 
 void destroy_user_cache(UserCache* cache) {
     if (!cache) return;
-    
-    // Free all nodes in all buckets
-    for (int i = 0; i < HASH_SIZE; i++) {
-        UserNode* current = cache->buckets[i];
-        while (current) {
-            UserNode* next = current->next;
-            free(current);
-            current = next;
-        }
+
+    for (int i = 0; i < USER_CACHE_STRIPES; i++) {
+        free(cache->stripes[i].table);
+        free(cache->stripes[i].old);
+        free(cache->stripes[i].expiry.records);
+        pthread_mutex_destroy(&cache->stripes[i].lock);
+    }
+
+    RetiredTable* retired = cache->retired;
+    while (retired) {
+        RetiredTable* next = retired->next;
+        free(retired->table);
+        free(retired);
+        retired = next;
     }
-    
+
+    pthread_mutex_destroy(&cache->retire_lock);
+    free(cache->port_counts);
     free(cache);
-}
\ No newline at end of file
+}